@@ -0,0 +1,512 @@
+#include "common.h"
+#include "game.h"
+#include "world.h"
+#include "job_pool.h"
+#include "profiler.h"
+#include "replay.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// ============================================================================
+// Headless Simulation Benchmark
+// ============================================================================
+
+// Runs the server simulation with no sockets: a seeded World, M bots, N
+// ticks as fast as they go. Prints ns/tick overall and per profiled
+// subsystem, a checksum of the final world state (same seed, same build =>
+// same checksum), then micro-benchmarks of the hot map queries. Every input
+// is derived from the seed, so numbers are comparable across commits.
+// With -replay, the ticks come from a server recording instead (real
+// traffic), and the report adds whether the replay reproduced it.
+
+struct BenchConfig {
+    int      ticks = 3000;
+    int      warmup = 300;    // Ticks run before measuring
+    int      bots = 100;
+    int      aiThreads = 1;   // 1 runs bot AI inline, like a single-core server
+    int      aiBudget = 0;    // World::aiThinkBudget
+    uint32_t seed = 1;
+    int      queries = 100000; // Per micro-benchmark
+    const char* replayPath = nullptr;
+    const char* mapPath = nullptr; // Map cache for the world, and to time against building
+    uint32_t seekTick = 0;     // Replay from the keyframe at or before this
+    bool     ticksSet = false; // Replays run to the end unless -ticks is given
+};
+
+static BenchConfig g_config;
+static World       g_world;
+
+using BenchClock = std::chrono::steady_clock;
+
+static int64_t nsSince(BenchClock::time_point t0) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(BenchClock::now() - t0).count();
+}
+
+// Fixed stream for the micro-benchmark inputs, independent of the world's
+static uint32_t g_benchRng = 0x9e3779b9u;
+
+static uint32_t benchRand() {
+    g_benchRng ^= g_benchRng << 13;
+    g_benchRng ^= g_benchRng >> 17;
+    g_benchRng ^= g_benchRng << 5;
+    return g_benchRng;
+}
+
+static float benchRandf(float mn, float mx) {
+    return mn + (benchRand() & 0xFFFFFF) / (float)0x1000000 * (mx - mn);
+}
+
+// ============================================================================
+// World Checksum
+// ============================================================================
+
+static void hashBytes(uint64_t& h, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+}
+
+// FNV-1a over the state a snapshot would show
+static uint64_t worldChecksum(const World& w) {
+    uint64_t h = 14695981039346656037ull;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        const PlayerData& p = w.players[i];
+        hashBytes(h, &p.position, sizeof(p.position));
+        hashBytes(h, &p.yaw, sizeof(p.yaw));
+        hashBytes(h, &p.health, sizeof(p.health));
+        hashBytes(h, &p.state, sizeof(p.state));
+        hashBytes(h, &p.vehicleId, sizeof(p.vehicleId));
+    }
+    for (int i = 0; i < w.numVehicles; i++) {
+        const VehicleData& v = w.vehicles[i];
+        hashBytes(h, &v.position, sizeof(v.position));
+        hashBytes(h, &v.health, sizeof(v.health));
+    }
+    hashBytes(h, w.teamScores, sizeof(w.teamScores));
+    return h;
+}
+
+// ============================================================================
+// Simulation Benchmark
+// ============================================================================
+
+// Profiler zone totals at the start of a measured run, so earlier ticks
+// (warmup, seeking) are not counted
+static std::vector<Profiler::ZoneTotal> zoneMark() {
+    std::vector<Profiler::ZoneTotal> mark;
+    for (int z = 0; z < Profiler::numZones(); z++) mark.push_back(Profiler::zoneTotal(z));
+    return mark;
+}
+
+static void reportTicks(const std::vector<int64_t>& tickNs, double elapsed,
+                        const std::vector<Profiler::ZoneTotal>& before) {
+    int n = (int)tickNs.size();
+    if (n == 0) return;
+    std::vector<int64_t> sorted = tickNs;
+    std::sort(sorted.begin(), sorted.end());
+    int64_t total = 0;
+    for (int64_t ns : tickNs) total += ns;
+    printf("Simulation: %d ticks in %.2f s (%.0f ticks/s, %.1fx real time)\n",
+           n, elapsed, n / elapsed, n * TICK_DURATION / elapsed);
+    printf("  ns/tick  avg %10.0f  p50 %10lld  p99 %10lld  max %10lld\n",
+           (double)total / n, (long long)sorted[n / 2],
+           (long long)sorted[std::min(n - 1, n * 99 / 100)], (long long)sorted[n - 1]);
+
+#ifndef FPS_NO_PROFILE
+    // Zone times are summed over threads, so with -aithreads > 1 bot_think
+    // is CPU time rather than wall time
+    printf("Subsystems (ns/tick, calls/tick):\n");
+    for (int z = 0; z < Profiler::numZones(); z++) {
+        Profiler::ZoneTotal now = Profiler::zoneTotal(z);
+        if (z < (int)before.size()) {
+            now.calls -= before[z].calls;
+            now.totalNs -= before[z].totalNs;
+        }
+        if (now.calls == 0) continue;
+        printf("  %-16s %10.0f  %8.1f\n", now.name, (double)now.totalNs / n, (double)now.calls / n);
+    }
+#else
+    printf("Subsystems: profiler compiled out (PROFILE=0)\n");
+#endif
+
+    printf("World checksum: %016llx (tick %u, scores %d-%d)\n",
+           (unsigned long long)worldChecksum(g_world), g_world.serverTick,
+           g_world.teamScores[0], g_world.teamScores[1]);
+}
+
+static void benchSimulation() {
+    for (int t = 0; t < g_config.warmup; t++) {
+        g_world.simulate();
+        g_world.clearEvents();
+        g_world.serverTick++;
+    }
+
+    std::vector<Profiler::ZoneTotal> before = zoneMark();
+    std::vector<int64_t> tickNs(g_config.ticks);
+    int64_t eventBytes = 0;
+    BenchClock::time_point start = BenchClock::now();
+    for (int t = 0; t < g_config.ticks; t++) {
+        BenchClock::time_point t0 = BenchClock::now();
+        g_world.simulate();
+        tickNs[t] = nsSince(t0);
+        eventBytes += (int64_t)g_world.eventData.size();
+        g_world.clearEvents();
+        g_world.serverTick++;
+    }
+    reportTicks(tickNs, nsSince(start) / 1e9, before);
+    printf("  events   %.1f bytes/tick\n", (double)eventBytes / g_config.ticks);
+}
+
+static bool benchReplay(MatchReplay& replay) {
+    BenchClock::time_point seekStart = BenchClock::now();
+    if (!replay.seek(g_world, g_config.seekTick)) {
+        printf("Replay: cannot seek to tick %u\n", g_config.seekTick);
+        return false;
+    }
+    printf("Replay: at tick %u after %.1f ms seek\n", g_world.serverTick, nsSince(seekStart) / 1e6);
+
+    std::vector<Profiler::ZoneTotal> before = zoneMark();
+    std::vector<int64_t> tickNs;
+    BenchClock::time_point start = BenchClock::now();
+    while (!g_config.ticksSet || (int)tickNs.size() < g_config.ticks) {
+        BenchClock::time_point t0 = BenchClock::now();
+        if (!replay.step(g_world)) break;
+        tickNs.push_back(nsSince(t0)); // Includes applying the tick's records
+    }
+    reportTicks(tickNs, nsSince(start) / 1e9, before);
+    printf("Replay check: %d bot input mismatches, %d/%d keyframes differ%s\n",
+           replay.botMismatches(), replay.keyframeMismatches(), replay.keyframesChecked(),
+           replay.botMismatches() || replay.keyframeMismatches() ? " (simulation changed since recording)" : "");
+    return true;
+}
+
+// ============================================================================
+// Micro-Benchmarks
+// ============================================================================
+
+static void printMicro(const char* name, int64_t ns, int calls, int hits) {
+    printf("  %-22s %8.1f ns/call  (%d calls, %d hits)\n", name, (double)ns / calls, calls, hits);
+}
+
+// Query inputs are drawn around waypoints so they sit where players are
+static Vec3 randomWaypointPos() {
+    const auto& wps = g_world.map->waypoints();
+    return wps[benchRand() % wps.size()].position;
+}
+
+static void benchMapQueries() {
+    const GameMap& map = *g_world.map;
+    const int n = g_config.queries;
+    printf("Map queries:\n");
+
+    {
+        std::vector<Vec3> origins(n), dirs(n);
+        for (int i = 0; i < n; i++) {
+            origins[i] = randomWaypointPos() + Vec3(0, PLAYER_EYE_HEIGHT, 0);
+            float yaw = benchRandf(-PI, PI), pitch = benchRandf(-0.5f, 0.3f);
+            dirs[i] = Vec3(cosf(pitch) * sinf(yaw), sinf(pitch), cosf(pitch) * cosf(yaw));
+        }
+        int hits = 0;
+        BenchClock::time_point t0 = BenchClock::now();
+        for (int i = 0; i < n; i++) {
+            Vec3 hitPoint;
+            float hitDist;
+            hits += map.raycast(origins[i], dirs[i], 200.0f, hitPoint, hitDist);
+        }
+        printMicro("raycast", nsSince(t0), n, hits);
+    }
+
+    {
+        std::vector<Vec3> from(n), to(n);
+        for (int i = 0; i < n; i++) {
+            from[i] = randomWaypointPos();
+            to[i] = from[i] + Vec3(benchRandf(-0.3f, 0.3f), benchRandf(-0.1f, 0.1f), benchRandf(-0.3f, 0.3f));
+        }
+        int moved = 0;
+        BenchClock::time_point t0 = BenchClock::now();
+        for (int i = 0; i < n; i++) {
+            Vec3 p = map.resolveCollision(from[i], to[i], PLAYER_RADIUS, PLAYER_HEIGHT);
+            moved += (p.x != to[i].x || p.y != to[i].y || p.z != to[i].z);
+        }
+        printMicro("resolveCollision", nsSince(t0), n, moved);
+    }
+
+    // Bot sight lines (eye to chest) between points near waypoints, up to
+    // 60 m apart: the raycast alone, then with the visibility sets first.
+    // Misses are open sight lines the sets reject.
+    {
+        std::vector<Vec3> from(n), to(n);
+        for (int i = 0; i < n; i++) {
+            from[i] = randomWaypointPos() + Vec3(benchRandf(-4, 4), PLAYER_EYE_HEIGHT, benchRandf(-4, 4));
+            do {
+                to[i] = randomWaypointPos() + Vec3(benchRandf(-4, 4), PLAYER_HEIGHT * 0.5f, benchRandf(-4, 4));
+            } while ((to[i] - from[i]).lengthSq() > 60.0f * 60.0f);
+        }
+        auto lineOfSight = [&](int i) {
+            Vec3 dir = to[i] - from[i];
+            float dist = dir.length();
+            if (dist < 0.1f) return true;
+            dir = dir * (1.0f / dist);
+            Vec3 hitPoint;
+            float hitDist;
+            return !map.raycast(from[i], dir, dist, hitPoint, hitDist) || hitDist > dist - 0.5f;
+        };
+        std::vector<uint8_t> open(n);
+        BenchClock::time_point t0 = BenchClock::now();
+        for (int i = 0; i < n; i++) open[i] = lineOfSight(i);
+        int64_t rayNs = nsSince(t0);
+        int rejected = 0, misses = 0, numOpen = 0;
+        t0 = BenchClock::now();
+        for (int i = 0; i < n; i++) {
+            bool pass = map.potentiallyVisible(from[i], to[i]);
+            bool seen = pass && lineOfSight(i);
+            rejected += !pass;
+            misses += open[i] && !seen;
+        }
+        int64_t visNs = nsSince(t0);
+        for (int i = 0; i < n; i++) numOpen += open[i];
+        printMicro("sight line (raycast)", rayNs, n, numOpen);
+        printMicro("sight line (+PVS)", visNs, n, numOpen - misses);
+        printf("  PVS rejected %d of %d blocked, %d open lines missed\n", rejected, n - numOpen, misses);
+    }
+
+    // A* is much slower than the table, so it gets fewer queries
+    int numWaypoints = (int)map.waypoints().size();
+    for (int useTable = 1; useTable >= 0; useTable--) {
+        int calls = useTable ? n : n / 10;
+        std::vector<int> starts(calls), goals(calls);
+        g_benchRng = 0x2545f491u;
+        for (int i = 0; i < calls; i++) {
+            starts[i] = benchRand() % numWaypoints;
+            goals[i] = benchRand() % numWaypoints;
+        }
+        std::vector<int> path;
+        int found = 0;
+        BenchClock::time_point t0 = BenchClock::now();
+        for (int i = 0; i < calls; i++) {
+            g_world.findPath(starts[i], goals[i], path, useTable);
+            found += !path.empty();
+        }
+        printMicro(useTable ? "findPath (next-hop)" : "findPath (A*)", nsSince(t0), calls, found);
+    }
+}
+
+// The batched ray kernels against their scalar references. Player rays run
+// from the end-of-run world, so hitboxes sit where the bots left them. The
+// matrix checksum should be the same in a SIMD=0 build.
+static void benchRayKernels() {
+    const int n = g_config.queries;
+    printf("Ray kernels (%s):\n", FPS_SIMD ? "SIMD" : "scalar");
+
+    {
+        std::vector<Vec3> origins(n), dirs(n);
+        std::vector<int> shooters(n);
+        for (int i = 0; i < n; i++) {
+            shooters[i] = benchRand() % MAX_PLAYERS;
+            origins[i] = g_world.players[shooters[i]].position + Vec3(0, PLAYER_EYE_HEIGHT, 0);
+            float yaw = benchRandf(-PI, PI), pitch = benchRandf(-0.3f, 0.3f);
+            dirs[i] = Vec3(cosf(pitch) * sinf(yaw), sinf(pitch), cosf(pitch) * cosf(yaw));
+        }
+        std::vector<int> hitBatched(n), hitGrid(n);
+        std::vector<float> distBatched(n, -1), distGrid(n, -1);
+
+        BenchClock::time_point t0 = BenchClock::now();
+        for (int i = 0; i < n; i++) {
+            hitBatched[i] = GameMap::raycastPlayers(origins[i], dirs[i], 300.0f, g_world.players,
+                                                    MAX_PLAYERS, shooters[i], distBatched[i]);
+        }
+        int64_t batchedNs = nsSince(t0);
+        t0 = BenchClock::now();
+        for (int i = 0; i < n; i++) {
+            hitGrid[i] = GameMap::raycastPlayers(origins[i], dirs[i], 300.0f, g_world.players,
+                                                 g_world.playerGrid, shooters[i], distGrid[i]);
+        }
+        int64_t gridNs = nsSince(t0);
+
+        int hits = 0, mismatches = 0;
+        for (int i = 0; i < n; i++) {
+            hits += hitBatched[i] >= 0;
+            mismatches += hitBatched[i] != hitGrid[i] || (hitBatched[i] >= 0 && distBatched[i] != distGrid[i]);
+        }
+        printMicro("players (all, batched)", batchedNs, n, hits);
+        printMicro("players (grid, scalar)", gridNs, n, hits);
+        printf("  player ray mismatches: %d\n", mismatches);
+    }
+
+    {
+        std::vector<Mat4> mats(64);
+        for (Mat4& m : mats)
+            for (float& f : m.m) f = benchRandf(-1, 1);
+        std::vector<Mat4> out(n);
+        BenchClock::time_point t0 = BenchClock::now();
+        for (int i = 0; i < n; i++) out[i] = mats[i & 63] * mats[(i * 7 + 3) & 63];
+        printMicro("Mat4 multiply", nsSince(t0), n, 0);
+        uint64_t h = 1469598103934665603ull;
+        hashBytes(h, out.data(), out.size() * sizeof(Mat4));
+        printf("  Mat4 checksum: %016llx\n", (unsigned long long)h);
+    }
+}
+
+// Startup cost of the map: procedural build (plus mesh, as the client does)
+// against loading the cache file
+static void benchMapStartup(const char* path) {
+    printf("Map startup:\n");
+    GameMap built;
+    BenchClock::time_point t0 = BenchClock::now();
+    built.buildArcticMap();
+    double buildMs = nsSince(t0) / 1e6;
+    t0 = BenchClock::now();
+    built.bakeMesh();
+    double meshMs = nsSince(t0) / 1e6;
+    t0 = BenchClock::now();
+    built.bakeVisibility();
+    double visMs = nsSince(t0) / 1e6;
+    if (!built.saveCache(path)) {
+        printf("  cannot write %s\n", path);
+        return;
+    }
+
+    GameMap loaded;
+    t0 = BenchClock::now();
+    bool ok = loaded.loadCache(path, true);
+    double loadMs = nsSince(t0) / 1e6;
+    if (!ok) {
+        printf("  cannot load %s\n", path);
+        return;
+    }
+    printf("  build %.2f ms + mesh %.2f ms + visibility %.2f ms, cache load %.2f ms (%zu blocks, %zu vertices)\n",
+           buildMs, meshMs, visMs, loadMs, loaded.blocks().size(), loaded.meshVertices().size());
+    printf("  loaded grid verify: %d mismatches\n", loaded.verifySpatialIndex(10000));
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+// A shotgun blast whose first pellet kills a rewound target: the rest of
+// the pellets must pass through the body, so exactly one death is raised
+static bool checkRewindKill() {
+    auto w = std::make_unique<World>();
+    w->verbose = false;
+    w->map = g_world.map;
+    w->init(g_config.seed);
+    int shooter = w->addPlayer("shooter");
+    int victim = w->addPlayer("victim"); // Other team (round-robin)
+    InputState inputs[2];
+    w->inputSource[shooter] = &inputs[0];
+    w->inputSource[victim] = &inputs[1];
+
+    // Both stand still a few ticks so there are frames to rewind to
+    Vec3 pos = w->players[shooter].position;
+    for (int t = 0; t < 4; t++) {
+        w->players[shooter].position = pos;
+        w->players[victim].position = pos + Vec3{0, 0, 4.0f};
+        w->simulate();
+        w->clearEvents();
+        w->serverTick++;
+    }
+
+    PlayerData& s = w->players[shooter];
+    s.currentWeapon = WeaponType::SHOTGUN;
+    s.ammo = getWeaponDef(WeaponType::SHOTGUN).magSize;
+    s.fireCooldown = 0;
+    w->players[victim].health = 1;
+    w->viewTick[shooter] = w->serverTick - 3;
+    w->viewTickFrac[shooter] = 0;
+    inputs[0].keys = InputState::KEY_SHOOT; // Yaw 0 faces +z, at the victim
+    w->simulate();
+
+    int hits = 0, deaths = 0;
+    for (const World::Event& e : w->events) {
+        uint8_t type = w->eventData[e.offset];
+        hits += type == (uint8_t)ServerPacket::PLAYER_HIT;
+        deaths += type == (uint8_t)ServerPacket::PLAYER_DIED;
+    }
+    bool ok = hits == 1 && deaths == 1 && w->killFeed.size() == 1;
+    printf("Rewind multi-pellet kill: %d hit, %d death event(s), %zu kill feed entries (expect 1, 1, 1)%s\n",
+           hits, deaths, w->killFeed.size(), ok ? "" : "  FAILED");
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-ticks") == 0 && i + 1 < argc) {
+            g_config.ticks = std::max(1, atoi(argv[++i]));
+            g_config.ticksSet = true;
+        } else if (strcmp(argv[i], "-warmup") == 0 && i + 1 < argc) {
+            g_config.warmup = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-bots") == 0 && i + 1 < argc) {
+            g_config.bots = std::clamp(atoi(argv[++i]), 0, MAX_PLAYERS);
+        } else if (strcmp(argv[i], "-aithreads") == 0 && i + 1 < argc) {
+            g_config.aiThreads = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-aibudget") == 0 && i + 1 < argc) {
+            g_config.aiBudget = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            g_config.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "-queries") == 0 && i + 1 < argc) {
+            g_config.queries = std::max(10, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc) {
+            g_config.replayPath = argv[++i];
+        } else if (strcmp(argv[i], "-map") == 0 && i + 1 < argc) {
+            g_config.mapPath = argv[++i];
+        } else if (strcmp(argv[i], "-seek") == 0 && i + 1 < argc) {
+            g_config.seekTick = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "Usage: %s [-ticks N] [-warmup N] [-bots M] [-aithreads T] [-aibudget B] [-seed S] [-queries Q] [-map FILE]\n"
+                            "       %s -replay FILE [-seek TICK] [-ticks N] [-aithreads T]\n", argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    printf("=== ARCTIC ASSAULT BENCH ===\n");
+    std::unique_ptr<JobPool> pool;
+    if (g_config.aiThreads > 1) {
+        pool = std::make_unique<JobPool>(g_config.aiThreads);
+        g_world.aiPool = pool.get();
+    }
+    g_world.verbose = false;
+    if (g_config.mapPath) {
+        auto cached = std::make_shared<GameMap>();
+        if (cached->loadCache(g_config.mapPath, false)) {
+            printf("Map loaded from cache %s\n", g_config.mapPath);
+            g_world.map = cached;
+        }
+    }
+
+    if (g_config.replayPath) {
+        MatchReplay replay;
+        if (!replay.open(g_config.replayPath)) {
+            fprintf(stderr, "Cannot read recording %s\n", g_config.replayPath);
+            return 1;
+        }
+        const RecordingHeader& h = replay.header();
+        printf("Replaying %s: seed %u, ticks %u-%u, %zu keyframes, %d AI thread(s)\n",
+               g_config.replayPath, h.seed, replay.keyframes()[0].tick, replay.lastTick(),
+               replay.keyframes().size(), g_config.aiThreads);
+        g_world.init(h.seed);
+        return benchReplay(replay) ? 0 : 1;
+    }
+
+    printf("Seed %u, %d bots, %d ticks (+%d warmup), %d AI thread(s), think budget %d\n",
+           g_config.seed, g_config.bots, g_config.ticks, g_config.warmup, g_config.aiThreads,
+           g_config.aiBudget);
+
+    g_world.init(g_config.seed);
+    g_world.aiThinkBudget = g_config.aiBudget;
+    g_world.spawnBots(g_config.bots);
+
+    benchSimulation();
+    benchMapQueries();
+    benchRayKernels();
+    bool ok = checkRewindKill();
+    if (g_config.mapPath) benchMapStartup(g_config.mapPath);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "common.h"
+
+// ============================================================================
+// Bit Streams
+// ============================================================================
+
+// Number of bits needed to store values 0..maxValue
+constexpr int bitsFor(uint32_t maxValue) {
+    int bits = 0;
+    while (bits < 32 && (maxValue >> bits) != 0) bits++;
+    return bits == 0 ? 1 : bits;
+}
+
+constexpr uint32_t maxForBits(int bits) {
+    return bits >= 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+}
+
+// LSB-first bit packer over a caller-owned buffer. Sets overflow instead of
+// writing past the end.
+class BitWriter {
+public:
+    BitWriter(uint8_t* buf, int capacity) : buf_(buf), cap_(capacity) {}
+
+    void write(uint32_t value, int bits) {
+        value &= maxForBits(bits);
+        scratch_ |= (uint64_t)value << scratchBits_;
+        scratchBits_ += bits;
+        while (scratchBits_ >= 8) {
+            if (len_ >= cap_) { overflow_ = true; scratchBits_ = 0; return; }
+            buf_[len_++] = (uint8_t)scratch_;
+            scratch_ >>= 8;
+            scratchBits_ -= 8;
+        }
+    }
+
+    void writeBool(bool v) { write(v ? 1 : 0, 1); }
+
+    // Pad the last partial byte with zeros
+    void flush() {
+        if (scratchBits_ > 0) write(0, 8 - scratchBits_);
+    }
+
+    int  bytes() const { return len_ + (scratchBits_ > 0 ? 1 : 0); }
+    bool overflow() const { return overflow_; }
+
+private:
+    uint8_t* buf_;
+    int      cap_;
+    int      len_ = 0;
+    uint64_t scratch_ = 0;
+    int      scratchBits_ = 0;
+    bool     overflow_ = false;
+};
+
+// Reads what BitWriter wrote. Reading past the end returns zeros and sets error.
+class BitReader {
+public:
+    BitReader(const uint8_t* buf, int len) : buf_(buf), len_(len) {}
+
+    uint32_t read(int bits) {
+        while (scratchBits_ < bits) {
+            if (pos_ >= len_) { error_ = true; return 0; }
+            scratch_ |= (uint64_t)buf_[pos_++] << scratchBits_;
+            scratchBits_ += 8;
+        }
+        uint32_t v = (uint32_t)(scratch_ & maxForBits(bits));
+        scratch_ >>= bits;
+        scratchBits_ -= bits;
+        return v;
+    }
+
+    bool readBool() { return read(1) != 0; }
+    void fail() { error_ = true; } // Caller found the data malformed
+    bool error() const { return error_; }
+
+private:
+    const uint8_t* buf_;
+    int      len_;
+    int      pos_ = 0;
+    uint64_t scratch_ = 0;
+    int      scratchBits_ = 0;
+    bool     error_ = false;
+};
+
+// ============================================================================
+// Quantization
+// ============================================================================
+
+// Map v in [mn, mx] (clamped) to an integer with the given number of bits
+inline uint32_t quantizeFloat(float v, float mn, float mx, int bits) {
+    float t = (std::clamp(v, mn, mx) - mn) / (mx - mn);
+    return (uint32_t)lroundf(t * (float)maxForBits(bits));
+}
+
+inline float dequantizeFloat(uint32_t q, float mn, float mx, int bits) {
+    return mn + (float)q / (float)maxForBits(bits) * (mx - mn);
+}
+
+// Angles wrap, so they use the full [0, 2*PI) circle with no clamping
+inline uint32_t quantizeAngle(float a, int bits) {
+    float turns = a / (2.0f * PI);
+    turns -= floorf(turns);
+    return (uint32_t)lroundf(turns * (float)(1u << bits)) & maxForBits(bits);
+}
+
+inline float dequantizeAngle(uint32_t q, int bits) {
+    return (float)q / (float)(1u << bits) * (2.0f * PI);
+}
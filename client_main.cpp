@@ -1,7 +1,12 @@
 #include "common.h"
 #include "game.h"
 #include "network.h"
+#include "snapshot.h"
+#include "client_net.h"
 #include "renderer.h"
+#include "interpolation.h"
+#include "prediction.h"
+#include "profiler.h"
 
 #include <GLFW/glfw3.h>
 #include <cstdio>
@@ -26,15 +31,30 @@ static GLFWwindow*   g_window = nullptr;
 static Renderer      g_renderer;
 static GameMap       g_map;
 static ClientState   g_clientState = ClientState::MENU;
-static UDPSocket     g_socket;
-static sockaddr_in   g_serverAddr;
+static ClientNet     g_net; // Socket and network thread
 
 // Player state
 static PlayerData    g_players[MAX_PLAYERS];
 static int           g_localId = -1;
-static uint32_t      g_inputSeq = 0;
 static InputState    g_currentInput;
 
+// The network thread sends inputs once per server tick; each is predicted
+// here when it comes back through g_net.sentInputs
+static float             g_inputAccum = 0; // Seconds since the newest predicted input was sent
+static MovementPredictor g_predictor;
+static bool              g_predictMovement = true;
+
+// Remote entities render from these histories, g_interpDelay behind the server
+static EntityHistory g_playerHistory[MAX_PLAYERS];
+static bool          g_playerRelevant[MAX_PLAYERS]; // False: only listed by the server, not placed
+static EntityHistory g_vehicleHistory[MAX_VEHICLES];
+static EntityHistory g_tornadoHistory[MAX_TORNADOS];
+static EntityHistory g_flagHistory[2];
+static InterpClock   g_interpClock;
+static float         g_interpDelay = 0.1f; // Seconds; 0 = draw the newest snapshot
+static float         g_profileInterval = 0;  // Seconds between profiler reports; 0 = off
+static const char*   g_mapCachePath = nullptr; // -map: binary map cache to load or write
+
 // Weapon pickups (received from server)
 static std::vector<WeaponPickup> g_weaponPickups;
 
@@ -64,7 +84,6 @@ static int  g_portLen = 5;
 static int  g_selectedField = 0; // 0=IP, 1=port, 2=connect, 3=quit
 static char g_statusMsg[128] = {};
 static float g_connectTimer = 0;
-static float g_connectRetryTimer = 0;
 
 // Timing
 static float g_time = 0;
@@ -92,7 +111,6 @@ static float g_damageFlashTimer = 0;
 static int   g_lastHealth = MAX_HEALTH;
 
 // Class selection
-static uint8_t g_pendingClassSelect = 0xFF; // No pending change
 static PlayerClass g_selectedClass = PlayerClass::ASSAULT;
 
 // Footprint tracking
@@ -188,16 +206,14 @@ static void keyCallback(GLFWwindow* window, int key, int, int action, int) {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
         if (g_clientState == ClientState::PLAYING || g_clientState == ClientState::DEAD) {
             // Disconnect and go back to menu
-            DisconnectPacket pkt;
-            g_socket.sendTo(&pkt, sizeof(pkt), g_serverAddr);
-            g_socket.close();
+            g_net.disconnect(true);
             g_clientState = ClientState::MENU;
             g_localId = -1;
             glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
             g_firstMouse = true;
             g_statusMsg[0] = 0;
         } else if (g_clientState == ClientState::CONNECTING) {
-            g_socket.close();
+            g_net.disconnect(false);
             g_clientState = ClientState::MENU;
             snprintf(g_statusMsg, sizeof(g_statusMsg), "Connection cancelled");
         }
@@ -230,10 +246,10 @@ static void keyCallback(GLFWwindow* window, int key, int, int action, int) {
 
     // Class selection (1-4 keys)
     if (action == GLFW_PRESS) {
-        if (key == GLFW_KEY_1) { g_pendingClassSelect = 0; g_selectedClass = PlayerClass::ASSAULT; }
-        if (key == GLFW_KEY_2) { g_pendingClassSelect = 1; g_selectedClass = PlayerClass::ENGINEER; }
-        if (key == GLFW_KEY_3) { g_pendingClassSelect = 2; g_selectedClass = PlayerClass::SUPPORT; }
-        if (key == GLFW_KEY_4) { g_pendingClassSelect = 3; g_selectedClass = PlayerClass::RECON; }
+        if (key == GLFW_KEY_1) { g_net.selectClass(0); g_selectedClass = PlayerClass::ASSAULT; }
+        if (key == GLFW_KEY_2) { g_net.selectClass(1); g_selectedClass = PlayerClass::ENGINEER; }
+        if (key == GLFW_KEY_3) { g_net.selectClass(2); g_selectedClass = PlayerClass::SUPPORT; }
+        if (key == GLFW_KEY_4) { g_net.selectClass(3); g_selectedClass = PlayerClass::RECON; }
     }
 }
 
@@ -241,23 +257,6 @@ static void keyCallback(GLFWwindow* window, int key, int, int action, int) {
 // Networking
 // ============================================================================
 
-static void sendJoin() {
-    JoinPacket pkt;
-    snprintf(pkt.name, sizeof(pkt.name), "Player");
-    g_socket.sendTo(&pkt, sizeof(pkt), g_serverAddr);
-}
-
-static void sendInput() {
-    InputPacket pkt;
-    pkt.seq = ++g_inputSeq;
-    pkt.keys = g_currentInput.keys;
-    pkt.yaw = g_yaw;
-    pkt.pitch = g_pitch;
-    pkt.classSelect = g_pendingClassSelect;
-    if (g_pendingClassSelect != 0xFF) g_pendingClassSelect = 0xFF; // Send once
-    g_socket.sendTo(&pkt, sizeof(pkt), g_serverAddr);
-}
-
 static void addKillFeedEntry(const char* text) {
     // Shift entries up
     if (g_killFeedCount >= 5) {
@@ -269,167 +268,259 @@ static void addKillFeedEntry(const char* text) {
     g_killFeedCount++;
 }
 
-static void receivePackets() {
-    uint8_t buf[16384];
-    sockaddr_in fromAddr;
-    int len;
+// Copy a decoded snapshot into the client-side world state
+// The local player's own movement is predicted while alive on foot
+static bool predictingLocalPlayer() {
+    if (!g_predictMovement || g_localId < 0 || g_localId >= MAX_PLAYERS) return false;
+    const PlayerData& lp = g_players[g_localId];
+    return lp.state == PlayerState::ALIVE && lp.vehicleId < 0;
+}
 
-    while ((len = g_socket.recvFrom(buf, sizeof(buf), fromAddr)) > 0) {
-        if (len < 1) continue;
-        uint8_t type = buf[0];
+// ackInputSeq: newest input the server had applied for this snapshot
+static void applySnapshot(const WorldSnapshot& snap, uint32_t ackInputSeq) {
+    g_teamScores[0] = snap.teamScores[0];
+    g_teamScores[1] = snap.teamScores[1];
+    g_interpClock.onSnapshot(snap.tick);
+
+    Vec3 serverPos;
+    for (int pid = 0; pid < MAX_PLAYERS; pid++) {
+        if (!snap.playerPresent[pid]) {
+            g_players[pid].state = PlayerState::DISCONNECTED;
+            g_playerHistory[pid].clear();
+            continue;
+        }
+        const NetPlayerState& np = snap.players[pid];
+        g_players[pid].state = (PlayerState)np.state;
+        g_players[pid].health = np.health;
+        g_players[pid].teamId = np.teamId;
+        g_players[pid].playerClass = (PlayerClass)np.playerClass;
+        g_players[pid].isBot = np.isBot != 0;
+        g_playerRelevant[pid] = np.relevant != 0 || pid == g_localId;
+        if (!g_playerRelevant[pid]) {
+            // Out of our interest: stays on the scoreboard, not in the world
+            g_players[pid].spotted = false;
+            g_playerHistory[pid].clear();
+            continue;
+        }
+        if (pid == g_localId) serverPos = {np.x, np.y, np.z};
+        InterpState is;
+        is.position = {np.x, np.y, np.z};
+        is.yaw = np.yaw;
+        is.pitch = np.pitch;
+        g_playerHistory[pid].record(snap.tick, is);
+
+        if (pid != g_localId) g_players[pid].position = {np.x, np.y, np.z};
+        g_players[pid].currentWeapon = (WeaponType)np.weapon;
+        g_players[pid].ammo = np.ammo;
+        g_players[pid].vehicleId = np.vehicleId;
+        g_players[pid].spotted = np.spotted != 0;
+
+        if (pid != g_localId) {
+            g_players[pid].yaw = np.yaw;
+            g_players[pid].pitch = np.pitch;
+        }
+    }
 
-        switch ((ServerPacket)type) {
-            case ServerPacket::JOIN_ACK: {
-                if (len >= (int)sizeof(JoinAckPacket)) {
-                    JoinAckPacket ack;
-                    memcpy(&ack, buf, sizeof(ack));
-                    g_localId = ack.playerId;
-                    g_clientState = ClientState::PLAYING;
-                    glfwSetInputMode(g_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-                    g_firstMouse = true;
-                    printf("Joined server as player %d\n", g_localId);
-                }
-                break;
-            }
+    // Weapon pickups
+    int numWeapons = 0;
+    for (int i = 0; i < SNAPSHOT_MAX_WEAPONS; i++) {
+        if (snap.weaponPresent[i]) numWeapons = i + 1;
+    }
+    g_weaponPickups.resize(numWeapons);
+    for (int i = 0; i < numWeapons; i++) {
+        const NetWeaponState& nw = snap.weapons[i];
+        g_weaponPickups[i].id = nw.id;
+        g_weaponPickups[i].type = (WeaponType)nw.type;
+        g_weaponPickups[i].position = {nw.x, nw.y, nw.z};
+        g_weaponPickups[i].active = snap.weaponPresent[i] && nw.active != 0;
+    }
 
-            case ServerPacket::SNAPSHOT: {
-                int offset = 0;
-                SnapshotPacket hdr;
-                if (len < (int)sizeof(hdr)) break;
-                memcpy(&hdr, buf, sizeof(hdr));
-                offset += sizeof(hdr);
-                g_teamScores[0] = hdr.teamScores[0];
-                g_teamScores[1] = hdr.teamScores[1];
-
-                for (uint8_t i = 0; i < hdr.numPlayers && offset + (int)sizeof(NetPlayerState) <= len; i++) {
-                    NetPlayerState np;
-                    memcpy(&np, buf + offset, sizeof(np));
-                    offset += sizeof(np);
-
-                    int pid = np.playerId;
-                    if (pid < 0 || pid >= MAX_PLAYERS) continue;
-
-                    g_players[pid].position = {np.x, np.y, np.z};
-                    g_players[pid].state = (PlayerState)np.state;
-                    g_players[pid].health = np.health;
-                    g_players[pid].currentWeapon = (WeaponType)np.weapon;
-                    g_players[pid].ammo = np.ammo;
-                    g_players[pid].teamId = np.teamId;
-                    g_players[pid].vehicleId = np.vehicleId;
-                    g_players[pid].playerClass = (PlayerClass)np.playerClass;
-                    g_players[pid].spotted = np.spotted != 0;
-
-                    if (pid != g_localId) {
-                        g_players[pid].yaw = np.yaw;
-                        g_players[pid].pitch = np.pitch;
-                    }
-                }
+    // Vehicle states
+    g_numVehicles = 0;
+    for (int i = 0; i < MAX_VEHICLES; i++) {
+        if (!snap.vehiclePresent[i]) {
+            g_vehicleHistory[i].clear();
+            continue;
+        }
+        g_numVehicles = i + 1;
+        const NetVehicleState& nv = snap.vehicles[i];
+        InterpState is;
+        is.position = {nv.x, nv.y, nv.z};
+        is.yaw = nv.yaw;
+        is.pitch = nv.pitch;
+        is.turretYaw = nv.turretYaw;
+        is.rotorAngle = nv.rotorAngle;
+        g_vehicleHistory[i].record(snap.tick, is);
+        g_vehicles[i].type = (VehicleType)nv.type;
+        g_vehicles[i].position = {nv.x, nv.y, nv.z};
+        g_vehicles[i].yaw = nv.yaw;
+        g_vehicles[i].pitch = nv.pitch;
+        g_vehicles[i].turretYaw = nv.turretYaw;
+        g_vehicles[i].health = nv.health;
+        g_vehicles[i].driverId = nv.driverId;
+        g_vehicles[i].active = nv.active != 0;
+        g_vehicles[i].rotorAngle = nv.rotorAngle;
+    }
 
-                // Weapon pickups
-                if (offset + 1 <= len) {
-                    uint8_t numWeapons = buf[offset++];
-                    g_weaponPickups.resize(numWeapons);
-                    for (uint8_t i = 0; i < numWeapons && offset + (int)sizeof(NetWeaponState) <= len; i++) {
-                        NetWeaponState nw;
-                        memcpy(&nw, buf + offset, sizeof(nw));
-                        offset += sizeof(nw);
-                        g_weaponPickups[i].id = nw.id;
-                        g_weaponPickups[i].type = (WeaponType)nw.type;
-                        g_weaponPickups[i].position = {nw.x, nw.y, nw.z};
-                        g_weaponPickups[i].active = nw.active != 0;
-                    }
-                }
+    // Flag states
+    for (int t = 0; t < 2; t++) {
+        const NetFlagState& nf = snap.flags[t];
+        g_flags[t].position = {nf.x, nf.y, nf.z};
+        InterpState is;
+        is.position = g_flags[t].position;
+        g_flagHistory[t].record(snap.tick, is);
+        g_flags[t].carrierId = nf.carrierId;
+        g_flags[t].atBase = nf.atBase != 0;
+    }
 
-                // Vehicle states
-                if (offset + 1 <= len) {
-                    uint8_t numVehicles = buf[offset++];
-                    g_numVehicles = numVehicles;
-                    for (uint8_t i = 0; i < numVehicles && offset + (int)sizeof(NetVehicleState) <= len; i++) {
-                        NetVehicleState nv;
-                        memcpy(&nv, buf + offset, sizeof(nv));
-                        offset += sizeof(nv);
-                        if (nv.id < MAX_VEHICLES) {
-                            g_vehicles[nv.id].type = (VehicleType)nv.type;
-                            g_vehicles[nv.id].position = {nv.x, nv.y, nv.z};
-                            g_vehicles[nv.id].yaw = nv.yaw;
-                            g_vehicles[nv.id].pitch = nv.pitch;
-                            g_vehicles[nv.id].turretYaw = nv.turretYaw;
-                            g_vehicles[nv.id].health = nv.health;
-                            g_vehicles[nv.id].driverId = nv.driverId;
-                            g_vehicles[nv.id].active = nv.active != 0;
-                            g_vehicles[nv.id].rotorAngle = nv.rotorAngle;
-                        }
-                    }
-                }
+    // Tornado states
+    g_numTornados = 0;
+    for (int i = 0; i < MAX_TORNADOS; i++) {
+        g_tornados[i].active = snap.tornadoPresent[i] != 0;
+        if (!g_tornados[i].active) {
+            g_tornadoHistory[i].clear();
+            continue;
+        }
+        const NetTornadoState& nt = snap.tornados[i];
+        InterpState is;
+        is.position = {nt.x, nt.y, nt.z};
+        is.yaw = nt.rotation;
+        g_tornadoHistory[i].record(snap.tick, is);
+        g_tornados[i].position = {nt.x, nt.y, nt.z};
+        g_tornados[i].radius = nt.radius;
+        g_tornados[i].rotation = nt.rotation;
+        g_numTornados++;
+    }
 
-                // Flag states
-                for (int t = 0; t < 2 && offset + (int)sizeof(NetFlagState) <= len; t++) {
-                    NetFlagState nf;
-                    memcpy(&nf, buf + offset, sizeof(nf));
-                    offset += sizeof(nf);
-                    g_flags[t].position = {nf.x, nf.y, nf.z};
-                    g_flags[t].carrierId = nf.carrierId;
-                    g_flags[t].atBase = nf.atBase != 0;
-                }
+    // Update local player state from server
+    if (g_localId >= 0 && g_localId < MAX_PLAYERS) {
+        auto& lp = g_players[g_localId];
+        if (predictingLocalPlayer()) {
+            g_predictor.reconcile(ackInputSeq, serverPos, lp, g_map);
+        } else {
+            if (snap.playerPresent[g_localId]) lp.position = serverPos;
+            g_predictor.reset();
+        }
+        if (lp.state == PlayerState::DEAD && g_clientState == ClientState::PLAYING) {
+            g_clientState = ClientState::DEAD;
+        } else if (lp.state == PlayerState::ALIVE && g_clientState == ClientState::DEAD) {
+            g_clientState = ClientState::PLAYING;
+        }
+    }
+}
 
-                // Tornado states
-                if (offset + 1 <= len) {
-                    uint8_t numTornados = buf[offset++];
-                    g_numTornados = numTornados;
-                    int ti = 0;
-                    for (uint8_t i = 0; i < numTornados && offset + (int)sizeof(NetTornadoState) <= len; i++) {
-                        NetTornadoState nt;
-                        memcpy(&nt, buf + offset, sizeof(nt));
-                        offset += sizeof(nt);
-                        if (ti < MAX_TORNADOS) {
-                            g_tornados[ti].position = {nt.x, nt.y, nt.z};
-                            g_tornados[ti].radius = nt.radius;
-                            g_tornados[ti].rotation = nt.rotation;
-                            g_tornados[ti].active = nt.active != 0;
-                            ti++;
-                        }
-                    }
-                    // Mark remaining as inactive
-                    for (; ti < MAX_TORNADOS; ti++) g_tornados[ti].active = false;
+// Apply what the network thread received since the last frame: join
+// answers and reliable events in order, then snapshots in order
+static void applyNetUpdates() {
+    PROFILE_SCOPE("net_apply");
+    while (const ClientNet::Message* m = g_net.messages.front()) {
+        switch ((ServerPacket)m->data[0]) {
+            case ServerPacket::JOIN_ACK: {
+                if (g_clientState != ClientState::CONNECTING) break;
+                if (m->len < (int)sizeof(JoinAckPacket)) {
+                    // Servers before protocol versioning sent a shorter ack
+                    g_net.disconnect(false);
+                    g_clientState = ClientState::MENU;
+                    snprintf(g_statusMsg, sizeof(g_statusMsg), "Server runs an older protocol");
+                    return;
                 }
-
-                // Update local player state from server
-                if (g_localId >= 0 && g_localId < MAX_PLAYERS) {
-                    auto& lp = g_players[g_localId];
-                    if (lp.state == PlayerState::DEAD && g_clientState == ClientState::PLAYING) {
-                        g_clientState = ClientState::DEAD;
-                    } else if (lp.state == PlayerState::ALIVE && g_clientState == ClientState::DEAD) {
-                        g_clientState = ClientState::PLAYING;
+                JoinAckPacket ack;
+                memcpy(&ack, m->data, sizeof(ack));
+                if (ack.result != (uint8_t)JoinResult::OK) {
+                    g_net.disconnect(false);
+                    g_clientState = ClientState::MENU;
+                    if (ack.result == (uint8_t)JoinResult::VERSION_MISMATCH) {
+                        snprintf(g_statusMsg, sizeof(g_statusMsg), "Protocol mismatch (server v%u, client v%u)",
+                                 ack.protocolVersion, PROTOCOL_VERSION);
+                    } else {
+                        snprintf(g_statusMsg, sizeof(g_statusMsg), "Server full");
                     }
+                    return;
                 }
+                g_localId = ack.playerId;
+                g_clientState = ClientState::PLAYING;
+                glfwSetInputMode(g_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+                g_firstMouse = true;
+                printf("Joined server as player %d\n", g_localId);
                 break;
             }
 
-            case ServerPacket::PLAYER_HIT: {
-                if (len >= (int)sizeof(PlayerHitPacket)) {
-                    PlayerHitPacket pkt;
-                    memcpy(&pkt, buf, sizeof(pkt));
-                    // Could add hit indicator here
-                }
+            case ServerPacket::PLAYER_HIT:
+                // Could add hit indicator here
                 break;
-            }
 
             case ServerPacket::PLAYER_DIED: {
-                if (len >= (int)sizeof(PlayerDiedPacket)) {
-                    PlayerDiedPacket pkt;
-                    memcpy(&pkt, buf, sizeof(pkt));
-
-                    char msg[128];
-                    const char* killerName = g_players[pkt.killerId].name[0] ? g_players[pkt.killerId].name : "Bot";
-                    const char* victimName = g_players[pkt.victimId].name[0] ? g_players[pkt.victimId].name : "Bot";
-                    snprintf(msg, sizeof(msg), "%s killed %s", killerName, victimName);
-                    addKillFeedEntry(msg);
-                }
+                if (m->len < (int)sizeof(PlayerDiedPacket)) break;
+                PlayerDiedPacket died;
+                memcpy(&died, m->data, sizeof(died));
+                if (died.killerId >= MAX_PLAYERS || died.victimId >= MAX_PLAYERS) break;
+                char msg[128];
+                snprintf(msg, sizeof(msg), "%s killed %s",
+                         died.killerIsBot ? "Bot" : "Player", died.victimIsBot ? "Bot" : "Player");
+                addKillFeedEntry(msg);
                 break;
             }
 
             default: break;
         }
+        g_net.messages.pop();
+    }
+
+    while (const ClientNet::Snapshot* s = g_net.snapshots.front()) {
+        applySnapshot(s->snap, s->ackInputSeq);
+        g_net.snapshots.pop();
+    }
+}
+
+// Predict the inputs the network thread sent since the last frame
+static void runInputTicks() {
+    g_inputAccum += g_deltaTime;
+    while (const ClientNet::SentInput* s = g_net.sentInputs.front()) {
+        if (predictingLocalPlayer())
+            g_predictor.predict(s->seq, s->input, g_players[g_localId], g_map);
+        g_inputAccum = std::chrono::duration<float>(std::chrono::steady_clock::now() - s->sentAt).count();
+        g_net.sentInputs.pop();
+    }
+    g_predictor.update(g_deltaTime);
+}
+
+// Move remote entities to their interpolated state for this frame. The local
+// player, and the vehicle it drives, keep the newest server state.
+static void interpolateEntities() {
+    PROFILE_SCOPE("interp");
+    g_interpClock.advance(g_deltaTime);
+    g_net.setViewTick(g_interpClock.valid() ? g_interpClock.renderTick() : 0.0);
+    if (g_interpDelay <= 0 || !g_interpClock.valid()) return;
+
+    double tick = g_interpClock.renderTick();
+    double until = g_interpClock.extrapolateUntil();
+    int ownVehicle = g_localId >= 0 ? g_players[g_localId].vehicleId : -1;
+
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (i == g_localId || g_playerHistory[i].empty()) continue;
+        InterpState s = g_playerHistory[i].sample(tick, until);
+        g_players[i].position = s.position;
+        g_players[i].yaw = s.yaw;
+        g_players[i].pitch = s.pitch;
+    }
+    for (int i = 0; i < g_numVehicles; i++) {
+        if (i == ownVehicle || g_vehicleHistory[i].empty()) continue;
+        InterpState s = g_vehicleHistory[i].sample(tick, until);
+        g_vehicles[i].position = s.position;
+        g_vehicles[i].yaw = s.yaw;
+        g_vehicles[i].pitch = s.pitch;
+        g_vehicles[i].turretYaw = s.turretYaw;
+        g_vehicles[i].rotorAngle = s.rotorAngle;
+    }
+    for (int t = 0; t < 2; t++) {
+        if (g_flags[t].carrierId == g_localId || g_flagHistory[t].empty()) continue;
+        g_flags[t].position = g_flagHistory[t].sample(tick, until).position;
+    }
+    for (int i = 0; i < MAX_TORNADOS; i++) {
+        if (!g_tornados[i].active || g_tornadoHistory[i].empty()) continue;
+        InterpState s = g_tornadoHistory[i].sample(tick, until);
+        g_tornados[i].position = s.position;
+        g_tornados[i].rotation = s.yaw;
     }
 }
 
@@ -471,6 +562,7 @@ static void captureInput() {
 
     g_currentInput.yaw = g_yaw;
     g_currentInput.pitch = g_pitch;
+    g_net.setInput(g_currentInput);
 }
 
 // ============================================================================
@@ -489,26 +581,96 @@ static void startConnect() {
         return;
     }
 
-    if (!g_socket.open()) {
+    // The network thread resends the join until the server answers
+    if (!g_net.connect(UDPSocket::makeAddr(g_ipBuf, port))) {
         snprintf(g_statusMsg, sizeof(g_statusMsg), "Failed to create socket");
         return;
     }
-    g_socket.setNonBlocking(true);
 
-    g_serverAddr = UDPSocket::makeAddr(g_ipBuf, port);
+    // New session: nothing interpolated or predicted yet
+    for (auto& h : g_playerHistory) h.clear();
+    for (auto& h : g_vehicleHistory) h.clear();
+    for (auto& h : g_tornadoHistory) h.clear();
+    for (auto& h : g_flagHistory) h.clear();
+    g_interpClock.reset();
+    g_predictor.reset();
     g_clientState = ClientState::CONNECTING;
     g_connectTimer = 5.0f;
-    g_connectRetryTimer = 0;
-
-    sendJoin();
     printf("Connecting to %s:%d...\n", g_ipBuf, port);
 }
 
+// ============================================================================
+// Scene Rendering
+// ============================================================================
+
+// Bounding spheres for the frustum and visibility-set tests, generous enough
+// to cover every part (held weapon, wings and rotors, flag fabric)
+constexpr float PLAYER_CULL_RADIUS  = 1.5f;
+constexpr float PICKUP_CULL_RADIUS  = 1.0f;
+constexpr float VEHICLE_CULL_RADIUS = 10.0f;
+constexpr float FLAG_CULL_RADIUS    = 2.5f;
+
+// First alive player the local player's shot would hit, skipping players
+// the server only lists
+static int raycastPlacedPlayers(const Vec3& origin, const Vec3& dir, float maxDist, float& hitDist) {
+    float x[MAX_PLAYERS], y[MAX_PLAYERS], z[MAX_PLAYERS];
+    uint8_t hittable[MAX_PLAYERS];
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        x[i] = g_players[i].position.x;
+        y[i] = g_players[i].position.y;
+        z[i] = g_players[i].position.z;
+        hittable[i] = g_players[i].state == PlayerState::ALIVE && g_playerRelevant[i];
+    }
+    return GameMap::raycastPlayers(origin, dir, maxDist, x, y, z, hittable, MAX_PLAYERS, g_localId, hitDist);
+}
+
+// Players, pickups, vehicles, flags and tornados for the current beginFrame
+static void renderEntities() {
+    PROFILE_SCOPE("r_entities");
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (!g_playerRelevant[i]) continue;
+        Vec3 center = g_players[i].position + Vec3{0, PLAYER_HEIGHT * 0.5f, 0};
+        if (!g_renderer.isVisible(center, PLAYER_CULL_RADIUS)) continue;
+        if (!g_map.potentiallyVisible(g_renderer.cameraPosition(), center, PLAYER_CULL_RADIUS)) continue;
+        g_renderer.renderPlayer(g_players[i], i == g_localId);
+    }
+    for (const auto& wp : g_weaponPickups) {
+        if (!g_renderer.isVisible(wp.position, PICKUP_CULL_RADIUS)) continue;
+        g_renderer.renderWeaponPickup(wp, g_time);
+    }
+    for (int i = 0; i < g_numVehicles; i++) {
+        if (!g_renderer.isVisible(g_vehicles[i].position, VEHICLE_CULL_RADIUS)) continue;
+        if (!g_map.potentiallyVisible(g_renderer.cameraPosition(), g_vehicles[i].position, VEHICLE_CULL_RADIUS)) continue;
+        g_renderer.renderVehicle(g_vehicles[i], g_time);
+    }
+    for (int t = 0; t < 2; t++) {
+        Vec3 center = g_flags[t].position + Vec3{0, 1.5f, 0};
+        if (!g_renderer.isVisible(center, FLAG_CULL_RADIUS)) continue;
+        g_renderer.renderFlag(g_flags[t], t, g_time);
+    }
+    for (int i = 0; i < MAX_TORNADOS; i++) {
+        if (g_tornados[i].active) g_renderer.renderTornado(g_tornados[i], g_time);
+    }
+}
+
 // ============================================================================
 // Main Client Loop
 // ============================================================================
 
-int main(int, char**) {
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-interp") == 0 && i + 1 < argc) {
+            g_interpDelay = atoi(argv[++i]) / 1000.0f;
+        } else if (strcmp(argv[i], "-nopredict") == 0) {
+            g_predictMovement = false;
+        } else if (strcmp(argv[i], "-profile") == 0 && i + 1 < argc) {
+            g_profileInterval = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "-map") == 0 && i + 1 < argc) {
+            g_mapCachePath = argv[++i];
+        }
+    }
+    g_interpClock.setDelay(g_interpDelay);
+
     // Init GLFW
     if (!glfwInit()) {
         fprintf(stderr, "Failed to init GLFW\n");
@@ -549,8 +711,19 @@ int main(int, char**) {
     // Init renderer
     g_renderer.init(g_screenW, g_screenH);
 
-    // Build map
-    g_map.buildArcticMap();
+    // Build map, or load it with its mesh from a cache (written on a miss)
+    if (g_mapCachePath && g_map.loadCache(g_mapCachePath, true)) {
+        printf("Map loaded from cache %s\n", g_mapCachePath);
+    } else {
+        g_map.buildArcticMap();
+        g_map.bakeMesh();
+        g_map.bakeVisibility();
+        if (g_mapCachePath && !g_map.saveCache(g_mapCachePath)) {
+            fprintf(stderr, "Failed to write map cache %s\n", g_mapCachePath);
+        }
+    }
+    if (g_map.meshVertices().empty()) g_map.bakeMesh(); // Cache written without a mesh
+    if (g_map.visibility().empty()) g_map.bakeVisibility();
     g_renderer.buildMapMesh(g_map);
 
     printf("Arctic Assault Client started\n");
@@ -562,6 +735,7 @@ int main(int, char**) {
     }
 
     auto lastTime = std::chrono::high_resolution_clock::now();
+    float profileTimer = 0;
 
     while (!glfwWindowShouldClose(g_window)) {
         glfwPollEvents();
@@ -606,18 +780,11 @@ int main(int, char**) {
             }
 
             case ClientState::CONNECTING: {
-                receivePackets();
+                applyNetUpdates();
 
                 g_connectTimer -= g_deltaTime;
-                g_connectRetryTimer -= g_deltaTime;
-
-                if (g_connectRetryTimer <= 0) {
-                    sendJoin();
-                    g_connectRetryTimer = 0.5f;
-                }
-
-                if (g_connectTimer <= 0) {
-                    g_socket.close();
+                if (g_clientState == ClientState::CONNECTING && g_connectTimer <= 0) {
+                    g_net.disconnect(false);
                     g_clientState = ClientState::MENU;
                     snprintf(g_statusMsg, sizeof(g_statusMsg), "Connection timed out");
                 }
@@ -683,8 +850,7 @@ int main(int, char**) {
                         };
                         dir = dir.normalize();
                         float playerDist = range;
-                        int hitP = GameMap::raycastPlayers(eyePos, dir, range,
-                                                          g_players, MAX_PLAYERS, g_localId, playerDist);
+                        int hitP = raycastPlacedPlayers(eyePos, dir, range, playerDist);
                         Vec3 wallHit;
                         float wallDist;
                         bool hitWall = g_map.raycast(eyePos, dir, range, wallHit, wallDist);
@@ -700,9 +866,6 @@ int main(int, char**) {
 
                         g_renderer.spawnMuzzleSpark(eyePos + dir * 0.5f, dir);
                     }
-
-                    if (!inVehicle)
-                        tickPlayer(g_players[g_localId], g_currentInput, g_map, g_deltaTime);
                 }
 
                 // Detect damage taken
@@ -714,11 +877,12 @@ int main(int, char**) {
                     g_lastHealth = curHealth;
                 }
 
-                // Send input to server
-                sendInput();
+                // Predict the inputs sent since the last frame
+                runInputTicks();
 
-                // Receive server updates
-                receivePackets();
+                // Apply server updates
+                applyNetUpdates();
+                interpolateEntities();
 
                 // Update particles and footprints
                 g_renderer.updateParticles(g_deltaTime);
@@ -747,7 +911,9 @@ int main(int, char**) {
                 float renderYaw = g_yaw;
                 float renderPitch = g_pitch;
                 if (g_localId >= 0) {
-                    camPos = g_players[g_localId].position;
+                    camPos = predictingLocalPlayer()
+                        ? g_predictor.renderPosition(g_players[g_localId], g_inputAccum / TICK_DURATION)
+                        : g_players[g_localId].position;
                     if (g_players[g_localId].vehicleId >= 0) {
                         // In vehicle: use vehicle position, higher camera
                         int vid = g_players[g_localId].vehicleId;
@@ -772,33 +938,8 @@ int main(int, char**) {
                 // Snow
                 g_renderer.spawnSnow(camPos);
 
-                // Render other players
-                for (int i = 0; i < MAX_PLAYERS; i++) {
-                    bool isLocal = (i == g_localId);
-                    g_renderer.renderPlayer(g_players[i], isLocal);
-                }
-
-                // Render weapon pickups
-                for (const auto& wp : g_weaponPickups) {
-                    g_renderer.renderWeaponPickup(wp, g_time);
-                }
-
-                // Render vehicles
-                for (int i = 0; i < g_numVehicles; i++) {
-                    g_renderer.renderVehicle(g_vehicles[i], g_time);
-                }
-
-                // Render flags
-                for (int t = 0; t < 2; t++) {
-                    g_renderer.renderFlag(g_flags[t], t, g_time);
-                }
-
-                // Render tornados
-                for (int i = 0; i < MAX_TORNADOS; i++) {
-                    if (g_tornados[i].active) {
-                        g_renderer.renderTornado(g_tornados[i], g_time);
-                    }
-                }
+                // Players, pickups, vehicles, flags, tornados
+                renderEntities();
 
                 // Particles (3D scene)
                 g_renderer.renderParticles();
@@ -973,8 +1114,9 @@ int main(int, char**) {
             }
 
             case ClientState::DEAD: {
-                receivePackets();
-                sendInput(); // Keep sending so server knows we're alive
+                applyNetUpdates();
+                interpolateEntities();
+                runInputTicks(); // Inputs keep going out so the server knows we're alive
 
                 g_renderer.updateParticles(g_deltaTime);
                 g_renderer.updateFootprints(g_deltaTime);
@@ -991,21 +1133,7 @@ int main(int, char**) {
                 g_renderer.spawnSnow(camPos);
                 g_renderer.renderParticles();
 
-                for (int i = 0; i < MAX_PLAYERS; i++) {
-                    g_renderer.renderPlayer(g_players[i], i == g_localId);
-                }
-                for (const auto& wp : g_weaponPickups) {
-                    g_renderer.renderWeaponPickup(wp, g_time);
-                }
-                for (int i = 0; i < g_numVehicles; i++) {
-                    g_renderer.renderVehicle(g_vehicles[i], g_time);
-                }
-                for (int t = 0; t < 2; t++) {
-                    g_renderer.renderFlag(g_flags[t], t, g_time);
-                }
-                for (int i = 0; i < MAX_TORNADOS; i++) {
-                    if (g_tornados[i].active) g_renderer.renderTornado(g_tornados[i], g_time);
-                }
+                renderEntities();
 
                 float timer = g_localId >= 0 ? g_players[g_localId].respawnTimer : RESPAWN_TIME;
                 g_renderer.renderDeathScreen(timer, g_screenW, g_screenH);
@@ -1022,15 +1150,24 @@ int main(int, char**) {
             }
         }
 
-        glfwSwapBuffers(g_window);
+        {
+            PROFILE_SCOPE("swap");
+            glfwSwapBuffers(g_window);
+        }
+
+        if (g_profileInterval > 0) {
+            profileTimer += g_deltaTime;
+            if (profileTimer >= g_profileInterval) {
+                printf("Frame profile (%.0f s):\n", profileTimer);
+                Profiler::report(stdout, profileTimer);
+                profileTimer = 0;
+            }
+        }
     }
 
     // Cleanup
-    if (g_socket.isValid()) {
-        DisconnectPacket pkt;
-        g_socket.sendTo(&pkt, sizeof(pkt), g_serverAddr);
-        g_socket.close();
-    }
+    if (g_net.eventsLost() > 0) printf("%u reliable event(s) lost\n", g_net.eventsLost());
+    if (g_net.connected()) g_net.disconnect(true);
 
     g_renderer.shutdown();
     glfwDestroyWindow(g_window);
@@ -0,0 +1,205 @@
+#include "client_net.h"
+#include "profiler.h"
+#include <poll.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+bool ClientNet::connect(const sockaddr_in& server) {
+    disconnect(false);
+    if (!socket_.open()) return false;
+    socket_.setNonBlocking(true);
+    server_ = server;
+
+    // New session: no baselines until the first full snapshot arrives
+    for (WorldSnapshot& slot : baselines_.slots) slot.valid = false;
+    lastSnapshotTick_ = NO_SNAPSHOT_ACK;
+    nextEventSeq_ = 0;
+    eventsLost_.store(0);
+    inputSeq_ = 0;
+    joined_ = false;
+    rejected_ = false;
+    keys_.store(0);
+    latchedKeys_.store(0);
+    classSelect_.store(0xFF);
+    viewTick_.store(0);
+
+    stop_.store(false);
+    thread_ = std::thread(&ClientNet::run, this);
+    return true;
+}
+
+void ClientNet::disconnect(bool sendDisconnect) {
+    if (thread_.joinable()) {
+        stop_.store(true);
+        thread_.join();
+    }
+    if (socket_.isValid()) {
+        if (sendDisconnect) {
+            DisconnectPacket pkt;
+            socket_.sendTo(&pkt, sizeof(pkt), server_);
+        }
+        socket_.close();
+    }
+    snapshots.clear();
+    messages.clear();
+    sentInputs.clear();
+}
+
+void ClientNet::setInput(const InputState& input) {
+    keys_.store(input.keys & ~EDGE_KEYS, std::memory_order_relaxed);
+    latchedKeys_.fetch_or(input.keys, std::memory_order_relaxed);
+    yaw_.store(input.yaw, std::memory_order_relaxed);
+    pitch_.store(input.pitch, std::memory_order_relaxed);
+}
+
+// ============================================================================
+// Network Thread
+// ============================================================================
+
+void ClientNet::run() {
+    using Clock = std::chrono::steady_clock;
+    const auto tick = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(TICK_DURATION));
+    const auto joinRetry = std::chrono::milliseconds(500);
+    auto nextSend = Clock::now();
+    auto nextJoin = nextSend;
+
+    while (!stop_.load()) {
+        auto now = Clock::now();
+        if (!joined_ && !rejected_ && now >= nextJoin) {
+            JoinPacket pkt;
+            snprintf(pkt.name, sizeof(pkt.name), "Player");
+            socket_.sendTo(&pkt, sizeof(pkt), server_);
+            nextJoin = now + joinRetry;
+        }
+        // One input per elapsed server tick; a long stall is not replayed tick by tick
+        for (int ticks = 0; now >= nextSend; ticks++) {
+            if (ticks == 4) {
+                nextSend = now + tick;
+                break;
+            }
+            if (joined_) sendInput();
+            nextSend += tick;
+        }
+
+        // Sleep until a packet arrives or the next send is due
+        auto wake = joined_ || rejected_ ? nextSend : std::min(nextSend, nextJoin);
+        int ms = (int)std::chrono::ceil<std::chrono::milliseconds>(wake - Clock::now()).count();
+        if (ms > 0) {
+            pollfd pfd = {socket_.fd(), POLLIN, 0};
+            poll(&pfd, 1, ms);
+        }
+        receive();
+    }
+}
+
+void ClientNet::receive() {
+    PROFILE_SCOPE("net_recv");
+    static thread_local RecvBatch batch(16, 16384);
+
+    while (socket_.recvBatch(batch) > 0) {
+        for (int i = 0; i < batch.count(); i++) {
+            const RecvBatch::Packet& pkt = batch[i];
+            if (pkt.len < 1) continue;
+
+            switch ((ServerPacket)pkt.data[0]) {
+                case ServerPacket::JOIN_ACK: {
+                    if (joined_ || rejected_) break; // Answer to a resent join
+                    // A short ack is from a server older than protocol versioning
+                    const JoinAckPacket* ack = pkt.as<JoinAckPacket>();
+                    if (ack && ack->result == (uint8_t)JoinResult::OK) joined_ = true;
+                    else rejected_ = true;
+                    pushMessage(pkt.data, std::min(pkt.len, (int)sizeof(Message::data)));
+                    break;
+                }
+                case ServerPacket::SNAPSHOT:
+                    if (joined_) handleSnapshot(pkt.data, pkt.len);
+                    break;
+                default:
+                    break; // Events only arrive inside snapshots
+            }
+        }
+    }
+}
+
+void ClientNet::handleSnapshot(const uint8_t* data, int len) {
+    SnapshotPacket hdr;
+    if (!peekSnapshotHeader(data, len, hdr)) return;
+
+    // Events first: they count even in a snapshot too old to apply. The
+    // server starts our events at the join and skips ahead, counted as
+    // lost, only if we fall behind its whole log. One the render thread has
+    // no room for is not acked, so the server sends it again.
+    int32_t skipped = (int32_t)(hdr.firstEventSeq - nextEventSeq_);
+    if (skipped > 0) {
+        eventsLost_.fetch_add((uint32_t)skipped);
+        nextEventSeq_ = hdr.firstEventSeq;
+    }
+    bool eventsOk = forEachSnapshotEvent(data, hdr, [&](uint32_t seq, const uint8_t* event, int eventLen) {
+        if (seq != nextEventSeq_) return;
+        Message* m = messages.beginPush();
+        if (!m) return;
+        memcpy(m->data, event, eventLen);
+        m->len = eventLen;
+        messages.push();
+        nextEventSeq_++;
+    });
+    if (!eventsOk) return;
+
+    // Drop duplicates and packets older than what's decoded
+    if (lastSnapshotTick_ != NO_SNAPSHOT_ACK && hdr.serverTick <= lastSnapshotTick_) return;
+    const WorldSnapshot* base = nullptr;
+    if (hdr.baseTick != NO_SNAPSHOT_ACK) {
+        base = baselines_.find(hdr.baseTick);
+        if (!base) return; // Baseline lost; server falls back to full once our ack ages out
+    }
+    WorldSnapshot& snap = baselines_.slotFor(hdr.serverTick);
+    if (!decodeSnapshot(data, len, base, snap)) return;
+    lastSnapshotTick_ = snap.tick;
+
+    if (Snapshot* out = snapshots.beginPush()) {
+        out->snap = snap;
+        out->ackInputSeq = hdr.ackInputSeq;
+        snapshots.push();
+    }
+}
+
+void ClientNet::sendInput() {
+    InputState input;
+    input.keys = keys_.load(std::memory_order_relaxed) | latchedKeys_.exchange(0, std::memory_order_relaxed);
+    input.yaw = yaw_.load(std::memory_order_relaxed);
+    input.pitch = pitch_.load(std::memory_order_relaxed);
+
+    InputPacket pkt;
+    pkt.seq = ++inputSeq_;
+    pkt.keys = input.keys;
+    pkt.yaw = input.yaw;
+    pkt.pitch = input.pitch;
+    pkt.classSelect = classSelect_.exchange(0xFF);
+    pkt.ackSnapshotTick = lastSnapshotTick_;
+    pkt.ackEventSeq = nextEventSeq_;
+    // Tell the server when the remote players we aim at were, for lag compensation
+    double view = viewTick_.load(std::memory_order_relaxed);
+    if (view >= 1.0) {
+        pkt.viewTick = (uint32_t)view;
+        pkt.viewTickFrac = (uint8_t)((view - pkt.viewTick) * 256.0);
+    } else {
+        pkt.viewTick = lastSnapshotTick_;
+    }
+    socket_.sendTo(&pkt, sizeof(pkt), server_);
+
+    if (SentInput* s = sentInputs.beginPush()) {
+        s->seq = pkt.seq;
+        s->input = input;
+        s->sentAt = std::chrono::steady_clock::now();
+        sentInputs.push();
+    }
+}
+
+void ClientNet::pushMessage(const uint8_t* data, int len) {
+    Message* m = messages.beginPush();
+    if (!m) return;
+    memcpy(m->data, data, len);
+    m->len = len;
+    messages.push();
+}
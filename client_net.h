@@ -0,0 +1,97 @@
+#pragma once
+
+#include "common.h"
+#include "network.h"
+#include "snapshot.h"
+#include "spsc_queue.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// ============================================================================
+// Client Network Thread
+// ============================================================================
+
+// The client's socket, run on a thread of its own so a long frame (a VSync
+// wait in the swap, a hitch) never holds up the network. The thread resends
+// joins until answered, sends one InputPacket per server tick from the
+// newest input the render thread published, decodes snapshots against its
+// own baselines and acks reliable events. What it receives is handed to the
+// render thread through single-producer single-consumer queues, drained
+// once per frame; if the render thread stalls long enough to fill one, the
+// newest items are dropped.
+class ClientNet {
+public:
+    // A decoded snapshot, in arrival order
+    struct Snapshot {
+        WorldSnapshot snap;
+        uint32_t      ackInputSeq = 0; // Newest input the server had applied
+    };
+    // A JOIN_ACK, or a reliable event (PlayerHitPacket, PlayerDiedPacket),
+    // as received and in order
+    struct Message {
+        uint8_t data[16];
+        int     len = 0;
+    };
+    // An input as it was sent, for prediction
+    struct SentInput {
+        uint32_t   seq = 0;
+        InputState input;
+        std::chrono::steady_clock::time_point sentAt;
+    };
+
+    // Keys sent with only the next input after a press, never held
+    static constexpr uint16_t EDGE_KEYS = InputState::KEY_USE;
+
+    ~ClientNet() { disconnect(false); }
+
+    // Open a socket to the server and start the thread
+    bool connect(const sockaddr_in& server);
+    // Stop the thread and close the socket, first telling the server if
+    // sendDisconnect. Anything still queued is dropped.
+    void disconnect(bool sendDisconnect);
+    bool connected() const { return thread_.joinable(); }
+    // Reliable events the server skipped because we fell too far behind
+    uint32_t eventsLost() const { return eventsLost_.load(); }
+
+    // Render thread: the input to send from now on. Keys down in any frame
+    // go out with at least the next input.
+    void setInput(const InputState& input);
+    void selectClass(uint8_t cls) { classSelect_.store(cls); } // Sent once
+    // Server tick remote players are drawn at, for lag compensation; 0 = none yet
+    void setViewTick(double tick) { viewTick_.store(tick); }
+
+    SpscQueue<Snapshot, 32>  snapshots;
+    SpscQueue<Message, 64>   messages;
+    SpscQueue<SentInput, 64> sentInputs;
+
+private:
+    void run();
+    void receive();
+    void handleSnapshot(const uint8_t* data, int len);
+    void sendInput();
+    void pushMessage(const uint8_t* data, int len);
+
+    UDPSocket             socket_;
+    sockaddr_in           server_ = {};
+    std::thread           thread_;
+    std::atomic<bool>     stop_{false};
+
+    // Written by the render thread
+    std::atomic<uint16_t> keys_{0};
+    std::atomic<uint16_t> latchedKeys_{0}; // Keys seen since the last send
+    std::atomic<float>    yaw_{0}, pitch_{0};
+    std::atomic<uint8_t>  classSelect_{0xFF};
+    std::atomic<double>   viewTick_{0};
+
+    // Written by the network thread
+    std::atomic<uint32_t> eventsLost_{0};
+
+    // Network thread only
+    bool                  joined_ = false;
+    bool                  rejected_ = false;
+    uint32_t              inputSeq_ = 0;
+    SnapshotRing          baselines_;
+    uint32_t              lastSnapshotTick_ = NO_SNAPSHOT_ACK;
+    uint32_t              nextEventSeq_ = 0; // Every reliable event before this one arrived
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "simd.h"
 #include <cmath>
 #include <cstdint>
 #include <cstring>
@@ -125,8 +126,20 @@ struct Mat4 {
         return r;
     }
 
+    // Column-major product. The SIMD path accumulates each result column in
+    // the same order as the scalar loop, so both give identical floats.
     Mat4 operator*(const Mat4& o) const {
         Mat4 r;
+#if FPS_SIMD
+        const simd::F4 col[4] = {simd::load(&m[0]), simd::load(&m[4]),
+                                 simd::load(&m[8]), simd::load(&m[12])};
+        for (int c = 0; c < 4; c++) {
+            simd::F4 sum = simd::zero();
+            for (int k = 0; k < 4; k++)
+                sum = simd::add(sum, simd::mul(col[k], simd::splat(o.m[c * 4 + k])));
+            simd::store(&r.m[c * 4], sum);
+        }
+#else
         for (int c = 0; c < 4; c++)
             for (int row = 0; row < 4; row++) {
                 float sum = 0;
@@ -134,6 +147,7 @@ struct Mat4 {
                     sum += m[k * 4 + row] * o.m[c * 4 + k];
                 r.m[c * 4 + row] = sum;
             }
+#endif
         return r;
     }
 };
@@ -206,6 +220,8 @@ constexpr float  RESPAWN_TIME     = 3.0f;
 constexpr float  WEAPON_RESPAWN   = 15.0f;
 constexpr int    MAX_HEALTH       = 100;
 constexpr float  PI               = 3.14159265358979f;
+constexpr float  WORLD_BOUND      = 194.5f;  // Players are clamped to +-WORLD_BOUND in XZ
+constexpr float  MAX_ALTITUDE     = 100.0f;  // Flight ceiling for aircraft
 
 // Vehicle constants
 constexpr int    MAX_VEHICLES     = 30;
@@ -307,22 +323,24 @@ struct InputState {
     static constexpr uint16_t KEY_ABILITY= 0x400; // Q key: use class ability
 };
 
+// Per-tick simulation state only, hottest fields first; 68 bytes, so a
+// pass over every slot touches 8.5 KB. Rarely read data such as the name
+// lives outside it (see PlayerProfile on the server).
 struct PlayerData {
     Vec3        position = {0, 0, 0};
-    float       yaw = 0, pitch = 0;
     Vec3        velocity = {0, 0, 0};
-    int         health = MAX_HEALTH;
-    WeaponType  currentWeapon = WeaponType::PISTOL;
-    int         ammo = 12;
+    float       yaw = 0, pitch = 0;
     PlayerState state = PlayerState::DISCONNECTED;
     uint8_t     teamId = 0;
-    char        name[32] = {};
-    float       respawnTimer = 0;
-    float       fireCooldown = 0;
     bool        isBot = false;
-    int16_t     vehicleId = -1;    // -1 = on foot, >=0 = in vehicle
     bool        isDriver = false;
+    int16_t     vehicleId = -1;    // -1 = on foot, >=0 = in vehicle
+    WeaponType  currentWeapon = WeaponType::PISTOL;
     PlayerClass playerClass = PlayerClass::ASSAULT;
+    int         health = MAX_HEALTH;
+    int         ammo = 12;
+    float       fireCooldown = 0;
+    float       respawnTimer = 0;
     float       abilityCooldown = 0;
     bool        spotted = false;   // Recon spot marker
     float       spottedTimer = 0;  // Time remaining for spot
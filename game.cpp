@@ -1,4 +1,14 @@
 #include "game.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <type_traits>
 
 // ============================================================================
 // Map Building Helpers
@@ -429,14 +439,16 @@ void GameMap::buildArcticMap() {
     addBlock({167, 0.0f, -3}, {173, 0.3f, 3}, blue, true);    // Blue base platform
 
     // === WAYPOINTS for bot navigation (many more for big map) ===
+    std::vector<std::vector<int>> links; // Per waypoint while building, flattened at the end
     auto addWP = [&](float x, float y, float z) -> int {
         int idx = (int)waypoints_.size();
-        waypoints_.push_back({{x, y, z}, {}});
+        waypoints_.push_back({{x, y, z}});
+        links.emplace_back();
         return idx;
     };
     auto link = [&](int a, int b) {
-        waypoints_[a].neighbors.push_back(b);
-        waypoints_[b].neighbors.push_back(a);
+        links[a].push_back(b);
+        links[b].push_back(a);
     };
 
     // Road grid waypoints (every ~40 units along roads)
@@ -539,6 +551,322 @@ void GameMap::buildArcticMap() {
     int wpBunkerE = addWP(47, 0.1f, 27);
     link(wpBunkerW, wpField1); link(wpBunkerW, wpE5);
     link(wpBunkerE, wpField4); link(wpBunkerE, wpE6);
+
+    waypointLinks_.clear();
+    for (size_t i = 0; i < waypoints_.size(); i++) {
+        waypoints_[i].firstNeighbor = (uint32_t)waypointLinks_.size();
+        waypoints_[i].numNeighbors = (uint32_t)links[i].size();
+        waypointLinks_.insert(waypointLinks_.end(), links[i].begin(), links[i].end());
+    }
+
+    buildSpatialIndex();
+}
+
+// ============================================================================
+// Map Mesh
+// ============================================================================
+
+static void appendQuad(std::vector<MeshVertex>& verts,
+                       Vec3 p0, Vec3 p1, Vec3 p2, Vec3 p3, Vec3 normal, Vec3 color) {
+    MeshVertex v;
+    v.nx = normal.x; v.ny = normal.y; v.nz = normal.z;
+    v.cr = color.x; v.cg = color.y; v.cb = color.z;
+
+    // Triangle 1
+    v.px = p0.x; v.py = p0.y; v.pz = p0.z; verts.push_back(v);
+    v.px = p1.x; v.py = p1.y; v.pz = p1.z; verts.push_back(v);
+    v.px = p2.x; v.py = p2.y; v.pz = p2.z; verts.push_back(v);
+    // Triangle 2
+    v.px = p0.x; v.py = p0.y; v.pz = p0.z; verts.push_back(v);
+    v.px = p2.x; v.py = p2.y; v.pz = p2.z; verts.push_back(v);
+    v.px = p3.x; v.py = p3.y; v.pz = p3.z; verts.push_back(v);
+}
+
+void appendBoxMesh(std::vector<MeshVertex>& verts, const Vec3& mn, const Vec3& mx, const Vec3& color) {
+    Vec3 c = color;
+    // Front (+Z)
+    appendQuad(verts, {mn.x,mn.y,mx.z},{mx.x,mn.y,mx.z},{mx.x,mx.y,mx.z},{mn.x,mx.y,mx.z}, {0,0,1}, c);
+    // Back (-Z)
+    appendQuad(verts, {mx.x,mn.y,mn.z},{mn.x,mn.y,mn.z},{mn.x,mx.y,mn.z},{mx.x,mx.y,mn.z}, {0,0,-1}, c);
+    // Right (+X)
+    appendQuad(verts, {mx.x,mn.y,mx.z},{mx.x,mn.y,mn.z},{mx.x,mx.y,mn.z},{mx.x,mx.y,mx.z}, {1,0,0}, c);
+    // Left (-X)
+    appendQuad(verts, {mn.x,mn.y,mn.z},{mn.x,mn.y,mx.z},{mn.x,mx.y,mx.z},{mn.x,mx.y,mn.z}, {-1,0,0}, c);
+    // Top (+Y)
+    Vec3 tc = {c.x*1.1f, c.y*1.1f, c.z*1.1f}; // Slightly brighter top
+    appendQuad(verts, {mn.x,mx.y,mx.z},{mx.x,mx.y,mx.z},{mx.x,mx.y,mn.z},{mn.x,mx.y,mn.z}, {0,1,0}, tc);
+    // Bottom (-Y)
+    Vec3 bc = {c.x*0.7f, c.y*0.7f, c.z*0.7f}; // Darker bottom
+    appendQuad(verts, {mn.x,mn.y,mn.z},{mx.x,mn.y,mn.z},{mx.x,mn.y,mx.z},{mn.x,mn.y,mx.z}, {0,-1,0}, bc);
+}
+
+void GameMap::bakeMesh() {
+    meshVertices_.clear();
+    meshChunks_.clear();
+    if (blocks_.empty()) return;
+
+    // Assign each block to the XZ chunk holding its center
+    float minX = 1e30f, minZ = 1e30f, maxX = -1e30f, maxZ = -1e30f;
+    for (const auto& b : blocks_) {
+        Vec3 c = (b.bounds.min + b.bounds.max) * 0.5f;
+        minX = std::min(minX, c.x); maxX = std::max(maxX, c.x);
+        minZ = std::min(minZ, c.z); maxZ = std::max(maxZ, c.z);
+    }
+    int chunksX = (int)((maxX - minX) / MESH_CHUNK_SIZE) + 1;
+    int chunksZ = (int)((maxZ - minZ) / MESH_CHUNK_SIZE) + 1;
+
+    struct BlockRef { int chunk; bool detail; int index; };
+    std::vector<BlockRef> refs;
+    refs.reserve(blocks_.size());
+    for (int i = 0; i < (int)blocks_.size(); i++) {
+        const MapBlock& b = blocks_[i];
+        Vec3 c = (b.bounds.min + b.bounds.max) * 0.5f;
+        Vec3 size = b.bounds.max - b.bounds.min;
+        int cx = std::min((int)((c.x - minX) / MESH_CHUNK_SIZE), chunksX - 1);
+        int cz = std::min((int)((c.z - minZ) / MESH_CHUNK_SIZE), chunksZ - 1);
+        bool detail = !b.isFloor && size.x <= MESH_DETAIL_SIZE &&
+                      size.y <= MESH_DETAIL_SIZE && size.z <= MESH_DETAIL_SIZE;
+        refs.push_back({cz * chunksX + cx, detail, i});
+    }
+    std::stable_sort(refs.begin(), refs.end(), [](const BlockRef& a, const BlockRef& b) {
+        return a.chunk != b.chunk ? a.chunk < b.chunk : a.detail < b.detail;
+    });
+
+    std::vector<MeshVertex>& verts = meshVertices_;
+    verts.reserve(blocks_.size() * 36);
+    for (size_t i = 0; i < refs.size();) {
+        MapMeshChunk chunk;
+        chunk.first = (int)verts.size();
+        chunk.bounds = blocks_[refs[i].index].bounds;
+        size_t end = i;
+        for (; end < refs.size() && refs[end].chunk == refs[i].chunk; end++) {
+            const MapBlock& b = blocks_[refs[end].index];
+            appendBoxMesh(verts, b.bounds.min, b.bounds.max, b.color);
+            if (!refs[end].detail) chunk.coarseCount = (int)verts.size() - chunk.first;
+            chunk.bounds.min = {std::min(chunk.bounds.min.x, b.bounds.min.x),
+                                std::min(chunk.bounds.min.y, b.bounds.min.y),
+                                std::min(chunk.bounds.min.z, b.bounds.min.z)};
+            chunk.bounds.max = {std::max(chunk.bounds.max.x, b.bounds.max.x),
+                                std::max(chunk.bounds.max.y, b.bounds.max.y),
+                                std::max(chunk.bounds.max.z, b.bounds.max.z)};
+        }
+        chunk.count = (int)verts.size() - chunk.first;
+        meshChunks_.push_back(chunk);
+        i = end;
+    }
+}
+
+// ============================================================================
+// Map Cache
+// ============================================================================
+
+namespace {
+
+constexpr char MAP_CACHE_MAGIC[8] = {'F', 'P', 'S', 'M', 'A', 'P', 0, 0};
+
+enum class MapSection : uint32_t {
+    BLOCKS, GRID_LAYOUT, GRID_CELL_START, GRID_CELL_BLOCKS, GRID_LARGE_BLOCKS,
+    SPAWNS, TEAM0_SPAWNS, TEAM1_SPAWNS, PICKUPS, WAYPOINTS, WAYPOINT_LINKS,
+    VEHICLE_SPAWNS, FLAG_BASES, MESH_VERTICES, MESH_CHUNKS, VIS_LAYOUT, VIS_BITS
+};
+
+struct MapCacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t numSections; // MapSectionEntry table follows
+};
+
+// Sections are 8-byte aligned arrays. elemSize catches a struct whose layout
+// changed without a version bump.
+struct MapSectionEntry {
+    uint32_t id;
+    uint32_t elemSize;
+    uint64_t offset; // From the start of the file
+    uint64_t bytes;
+};
+
+struct MapCacheWriter {
+    std::vector<MapSectionEntry> table;
+    std::vector<uint8_t>         data; // Section bytes, offsets relative to here
+
+    template <class T> void add(MapSection id, const T* items, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        while (data.size() % 8) data.push_back(0);
+        table.push_back({(uint32_t)id, (uint32_t)sizeof(T), data.size(), count * sizeof(T)});
+        const uint8_t* bytes = (const uint8_t*)items;
+        data.insert(data.end(), bytes, bytes + count * sizeof(T));
+    }
+    template <class T> void add(MapSection id, const std::vector<T>& v) { add(id, v.data(), v.size()); }
+};
+
+struct MapCacheReader {
+    const uint8_t* data = nullptr;
+    size_t         size = 0;
+    bool           ok = true;
+
+    const MapSectionEntry* find(MapSection id) const {
+        const MapCacheHeader* h = (const MapCacheHeader*)data;
+        const MapSectionEntry* table = (const MapSectionEntry*)(h + 1);
+        for (uint32_t i = 0; i < h->numSections; i++) {
+            if (table[i].id == (uint32_t)id) return &table[i];
+        }
+        return nullptr;
+    }
+    // Copy a section out; a missing optional section reads as empty
+    template <class T> void get(MapSection id, std::vector<T>& out, bool required = true) {
+        out.clear();
+        const MapSectionEntry* e = find(id);
+        if (!e) { ok = ok && !required; return; }
+        if (e->elemSize != sizeof(T) || e->bytes % sizeof(T) || e->offset % 8 ||
+            e->offset > size || e->bytes > size - e->offset) {
+            ok = false;
+            return;
+        }
+        const T* items = (const T*)(data + e->offset);
+        out.assign(items, items + e->bytes / sizeof(T));
+    }
+};
+
+bool indicesBelow(const std::vector<uint32_t>& v, size_t limit) {
+    for (uint32_t i : v) if (i >= limit) return false;
+    return true;
+}
+
+} // namespace
+
+bool GameMap::saveCache(const char* path) const {
+    MapCacheWriter w;
+    const GridLayout& layout = grid_;
+    w.add(MapSection::BLOCKS, blocks_);
+    w.add(MapSection::GRID_LAYOUT, &layout, 1);
+    w.add(MapSection::GRID_CELL_START, grid_.cellStart);
+    w.add(MapSection::GRID_CELL_BLOCKS, grid_.cellBlocks);
+    w.add(MapSection::GRID_LARGE_BLOCKS, grid_.largeBlocks);
+    w.add(MapSection::SPAWNS, spawns_);
+    w.add(MapSection::TEAM0_SPAWNS, teamSpawns_[0]);
+    w.add(MapSection::TEAM1_SPAWNS, teamSpawns_[1]);
+    w.add(MapSection::PICKUPS, pickups_);
+    w.add(MapSection::WAYPOINTS, waypoints_);
+    w.add(MapSection::WAYPOINT_LINKS, waypointLinks_);
+    w.add(MapSection::VEHICLE_SPAWNS, vehicleSpawns_);
+    w.add(MapSection::FLAG_BASES, flagBasePos_, 2);
+    if (!meshVertices_.empty()) {
+        w.add(MapSection::MESH_VERTICES, meshVertices_);
+        w.add(MapSection::MESH_CHUNKS, meshChunks_);
+    }
+    if (!vis_.empty()) {
+        const GridLayout& visLayout = vis_;
+        w.add(MapSection::VIS_LAYOUT, &visLayout, 1);
+        w.add(MapSection::VIS_BITS, vis_.bits);
+    }
+
+    MapCacheHeader header;
+    memcpy(header.magic, MAP_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MAP_CACHE_VERSION;
+    header.numSections = (uint32_t)w.table.size();
+    size_t base = sizeof(header) + w.table.size() * sizeof(MapSectionEntry);
+    base = (base + 7) & ~(size_t)7;
+    for (MapSectionEntry& e : w.table) e.offset += base;
+
+    // Write aside and rename, so a server starting meanwhile never maps half a file
+    std::string tmp = std::string(path) + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    static const uint8_t zeros[8] = {};
+    size_t headBytes = sizeof(header) + w.table.size() * sizeof(MapSectionEntry);
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(w.table.data(), sizeof(MapSectionEntry), w.table.size(), f) == w.table.size() &&
+              fwrite(zeros, 1, base - headBytes, f) == base - headBytes &&
+              fwrite(w.data.data(), 1, w.data.size(), f) == w.data.size();
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path) != 0) {
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool GameMap::loadCache(const char* path, bool withMesh) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MapCacheHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    MapCacheReader r{(const uint8_t*)mapping, size};
+    const MapCacheHeader* h = (const MapCacheHeader*)mapping;
+    if (memcmp(h->magic, MAP_CACHE_MAGIC, sizeof(h->magic)) != 0 || h->version != MAP_CACHE_VERSION ||
+        h->numSections > (size - sizeof(MapCacheHeader)) / sizeof(MapSectionEntry)) {
+        munmap(mapping, size);
+        return false;
+    }
+
+    GameMap m;
+    std::vector<GridLayout> layout;
+    std::vector<Vec3> flagBases;
+    r.get(MapSection::BLOCKS, m.blocks_);
+    r.get(MapSection::GRID_LAYOUT, layout);
+    r.get(MapSection::GRID_CELL_START, m.grid_.cellStart);
+    r.get(MapSection::GRID_CELL_BLOCKS, m.grid_.cellBlocks);
+    r.get(MapSection::GRID_LARGE_BLOCKS, m.grid_.largeBlocks);
+    r.get(MapSection::SPAWNS, m.spawns_);
+    r.get(MapSection::TEAM0_SPAWNS, m.teamSpawns_[0]);
+    r.get(MapSection::TEAM1_SPAWNS, m.teamSpawns_[1]);
+    r.get(MapSection::PICKUPS, m.pickups_);
+    r.get(MapSection::WAYPOINTS, m.waypoints_);
+    r.get(MapSection::WAYPOINT_LINKS, m.waypointLinks_);
+    r.get(MapSection::VEHICLE_SPAWNS, m.vehicleSpawns_);
+    r.get(MapSection::FLAG_BASES, flagBases);
+    if (withMesh) {
+        r.get(MapSection::MESH_VERTICES, m.meshVertices_, false);
+        r.get(MapSection::MESH_CHUNKS, m.meshChunks_, false);
+    }
+    std::vector<GridLayout> visLayout;
+    r.get(MapSection::VIS_LAYOUT, visLayout, false);
+    r.get(MapSection::VIS_BITS, m.vis_.bits, false);
+    munmap(mapping, size);
+    if (!r.ok || layout.size() != 1 || flagBases.size() != 2) return false;
+
+    // The index and graph are trusted by every query, so check they are whole
+    static_cast<GridLayout&>(m.grid_) = layout[0];
+    const BlockGrid& g = m.grid_;
+    if (g.cellsX < 0 || g.cellsZ < 0 || g.cellStart.size() != (size_t)g.numCells() + 1 ||
+        g.cellStart.back() != g.cellBlocks.size() ||
+        !indicesBelow(g.cellStart, g.cellBlocks.size() + 1) ||
+        !indicesBelow(g.cellBlocks, m.blocks_.size()) || !indicesBelow(g.largeBlocks, m.blocks_.size())) {
+        return false;
+    }
+    for (const Waypoint& w : m.waypoints_) {
+        if (w.firstNeighbor > m.waypointLinks_.size() ||
+            w.numNeighbors > m.waypointLinks_.size() - w.firstNeighbor) return false;
+    }
+    for (int link : m.waypointLinks_) {
+        if (link < 0 || link >= (int)m.waypoints_.size()) return false;
+    }
+    for (const MapMeshChunk& c : m.meshChunks_) {
+        if (c.first < 0 || c.count < c.coarseCount || c.coarseCount < 0 ||
+            (size_t)c.first + c.count > m.meshVertices_.size()) return false;
+    }
+
+    if (visLayout.size() == 1) {
+        static_cast<GridLayout&>(m.vis_) = visLayout[0];
+        m.vis_.rowWords = (m.vis_.numCells() + 63) / 64;
+    }
+    if (m.vis_.cellsX < 0 || m.vis_.cellsZ < 0 ||
+        m.vis_.bits.size() != (size_t)m.vis_.numCells() * m.vis_.rowWords) return false;
+
+    m.grid_.bakeBounds(m.blocks_);
+    m.flagBasePos_[0] = flagBases[0];
+    m.flagBasePos_[1] = flagBases[1];
+    m.useSpatialIndex_ = useSpatialIndex_;
+    *this = std::move(m);
+    return true;
 }
 
 // ============================================================================
@@ -559,13 +887,18 @@ int GameMap::findNearestWaypoint(const Vec3& pos) const {
 }
 
 bool GameMap::hasObstacleAhead(const Vec3& pos, float yaw, float checkDist, float& obstacleHeight) const {
+    return hasObstacleAheadImpl(pos, yaw, checkDist, obstacleHeight, usesSpatialIndex());
+}
+
+bool GameMap::hasObstacleAheadImpl(const Vec3& pos, float yaw, float checkDist,
+                                   float& obstacleHeight, bool useGrid) const {
     Vec3 forward = {sinf(yaw), 0, cosf(yaw)};
     // Check at knee height (0.3) and waist height (0.8)
     for (float h = 0.3f; h <= 1.2f; h += 0.3f) {
         Vec3 probe = pos + Vec3{0, h, 0};
         Vec3 hitPt;
         float hitDist;
-        if (raycast(probe, forward, checkDist, hitPt, hitDist)) {
+        if (raycastImpl(probe, forward, checkDist, hitPt, hitDist, useGrid)) {
             // Found obstacle - check how tall it is
             // Probe upward from the hit point to find the top
             Vec3 upProbe = hitPt + Vec3{-forward.x * 0.1f, 0, -forward.z * 0.1f};
@@ -573,11 +906,7 @@ bool GameMap::hasObstacleAhead(const Vec3& pos, float yaw, float checkDist, floa
                 Vec3 testPos = {upProbe.x, pos.y + testH, upProbe.z};
                 AABB testBox = {{testPos.x - 0.1f, testPos.y - 0.05f, testPos.z - 0.1f},
                                 {testPos.x + 0.1f, testPos.y + 0.05f, testPos.z + 0.1f}};
-                bool blocked = false;
-                for (const auto& b : blocks_) {
-                    if (testBox.intersects(b.bounds)) { blocked = true; break; }
-                }
-                if (!blocked) {
+                if (!boxOverlapsAny(testBox, useGrid)) {
                     obstacleHeight = testH - pos.y;
                     return true;
                 }
@@ -589,72 +918,328 @@ bool GameMap::hasObstacleAhead(const Vec3& pos, float yaw, float checkDist, floa
     return false;
 }
 
+// ============================================================================
+// Spatial Index
+// ============================================================================
+
+// Slack added around block bounds when binning them, and when deciding that
+// no later cell can hold a closer ray hit, so float rounding at cell edges
+// never drops a block the linear scan would have found.
+static constexpr float GRID_EPS = 1e-2f;
+
+void BlockGrid::clear() {
+    cellsX = cellsZ = 0;
+    cellStart.clear();
+    cellBlocks.clear();
+    largeBlocks.clear();
+    cellBounds.clear();
+    largeBounds.clear();
+}
+
+void BlockGrid::build(const std::vector<MapBlock>& blocks, float size) {
+    clear();
+    if (blocks.empty()) return;
+
+    cellSize = size;
+    float maxXv = -1e30f, maxZv = -1e30f;
+    minX = minZ = 1e30f;
+    for (const auto& b : blocks) {
+        minX = std::min(minX, b.bounds.min.x);
+        minZ = std::min(minZ, b.bounds.min.z);
+        maxXv = std::max(maxXv, b.bounds.max.x);
+        maxZv = std::max(maxZv, b.bounds.max.z);
+    }
+    minX -= GRID_EPS;
+    minZ -= GRID_EPS;
+    cellsX = std::max(1, (int)ceilf((maxXv + GRID_EPS - minX) / cellSize));
+    cellsZ = std::max(1, (int)ceilf((maxZv + GRID_EPS - minZ) / cellSize));
+
+    // Two passes: count blocks per cell, then fill the flattened lists.
+    // Blocks are visited in index order so every cell list stays sorted.
+    std::vector<uint32_t> counts(numCells() + 1, 0);
+    std::vector<uint8_t>  isLarge(blocks.size(), 0);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        const AABB& bb = blocks[i].bounds;
+        int x0 = cellX(bb.min.x - GRID_EPS), x1 = cellX(bb.max.x + GRID_EPS);
+        int z0 = cellZ(bb.min.z - GRID_EPS), z1 = cellZ(bb.max.z + GRID_EPS);
+        if ((x1 - x0 + 1) * (z1 - z0 + 1) > LARGE_BLOCK_CELLS) {
+            isLarge[i] = 1;
+            largeBlocks.push_back((uint32_t)i);
+            continue;
+        }
+        for (int cz = z0; cz <= z1; cz++)
+            for (int cx = x0; cx <= x1; cx++)
+                counts[cellIndex(cx, cz)]++;
+    }
+
+    cellStart.assign(numCells() + 1, 0);
+    for (int c = 0; c < numCells(); c++) cellStart[c + 1] = cellStart[c] + counts[c];
+    cellBlocks.resize(cellStart[numCells()]);
+
+    std::vector<uint32_t> cursor(cellStart.begin(), cellStart.end() - 1);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        if (isLarge[i]) continue;
+        const AABB& bb = blocks[i].bounds;
+        int x0 = cellX(bb.min.x - GRID_EPS), x1 = cellX(bb.max.x + GRID_EPS);
+        int z0 = cellZ(bb.min.z - GRID_EPS), z1 = cellZ(bb.max.z + GRID_EPS);
+        for (int cz = z0; cz <= z1; cz++)
+            for (int cx = x0; cx <= x1; cx++)
+                cellBlocks[cursor[cellIndex(cx, cz)]++] = (uint32_t)i;
+    }
+    bakeBounds(blocks);
+}
+
+void BlockGrid::bakeBounds(const std::vector<MapBlock>& blocks) {
+    cellBounds.clear();
+    largeBounds.clear();
+    for (uint32_t bi : cellBlocks) cellBounds.push(blocks[bi].bounds);
+    for (uint32_t bi : largeBlocks) largeBounds.push(blocks[bi].bounds);
+}
+
+void PlayerGrid::init(float halfExtent, float size) {
+    cellSize = size;
+    minX = minZ = -halfExtent;
+    cellsX = cellsZ = std::max(1, (int)ceilf(2.0f * halfExtent / cellSize));
+    head_.assign(numCells() + 1, -1);
+    stamp_.assign(numCells(), 0);
+    stampGen_ = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) cellOf_[i] = -1;
+}
+
+void PlayerGrid::build(const PlayerData players[], int numPlayers) {
+    std::fill(head_.begin(), head_.end(), -1);
+    for (int i = 0; i < MAX_PLAYERS; i++) cellOf_[i] = -1;
+    // Link in reverse so each cell list runs in ascending id order
+    for (int i = std::min(numPlayers, MAX_PLAYERS) - 1; i >= 0; i--) {
+        if (players[i].state == PlayerState::ALIVE) link(i, cellOfPos(players[i].position));
+    }
+}
+
+// Positions whose box could reach past the grid rect go to the overflow list,
+// so a ray clipped to the grid never misses a binned player.
+int PlayerGrid::cellOfPos(const Vec3& pos) const {
+    float m = PLAYER_RADIUS + GRID_EPS;
+    if (pos.x < minX + m || pos.x > maxX() - m ||
+        pos.z < minZ + m || pos.z > maxZ() - m)
+        return overflowCell();
+    return cellIndex(cellX(pos.x), cellZ(pos.z));
+}
+
+void PlayerGrid::link(int id, int cell) {
+    cellOf_[id] = cell;
+    prev_[id] = -1;
+    next_[id] = head_[cell];
+    if (head_[cell] >= 0) prev_[head_[cell]] = id;
+    head_[cell] = id;
+}
+
+void PlayerGrid::unlink(int id) {
+    int cell = cellOf_[id];
+    if (prev_[id] >= 0) next_[prev_[id]] = next_[id];
+    else head_[cell] = next_[id];
+    if (next_[id] >= 0) prev_[next_[id]] = prev_[id];
+    cellOf_[id] = -1;
+}
+
+void PlayerGrid::update(int id, const Vec3& pos) {
+    if (head_.empty() || id < 0 || id >= MAX_PLAYERS) return;
+    int cell = cellOfPos(pos);
+    if (cellOf_[id] == cell) return;
+    if (cellOf_[id] >= 0) unlink(id);
+    link(id, cell);
+}
+
+void PlayerGrid::remove(int id) {
+    if (head_.empty() || id < 0 || id >= MAX_PLAYERS) return;
+    if (cellOf_[id] >= 0) unlink(id);
+}
+
+void PlayerGrid::appendCell(int cell, std::vector<int>& out) const {
+    for (int id = head_[cell]; id >= 0; id = next_[id]) out.push_back(id);
+}
+
+void PlayerGrid::query(const Vec3& center, float radius, std::vector<int>& out) const {
+    out.clear();
+    if (head_.empty()) return;
+    appendCell(overflowCell(), out);
+    int x0 = cellX(center.x - radius), x1 = cellX(center.x + radius);
+    int z0 = cellZ(center.z - radius), z1 = cellZ(center.z + radius);
+    for (int cz = z0; cz <= z1; cz++)
+        for (int cx = x0; cx <= x1; cx++)
+            appendCell(cellIndex(cx, cz), out);
+    std::sort(out.begin(), out.end());
+}
+
+void GameMap::buildSpatialIndex() {
+    grid_.build(blocks_);
+}
+
+bool GameMap::boxOverlapsAny(const AABB& box, bool useGrid) const {
+    if (!useGrid) {
+        for (const auto& b : blocks_) {
+            if (box.intersects(b.bounds)) return true;
+        }
+        return false;
+    }
+
+    for (uint32_t bi : grid_.largeBlocks) {
+        if (box.intersects(blocks_[bi].bounds)) return true;
+    }
+    int x0 = grid_.cellX(box.min.x), x1 = grid_.cellX(box.max.x);
+    int z0 = grid_.cellZ(box.min.z), z1 = grid_.cellZ(box.max.z);
+    for (int cz = z0; cz <= z1; cz++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            int c = grid_.cellIndex(cx, cz);
+            for (uint32_t k = grid_.cellStart[c]; k < grid_.cellStart[c + 1]; k++) {
+                if (box.intersects(blocks_[grid_.cellBlocks[k]].bounds)) return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Collect the (sorted, unique) indices of all blocks that may overlap box
+void GameMap::gatherBlocks(const AABB& box, std::vector<uint32_t>& out) const {
+    out.assign(grid_.largeBlocks.begin(), grid_.largeBlocks.end());
+    int x0 = grid_.cellX(box.min.x), x1 = grid_.cellX(box.max.x);
+    int z0 = grid_.cellZ(box.min.z), z1 = grid_.cellZ(box.max.z);
+    for (int cz = z0; cz <= z1; cz++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            int c = grid_.cellIndex(cx, cz);
+            out.insert(out.end(), grid_.cellBlocks.begin() + grid_.cellStart[c],
+                       grid_.cellBlocks.begin() + grid_.cellStart[c + 1]);
+        }
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+int GameMap::verifySpatialIndex(int samples) const {
+    if (grid_.empty()) return 0;
+    auto rnd = [](float mn, float mx) { return mn + (float)rand() / RAND_MAX * (mx - mn); };
+    int mismatches = 0;
+
+    for (int i = 0; i < samples; i++) {
+        Vec3 pos = {rnd(-200, 200), rnd(0, 10), rnd(-200, 200)};
+        Vec3 dir = Vec3{rnd(-1, 1), rnd(-1, 1), rnd(-1, 1)}.normalize();
+        if (i % 8 == 0) dir = {0, -1, 0}; // Straight down: degenerate XZ direction
+        float dist = rnd(1, 500);
+
+        Vec3 hpA, hpB;
+        float hdA = -1, hdB = -1;
+        bool hA = raycastImpl(pos, dir, dist, hpA, hdA, true);
+        bool hB = raycastImpl(pos, dir, dist, hpB, hdB, false);
+        if (hA != hB || (hA && hdA != hdB)) mismatches++;
+
+        if (isOnGroundImpl(pos, PLAYER_RADIUS, true) != isOnGroundImpl(pos, PLAYER_RADIUS, false))
+            mismatches++;
+
+        Vec3 newPos = pos + Vec3{rnd(-1, 1), rnd(-1, 1), rnd(-1, 1)};
+        Vec3 rA = resolveCollisionImpl(newPos, PLAYER_RADIUS, PLAYER_HEIGHT, true);
+        Vec3 rB = resolveCollisionImpl(newPos, PLAYER_RADIUS, PLAYER_HEIGHT, false);
+        if (rA.x != rB.x || rA.y != rB.y || rA.z != rB.z) mismatches++;
+
+        float yaw = rnd(-PI, PI), ohA = -1, ohB = -1;
+        bool oA = hasObstacleAheadImpl(pos, yaw, 1.5f, ohA, true);
+        bool oB = hasObstacleAheadImpl(pos, yaw, 1.5f, ohB, false);
+        if (oA != oB || (oA && ohA != ohB)) mismatches++;
+    }
+    return mismatches;
+}
+
 // ============================================================================
 // Collision Detection
 // ============================================================================
 
 bool GameMap::isOnGround(const Vec3& pos, float radius, float height) const {
     (void)height;
+    return isOnGroundImpl(pos, radius, usesSpatialIndex());
+}
+
+bool GameMap::isOnGroundImpl(const Vec3& pos, float radius, bool useGrid) const {
     AABB feet;
     feet.min = {pos.x - radius, pos.y - 0.05f, pos.z - radius};
     feet.max = {pos.x + radius, pos.y + 0.05f, pos.z + radius};
 
-    for (const auto& b : blocks_) {
-        if (feet.intersects(b.bounds)) return true;
-    }
+    if (boxOverlapsAny(feet, useGrid)) return true;
     return pos.y <= 0.05f; // Ground plane at y=0
 }
 
+// Push the player out of one block along the axis of least overlap
+static void pushOutOfBlock(Vec3& resolved, const AABB& playerBox, const AABB& block) {
+    // Compute overlap on each axis
+    float overlapX1 = playerBox.max.x - block.min.x;
+    float overlapX2 = block.max.x - playerBox.min.x;
+    float overlapY1 = playerBox.max.y - block.min.y;
+    float overlapY2 = block.max.y - playerBox.min.y;
+    float overlapZ1 = playerBox.max.z - block.min.z;
+    float overlapZ2 = block.max.z - playerBox.min.z;
+
+    float minOverlapX = std::min(overlapX1, overlapX2);
+    float minOverlapY = std::min(overlapY1, overlapY2);
+    float minOverlapZ = std::min(overlapZ1, overlapZ2);
+
+    if (minOverlapX < minOverlapY && minOverlapX < minOverlapZ) {
+        resolved.x += (overlapX1 < overlapX2) ? -overlapX1 : overlapX2;
+    } else if (minOverlapY < minOverlapZ) {
+        if (overlapY1 < overlapY2) {
+            resolved.y -= overlapY1;
+        } else {
+            resolved.y += overlapY2;
+        }
+    } else {
+        resolved.z += (overlapZ1 < overlapZ2) ? -overlapZ1 : overlapZ2;
+    }
+}
+
 Vec3 GameMap::resolveCollision(const Vec3& oldPos, const Vec3& newPos, float radius, float height) const {
+    (void)oldPos;
+    return resolveCollisionImpl(newPos, radius, height, usesSpatialIndex());
+}
+
+Vec3 GameMap::resolveCollisionImpl(const Vec3& newPos, float radius, float height, bool useGrid) const {
     Vec3 resolved = newPos;
 
     AABB playerBox;
-    playerBox.min = {resolved.x - radius, resolved.y, resolved.z - radius};
-    playerBox.max = {resolved.x + radius, resolved.y + height, resolved.z + radius};
-
-    for (int iter = 0; iter < 4; iter++) {
-        bool collided = false;
-
+    auto updateBox = [&]() {
         playerBox.min = {resolved.x - radius, resolved.y, resolved.z - radius};
         playerBox.max = {resolved.x + radius, resolved.y + height, resolved.z + radius};
+    };
 
-        for (const auto& b : blocks_) {
-            if (!playerBox.intersects(b.bounds)) continue;
-
-            // Compute overlap on each axis
-            float overlapX1 = playerBox.max.x - b.bounds.min.x;
-            float overlapX2 = b.bounds.max.x - playerBox.min.x;
-            float overlapY1 = playerBox.max.y - b.bounds.min.y;
-            float overlapY2 = b.bounds.max.y - playerBox.min.y;
-            float overlapZ1 = playerBox.max.z - b.bounds.min.z;
-            float overlapZ2 = b.bounds.max.z - playerBox.min.z;
-
-            float minOverlapX = std::min(overlapX1, overlapX2);
-            float minOverlapY = std::min(overlapY1, overlapY2);
-            float minOverlapZ = std::min(overlapZ1, overlapZ2);
-
-            if (minOverlapX < minOverlapY && minOverlapX < minOverlapZ) {
-                resolved.x += (overlapX1 < overlapX2) ? -overlapX1 : overlapX2;
-            } else if (minOverlapY < minOverlapZ) {
-                if (overlapY1 < overlapY2) {
-                    resolved.y -= overlapY1;
-                } else {
-                    resolved.y += overlapY2;
-                }
-            } else {
-                resolved.z += (overlapZ1 < overlapZ2) ? -overlapZ1 : overlapZ2;
-            }
-            collided = true;
+    // Blocks are resolved in index order and the box moves after each push,
+    // so the grid path re-gathers candidates after every push and resumes
+    // after the current index. That visits exactly the blocks the linear
+    // scan would.
+    thread_local std::vector<uint32_t> candidates;
 
-            // Update player box
-            playerBox.min = {resolved.x - radius, resolved.y, resolved.z - radius};
-            playerBox.max = {resolved.x + radius, resolved.y + height, resolved.z + radius};
+    for (int iter = 0; iter < 4; iter++) {
+        bool collided = false;
+        updateBox();
+
+        if (!useGrid) {
+            for (const auto& b : blocks_) {
+                if (!playerBox.intersects(b.bounds)) continue;
+                pushOutOfBlock(resolved, playerBox, b.bounds);
+                collided = true;
+                updateBox();
+            }
+        } else {
+            gatherBlocks(playerBox, candidates);
+            for (int k = 0; k < (int)candidates.size(); k++) {
+                uint32_t bi = candidates[k];
+                if (!playerBox.intersects(blocks_[bi].bounds)) continue;
+                pushOutOfBlock(resolved, playerBox, blocks_[bi].bounds);
+                collided = true;
+                updateBox();
+                gatherBlocks(playerBox, candidates);
+                k = (int)(std::upper_bound(candidates.begin(), candidates.end(), bi) - candidates.begin()) - 1;
+            }
         }
         if (!collided) break;
     }
 
     // World boundary
-    float bnd = 194.5f;
+    float bnd = WORLD_BOUND;
     resolved.x = std::clamp(resolved.x, -bnd, bnd);
     resolved.z = std::clamp(resolved.z, -bnd, bnd);
     if (resolved.y < 0) resolved.y = 0;
@@ -662,21 +1247,191 @@ Vec3 GameMap::resolveCollision(const Vec3& oldPos, const Vec3& newPos, float rad
     return resolved;
 }
 
+// ============================================================================
+// Batched Ray Tests
+// ============================================================================
+
+void BoxArrays::clear() {
+    for (auto* v : {&minX, &minY, &minZ, &maxX, &maxY, &maxZ}) v->clear();
+}
+
+void BoxArrays::push(const AABB& b) {
+    minX.push_back(b.min.x); minY.push_back(b.min.y); minZ.push_back(b.min.z);
+    maxX.push_back(b.max.x); maxY.push_back(b.max.y); maxZ.push_back(b.max.z);
+}
+
+namespace {
+
+// Bounds sources for rayScan. lanes(i, mn, mx) loads boxes i..i+3 and
+// returns which of them may be hit; box(i, out) does the same for one box.
+
+struct FaceBounds {
+    const BoxArrays& b;
+
+    bool box(int i, AABB& out) const {
+        out.min = {b.minX[i], b.minY[i], b.minZ[i]};
+        out.max = {b.maxX[i], b.maxY[i], b.maxZ[i]};
+        return true;
+    }
+#if FPS_SIMD
+    simd::M4 lanes(int i, simd::F4 mn[3], simd::F4 mx[3]) const {
+        mn[0] = simd::load(&b.minX[i]); mn[1] = simd::load(&b.minY[i]); mn[2] = simd::load(&b.minZ[i]);
+        mx[0] = simd::load(&b.maxX[i]); mx[1] = simd::load(&b.maxY[i]); mx[2] = simd::load(&b.maxZ[i]);
+        return simd::mask(true, true, true, true);
+    }
+#endif
+};
+
+// Player hitboxes from feet positions, built the same way as the scalar
+// raycastPlayers does so the bounds are the same floats
+struct FeetBounds {
+    const float*   x;
+    const float*   y;
+    const float*   z;
+    const uint8_t* hittable;
+    int            ignore;
+
+    bool candidate(int i) const { return i != ignore && hittable[i]; }
+    bool box(int i, AABB& out) const {
+        out.min = {x[i] - PLAYER_RADIUS, y[i], z[i] - PLAYER_RADIUS};
+        out.max = {x[i] + PLAYER_RADIUS, y[i] + PLAYER_HEIGHT, z[i] + PLAYER_RADIUS};
+        return candidate(i);
+    }
+#if FPS_SIMD
+    simd::M4 lanes(int i, simd::F4 mn[3], simd::F4 mx[3]) const {
+        simd::F4 px = simd::load(x + i), py = simd::load(y + i), pz = simd::load(z + i);
+        simd::F4 r = simd::splat(PLAYER_RADIUS);
+        mn[0] = simd::sub(px, r); mn[1] = py;                                        mn[2] = simd::sub(pz, r);
+        mx[0] = simd::add(px, r); mx[1] = simd::add(py, simd::splat(PLAYER_HEIGHT)); mx[2] = simd::add(pz, r);
+        return simd::mask(candidate(i), candidate(i + 1), candidate(i + 2), candidate(i + 3));
+    }
+#endif
+};
+
+// The AABB::raycast slab test, four boxes per step. Every lane does the
+// scalar divisions and comparisons; the per-axis early-outs become one
+// check at the end, which is equivalent since tNear only grows and tFar
+// only shrinks. Each lane keeps its own nearest hit, then the lanes are
+// merged by (t, index) so ties still go to the lowest index. The tail,
+// and every box without SIMD, goes through AABB::raycast.
+template <class Bounds>
+int rayScan(const Vec3& origin, const Vec3& dir, float maxDist, int first, int last,
+            const Bounds& bounds, float& hitDist) {
+    float closest = maxDist;
+    int hitIdx = -1;
+    int i = first;
+
+#if FPS_SIMD
+    if (last - first >= 4) {
+        const float o[3] = {origin.x, origin.y, origin.z};
+        const float d[3] = {dir.x, dir.y, dir.z};
+        bool     parallel[3];
+        simd::F4 ov[3], dv[3];
+        for (int a = 0; a < 3; a++) {
+            parallel[a] = fabsf(d[a]) < 1e-8f;
+            ov[a] = simd::splat(o[a]);
+            dv[a] = simd::splat(d[a]);
+        }
+
+        // Indices ride along as floats, exact well past any box count here
+        simd::F4 bestT = simd::splat(closest), bestIdx = simd::splat(-1.0f);
+        simd::F4 idx = simd::lanes((float)i, (float)(i + 1), (float)(i + 2), (float)(i + 3));
+        const simd::F4 four = simd::splat(4.0f);
+        for (; i + 4 <= last; i += 4, idx = simd::add(idx, four)) {
+            simd::F4 mn[3], mx[3];
+            simd::M4 ok = bounds.lanes(i, mn, mx);
+            simd::F4 tNear = simd::splat(-1e30f), tFar = simd::splat(1e30f);
+            for (int a = 0; a < 3; a++) {
+                if (parallel[a]) {
+                    simd::M4 outside = simd::bitOr(simd::lt(ov[a], mn[a]), simd::lt(mx[a], ov[a]));
+                    ok = simd::bitAndNot(ok, outside);
+                } else {
+                    simd::F4 t1 = simd::div(simd::sub(mn[a], ov[a]), dv[a]);
+                    simd::F4 t2 = simd::div(simd::sub(mx[a], ov[a]), dv[a]);
+                    tNear = simd::max(tNear, simd::min(t1, t2));
+                    tFar = simd::min(tFar, simd::max(t1, t2));
+                }
+            }
+            // tNear >= 0 and tNear <= tFar also covers the scalar tFar >= 0
+            simd::M4 hit = simd::bitAnd(ok, simd::bitAnd(simd::le(tNear, tFar),
+                           simd::bitAnd(simd::le(simd::zero(), tNear), simd::lt(tNear, bestT))));
+            bestT = simd::select(hit, tNear, bestT);
+            bestIdx = simd::select(hit, idx, bestIdx);
+        }
+
+        float laneT[4], laneIdx[4];
+        simd::store(laneT, bestT);
+        simd::store(laneIdx, bestIdx);
+        for (int l = 0; l < 4; l++) {
+            int li = (int)laneIdx[l];
+            if (li >= 0 && (laneT[l] < closest || (laneT[l] == closest && li < hitIdx))) {
+                closest = laneT[l];
+                hitIdx = li;
+            }
+        }
+    }
+#endif
+
+    for (; i < last; i++) {
+        AABB b;
+        float t;
+        if (bounds.box(i, b) && b.raycast(origin, dir, t) && t < closest && t >= 0) {
+            closest = t;
+            hitIdx = i;
+        }
+    }
+
+    if (hitIdx >= 0) hitDist = closest;
+    return hitIdx;
+}
+
+} // namespace
+
+int raycastBoxes(const Vec3& origin, const Vec3& dir, float maxDist,
+                 const BoxArrays& boxes, size_t first, size_t last, float& hitDist) {
+    return rayScan(origin, dir, maxDist, (int)first, (int)last, FaceBounds{boxes}, hitDist);
+}
+
 // ============================================================================
 // Raycasting
 // ============================================================================
 
 bool GameMap::raycast(const Vec3& origin, const Vec3& dir, float maxDist,
                       Vec3& hitPoint, float& hitDist) const {
+    return raycastImpl(origin, dir, maxDist, hitPoint, hitDist, usesSpatialIndex());
+}
+
+bool GameMap::raycastImpl(const Vec3& origin, const Vec3& dir, float maxDist,
+                          Vec3& hitPoint, float& hitDist, bool useGrid) const {
     float closest = maxDist;
     bool hit = false;
 
-    for (const auto& b : blocks_) {
+    auto testBlock = [&](const MapBlock& b) {
         float t;
         if (b.bounds.raycast(origin, dir, t) && t < closest && t >= 0) {
             closest = t;
             hit = true;
         }
+    };
+
+    auto testBoxes = [&](const BoxArrays& boxes, size_t first, size_t last) {
+        float t;
+        if (raycastBoxes(origin, dir, closest, boxes, first, last, t) >= 0) {
+            closest = t;
+            hit = true;
+        }
+    };
+
+    // The linear scan stays one box at a time, as the reference
+    if (!useGrid) {
+        for (const auto& b : blocks_) testBlock(b);
+    } else {
+        testBoxes(grid_.largeBounds, 0, grid_.largeBounds.size());
+        forEachRayCell(grid_, origin, dir, maxDist, [&](int c, float tExit) {
+            testBoxes(grid_.cellBounds, grid_.cellStart[c], grid_.cellStart[c + 1]);
+            // Any block not seen yet is first entered beyond this cell
+            return closest < tExit - GRID_EPS;
+        });
     }
 
     if (hit) {
@@ -689,12 +1444,28 @@ bool GameMap::raycast(const Vec3& origin, const Vec3& dir, float maxDist,
 int GameMap::raycastPlayers(const Vec3& origin, const Vec3& dir, float maxDist,
                             const PlayerData players[], int numPlayers,
                             int ignorePlayer, float& hitDist) {
+    // Gather into lanes for the batched test
+    float x[MAX_PLAYERS], y[MAX_PLAYERS], z[MAX_PLAYERS];
+    uint8_t alive[MAX_PLAYERS];
+    numPlayers = std::min(numPlayers, MAX_PLAYERS);
+    for (int i = 0; i < numPlayers; i++) {
+        x[i] = players[i].position.x;
+        y[i] = players[i].position.y;
+        z[i] = players[i].position.z;
+        alive[i] = players[i].state == PlayerState::ALIVE;
+    }
+    return raycastPlayers(origin, dir, maxDist, x, y, z, alive, numPlayers, ignorePlayer, hitDist);
+}
+
+int GameMap::raycastPlayers(const Vec3& origin, const Vec3& dir, float maxDist,
+                            const PlayerData players[], const PlayerGrid& grid,
+                            int ignorePlayer, float& hitDist) {
     float closest = maxDist;
     int hitIdx = -1;
 
-    for (int i = 0; i < numPlayers; i++) {
-        if (i == ignorePlayer) continue;
-        if (players[i].state != PlayerState::ALIVE) continue;
+    grid.forEachAlongRay(origin, dir, maxDist, [&](int i) {
+        if (i == ignorePlayer) return;
+        if (players[i].state != PlayerState::ALIVE) return;
 
         AABB playerBox;
         playerBox.min = {players[i].position.x - PLAYER_RADIUS,
@@ -704,17 +1475,152 @@ int GameMap::raycastPlayers(const Vec3& origin, const Vec3& dir, float maxDist,
                          players[i].position.y + PLAYER_HEIGHT,
                          players[i].position.z + PLAYER_RADIUS};
 
+        // Visit order is not id order: break equal-t ties toward the lower
+        // id like the linear scan does
         float t;
-        if (playerBox.raycast(origin, dir, t) && t < closest && t >= 0) {
+        if (playerBox.raycast(origin, dir, t) && t >= 0 &&
+            (t < closest || (t == closest && hitIdx >= 0 && i < hitIdx))) {
             closest = t;
             hitIdx = i;
         }
-    }
+    }, [&](float tExit) { return hitIdx >= 0 && closest < tExit; });
 
     if (hitIdx >= 0) hitDist = closest;
     return hitIdx;
 }
 
+int GameMap::raycastPlayers(const Vec3& origin, const Vec3& dir, float maxDist,
+                            const float x[], const float y[], const float z[],
+                            const uint8_t hittable[], int numPlayers,
+                            int ignorePlayer, float& hitDist) {
+    return rayScan(origin, dir, maxDist, 0, numPlayers,
+                   FeetBounds{x, y, z, hittable, ignorePlayer}, hitDist);
+}
+
+// ============================================================================
+// Visibility
+// ============================================================================
+
+void GameMap::bakeVisibility() {
+    vis_ = VisibilityGrid{};
+    if (blocks_.empty()) return;
+
+    float maxX = -1e30f, maxZ = -1e30f;
+    vis_.cellSize = VisibilityGrid::CELL_SIZE;
+    vis_.minX = vis_.minZ = 1e30f;
+    for (const auto& b : blocks_) {
+        vis_.minX = std::min(vis_.minX, b.bounds.min.x);
+        vis_.minZ = std::min(vis_.minZ, b.bounds.min.z);
+        maxX = std::max(maxX, b.bounds.max.x);
+        maxZ = std::max(maxZ, b.bounds.max.z);
+    }
+    vis_.cellsX = std::max(1, (int)ceilf((maxX - vis_.minX) / vis_.cellSize));
+    vis_.cellsZ = std::max(1, (int)ceilf((maxZ - vis_.minZ) / vis_.cellSize));
+    const int n = vis_.numCells();
+    vis_.rowWords = (n + 63) / 64;
+    vis_.bits.assign((size_t)n * vis_.rowWords, 0);
+
+    // Full-height occluders: blocks standing on the ground and reaching
+    // above MAX_HEIGHT. A segment between two points in [0, MAX_HEIGHT]
+    // that crosses one's XZ footprint passes through it.
+    //
+    // A pair of cells at least two apart along an axis is blocked if, at
+    // some line across that axis between them, occluders cover the whole
+    // span of every segment from one cell to the other. For each axis the
+    // lines sit between consecutive occluder edges; each keeps the merged
+    // spans of the occluders it crosses, shrunk a little so that boxes
+    // which only touch never count as closed.
+    struct Span { float lo, hi; };
+    struct Line { float at; std::vector<Span> spans; };
+    const float cs = vis_.cellSize;
+    auto coord = [](const Vec3& p, int axis) { return axis == 0 ? p.x : p.z; };
+    auto buildLines = [&](int u, int v) {
+        std::vector<float> edges;
+        for (const auto& b : blocks_) {
+            if (!VisibilityGrid::occludes(b.bounds)) continue;
+            edges.push_back(coord(b.bounds.min, u));
+            edges.push_back(coord(b.bounds.max, u));
+        }
+        std::sort(edges.begin(), edges.end());
+        std::vector<Line> lines;
+        for (size_t i = 0; i + 1 < edges.size(); i++) {
+            if (edges[i + 1] <= edges[i]) continue;
+            Line line{(edges[i] + edges[i + 1]) * 0.5f, {}};
+            std::vector<Span> cut;
+            for (const auto& b : blocks_) {
+                if (!VisibilityGrid::occludes(b.bounds)) continue;
+                if (coord(b.bounds.min, u) < line.at && line.at < coord(b.bounds.max, u))
+                    cut.push_back({coord(b.bounds.min, v) + 0.001f, coord(b.bounds.max, v) - 0.001f});
+            }
+            std::sort(cut.begin(), cut.end(), [](const Span& x, const Span& y) { return x.lo < y.lo; });
+            bool wideEnough = false;
+            for (const Span& sp : cut) {
+                if (!line.spans.empty() && sp.lo < line.spans.back().hi)
+                    line.spans.back().hi = std::max(line.spans.back().hi, sp.hi);
+                else
+                    line.spans.push_back(sp);
+                wideEnough |= line.spans.back().hi - line.spans.back().lo >= cs;
+            }
+            // Every cell-to-cell span is at least a cell wide
+            if (wideEnough) lines.push_back(std::move(line));
+        }
+        return lines;
+    };
+    const std::vector<Line> linesX = buildLines(0, 2), linesZ = buildLines(2, 0);
+
+    // Cells a (nearer the low end) and b along an axis, with their ranges
+    // on it (a0-a1, b0-b1) and across it; a line is only used if it is more
+    // than the sight check's 0.5 m allowance from both cells.
+    auto blockedAlong = [&](const std::vector<Line>& lines, float a0, float b0, float aLo, float bLo) {
+        float a1 = a0 + cs, b1 = b0 + cs, aHi = aLo + cs, bHi = bLo + cs;
+        auto it = std::lower_bound(lines.begin(), lines.end(), a1 + 0.5f,
+                                   [](const Line& l, float at) { return l.at < at; });
+        for (; it != lines.end() && it->at <= b0 - 0.5f; ++it) {
+            // Where segments cross the line, as a fraction of the way to b
+            float tFar = (it->at - a0) / (b0 - a0), tNear = (it->at - a1) / (b1 - a1);
+            float lo = std::min(aLo + (bLo - aLo) * tFar, aLo + (bLo - aLo) * tNear);
+            float hi = std::max(aHi + (bHi - aHi) * tFar, aHi + (bHi - aHi) * tNear);
+            for (const Span& sp : it->spans)
+                if (sp.lo <= lo && hi <= sp.hi) return true;
+        }
+        return false;
+    };
+    auto sees = [&](int a, int b) {
+        int ax = a % vis_.cellsX, az = a / vis_.cellsX;
+        int bx = b % vis_.cellsX, bz = b / vis_.cellsX;
+        if (abs(ax - bx) <= 1 && abs(az - bz) <= 1) return true;
+        float cellsApart = sqrtf((float)((ax - bx) * (ax - bx) + (az - bz) * (az - bz)));
+        if (cellsApart * cs > VisibilityGrid::MAX_RANGE) return true;
+        if (ax > bx) { std::swap(ax, bx); std::swap(az, bz); }
+        if (bx - ax >= 2 && blockedAlong(linesX, vis_.minX + ax * cs, vis_.minX + bx * cs,
+                                         vis_.minZ + az * cs, vis_.minZ + bz * cs)) return false;
+        if (az > bz) { std::swap(ax, bx); std::swap(az, bz); }
+        if (bz - az >= 2 && blockedAlong(linesZ, vis_.minZ + az * cs, vis_.minZ + bz * cs,
+                                         vis_.minX + ax * cs, vis_.minX + bx * cs)) return false;
+        return true;
+    };
+
+    // Rows are handed out one at a time; each fills its upper triangle,
+    // which is then mirrored
+    std::atomic<int> nextRow{0};
+    auto worker = [&]() {
+        for (int a; (a = nextRow.fetch_add(1)) < n;) {
+            uint64_t* row = &vis_.bits[(size_t)a * vis_.rowWords];
+            for (int b = a; b < n; b++)
+                if (sees(a, b)) row[b / 64] |= 1ull << (b % 64);
+        }
+    };
+    int numThreads = (int)std::min(8u, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (int t = 1; t < numThreads; t++) threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads) t.join();
+
+    for (int a = 0; a < n; a++)
+        for (int b = a + 1; b < n; b++)
+            if (vis_.cellsVisible(a, b)) vis_.bits[(size_t)b * vis_.rowWords + a / 64] |= 1ull << (a % 64);
+}
+
 // ============================================================================
 // Player Physics
 // ============================================================================
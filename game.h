@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common.h"
+#include <span>
 #include <vector>
 
 // ============================================================================
@@ -26,10 +27,12 @@ struct SpawnPoint {
     float yaw = 0;
 };
 
-// Waypoint for bot navigation
+// Waypoint for bot navigation. Neighbors are a range of the map's flat link
+// array, see GameMap::waypointNeighbors.
 struct Waypoint {
-    Vec3 position;
-    std::vector<int> neighbors; // indices into waypoint array
+    Vec3     position;
+    uint32_t firstNeighbor = 0;
+    uint32_t numNeighbors = 0;
 };
 
 struct VehicleSpawn {
@@ -38,21 +41,316 @@ struct VehicleSpawn {
     VehicleType type;
 };
 
+// ============================================================================
+// Batched Ray Tests
+// ============================================================================
+
+// Box bounds with one array per face, so a ray can be slab-tested against
+// several boxes per instruction
+struct BoxArrays {
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+    size_t size() const { return minX.size(); }
+    void   clear();
+    void   push(const AABB& b);
+};
+
+// Nearest of boxes [first, last) the ray enters at t in [0, maxDist):
+// returns its index (the lowest on ties) and sets hitDist, or returns -1.
+// Same hit and distance as AABB::raycast on each box in turn, except that
+// a zero distance may come back as -0.
+int raycastBoxes(const Vec3& origin, const Vec3& dir, float maxDist,
+                 const BoxArrays& boxes, size_t first, size_t last, float& hitDist);
+
+// ============================================================================
+// Spatial Grids (XZ broadphase)
+// ============================================================================
+
+// Cell layout over the XZ plane
+struct GridLayout {
+    float cellSize = 8.0f;
+    float minX = 0, minZ = 0;
+    int   cellsX = 0, cellsZ = 0;
+
+    int cellX(float x) const { return std::clamp((int)floorf((x - minX) / cellSize), 0, cellsX - 1); }
+    int cellZ(float z) const { return std::clamp((int)floorf((z - minZ) / cellSize), 0, cellsZ - 1); }
+    int cellIndex(int cx, int cz) const { return cz * cellsX + cx; }
+    int numCells() const { return cellsX * cellsZ; }
+    float maxX() const { return minX + cellsX * cellSize; }
+    float maxZ() const { return minZ + cellsZ * cellSize; }
+};
+
+// Walk the cells pierced by the ray segment [0, maxDist] in order along the
+// ray (2D DDA). fn(cellIndex, tExit) gets the ray parameter at which the ray
+// leaves that cell and returns true to stop the walk.
+template <typename Fn>
+void forEachRayCell(const GridLayout& g, const Vec3& origin, const Vec3& dir, float maxDist, Fn&& fn) {
+    if (g.numCells() == 0) return;
+    const float o[2] = {origin.x, origin.z};
+    const float d[2] = {dir.x, dir.z};
+    const float lo[2] = {g.minX, g.minZ};
+    const float hi[2] = {g.maxX(), g.maxZ()};
+
+    // Clip the segment to the grid rectangle
+    float t0 = 0, t1 = maxDist;
+    for (int a = 0; a < 2; a++) {
+        if (fabsf(d[a]) < 1e-8f) {
+            if (o[a] < lo[a] || o[a] > hi[a]) return;
+        } else {
+            float ta = (lo[a] - o[a]) / d[a];
+            float tb = (hi[a] - o[a]) / d[a];
+            if (ta > tb) std::swap(ta, tb);
+            t0 = std::max(t0, ta);
+            t1 = std::min(t1, tb);
+            if (t0 > t1) return;
+        }
+    }
+
+    int c[2] = {g.cellX(o[0] + d[0] * t0), g.cellZ(o[1] + d[1] * t0)};
+    const int n[2] = {g.cellsX, g.cellsZ};
+    int   step[2];
+    float tMax[2], tDelta[2];
+    for (int a = 0; a < 2; a++) {
+        if (fabsf(d[a]) < 1e-8f) {
+            step[a] = 0;
+            tMax[a] = tDelta[a] = 1e30f;
+        } else {
+            step[a] = d[a] > 0 ? 1 : -1;
+            float boundary = lo[a] + (c[a] + (step[a] > 0 ? 1 : 0)) * g.cellSize;
+            tMax[a] = (boundary - o[a]) / d[a];
+            tDelta[a] = g.cellSize / fabsf(d[a]);
+        }
+    }
+
+    for (;;) {
+        int axis = tMax[0] < tMax[1] ? 0 : 1;
+        float tExit = tMax[axis];
+        if (fn(g.cellIndex(c[0], c[1]), tExit)) return;
+        if (tExit >= t1) return;
+        c[axis] += step[axis];
+        tMax[axis] += tDelta[axis];
+        if (c[axis] < 0 || c[axis] >= n[axis]) return;
+    }
+}
+
+// Static grid over the map blocks. Each cell lists the indices of the blocks
+// whose bounds overlap it, flattened into one array (cellStart[c]..cellStart[c+1]).
+// Blocks spanning more than LARGE_BLOCK_CELLS cells (ground plane, long roads)
+// are kept in largeBlocks and tested by every query instead.
+struct BlockGrid : GridLayout {
+    static constexpr float DEFAULT_CELL_SIZE = 8.0f;
+    static constexpr int   LARGE_BLOCK_CELLS = 64;
+
+    std::vector<uint32_t> cellStart;   // numCells() + 1 offsets into cellBlocks
+    std::vector<uint32_t> cellBlocks;  // Block indices, ascending within each cell
+    std::vector<uint32_t> largeBlocks; // Block indices tested by every query
+    // Bounds of cellBlocks[k] at k and of largeBlocks[k] at k, for the ray
+    // kernel; derived from the lists, so not part of the map cache
+    BoxArrays             cellBounds;
+    BoxArrays             largeBounds;
+
+    void build(const std::vector<MapBlock>& blocks, float cellSize = DEFAULT_CELL_SIZE);
+    void bakeBounds(const std::vector<MapBlock>& blocks);
+    void clear();
+    bool empty() const { return cellStart.empty(); }
+};
+
+// Dynamic grid over player positions. Each player is binned by the cell of
+// its position (intrusive per-cell lists, so moving a player is O(1)); queries
+// widen their search by one cell to cover player boxes straddling a border.
+// Players outside the grid rect sit in an overflow list every query checks.
+// The server rebuilds it once per tick and calls update() wherever a position
+// changes mid-tick, so it always agrees with a full scan of the player array.
+struct PlayerGrid : GridLayout {
+    static constexpr float DEFAULT_CELL_SIZE = 8.0f;
+
+    void init(float halfExtent, float cellSize = DEFAULT_CELL_SIZE);
+    // Bin every ALIVE player
+    void build(const PlayerData players[], int numPlayers);
+    void update(int id, const Vec3& pos);
+    void remove(int id);
+
+    // Ids of binned players whose position may be within radius (XZ) of
+    // center, ascending. Callers still filter by state and exact distance.
+    void query(const Vec3& center, float radius, std::vector<int>& out) const;
+
+    // Call visit(id) for binned players near the cells pierced by the ray, in
+    // traversal order. After each cell, stop(tExit) gets the ray parameter at
+    // which that cell is left; every player not visited yet can only be hit
+    // beyond it, so returning true ends the walk.
+    template <typename Visit, typename Stop>
+    void forEachAlongRay(const Vec3& origin, const Vec3& dir, float maxDist,
+                         Visit&& visit, Stop&& stop) const;
+
+private:
+    int overflowCell() const { return numCells(); }
+    int cellOfPos(const Vec3& pos) const;
+    void link(int id, int cell);
+    void unlink(int id);
+    void appendCell(int cell, std::vector<int>& out) const;
+
+    std::vector<int> head_;                // Per-cell list heads (+ overflow), -1 = empty
+    int next_[MAX_PLAYERS], prev_[MAX_PLAYERS];
+    int cellOf_[MAX_PLAYERS];              // -1 = not binned
+    mutable std::vector<uint32_t> stamp_;  // Per-cell visit marks for ray walks
+    mutable uint32_t stampGen_ = 0;
+};
+
+template <typename Visit, typename Stop>
+void PlayerGrid::forEachAlongRay(const Vec3& origin, const Vec3& dir, float maxDist,
+                                 Visit&& visit, Stop&& stop) const {
+    if (head_.empty()) return;
+    if (++stampGen_ == 0) {
+        std::fill(stamp_.begin(), stamp_.end(), 0);
+        stampGen_ = 1;
+    }
+    // Players off the grid may be hit anywhere along the ray
+    for (int id = head_[overflowCell()]; id >= 0; id = next_[id]) visit(id);
+
+    forEachRayCell(*this, origin, dir, maxDist, [&](int c, float tExit) {
+        int cx = c % cellsX, cz = c / cellsX;
+        for (int z = std::max(cz - 1, 0); z <= std::min(cz + 1, cellsZ - 1); z++) {
+            for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, cellsX - 1); x++) {
+                int n = cellIndex(x, z);
+                if (stamp_[n] == stampGen_) continue;
+                stamp_[n] = stampGen_;
+                for (int id = head_[n]; id >= 0; id = next_[id]) visit(id);
+            }
+        }
+        return stop(tExit);
+    });
+}
+
+// ============================================================================
+// Visibility
+// ============================================================================
+
+// Potentially visible sets over a coarse XZ grid of the static map: bit b
+// of row a is set unless no point in cell a can see any point in cell b.
+// The bake only clears a bit it can prove: some line between the two cells
+// along X or Z is closed by walls that stand on the ground and reach above
+// MAX_HEIGHT, for every segment between them (see bakeVisibility). A clear
+// bit means blocked, a set bit "ask the raycast". Sets only cover points
+// from the ground up to MAX_HEIGHT and pairs within MAX_RANGE, the rest
+// count as visible, as do neighboring cells.
+struct VisibilityGrid : GridLayout {
+    static constexpr float CELL_SIZE = 8.0f;
+    static constexpr float MAX_RANGE = 96.0f;  // Cells further apart (centers) are always visible
+    static constexpr float MAX_HEIGHT = 2.9f;  // Points above this (or below the ground) are always visible
+
+    std::vector<uint64_t> bits; // numCells() rows of rowWords words
+    int                   rowWords = 0;
+
+    // Whether a block closes every sight line through its XZ footprint
+    static bool occludes(const AABB& b) { return b.min.y <= 0 && b.max.y > MAX_HEIGHT; }
+
+    bool empty() const { return bits.empty(); }
+    bool cellsVisible(int a, int b) const { return (bits[(size_t)a * rowWords + b / 64] >> (b % 64)) & 1; }
+    // Inside the grid, above the ground and no higher than MAX_HEIGHT
+    bool covers(float x, float y, float z) const {
+        return x >= minX && x < maxX() && z >= minZ && z < maxZ() && y > 0 && y <= MAX_HEIGHT;
+    }
+    // Whether a sight line between two points may be open; true if not baked
+    bool potentiallyVisible(const Vec3& from, const Vec3& to) const {
+        if (empty() || !covers(from.x, from.y, from.z) || !covers(to.x, to.y, to.z)) return true;
+        return cellsVisible(cellIndex(cellX(from.x), cellZ(from.z)), cellIndex(cellX(to.x), cellZ(to.z)));
+    }
+    // Same for every point of a sphere above the ground: true if any cell
+    // under its XZ bounds may be seen
+    bool potentiallyVisible(const Vec3& from, const Vec3& center, float radius) const {
+        float x0 = center.x - radius, x1 = center.x + radius;
+        float z0 = center.z - radius, z1 = center.z + radius;
+        if (empty() || !covers(from.x, from.y, from.z) || !covers(x0, center.y + radius, z0) ||
+            !covers(x1, center.y + radius, z1)) return true;
+        int a = cellIndex(cellX(from.x), cellZ(from.z));
+        for (int cz = cellZ(z0); cz <= cellZ(z1); cz++)
+            for (int cx = cellX(x0); cx <= cellX(x1); cx++)
+                if (cellsVisible(a, cellIndex(cx, cz))) return true;
+        return false;
+    }
+};
+
+// ============================================================================
+// Map Mesh
+// ============================================================================
+
+// Interleaved position / normal / color, the layout the renderer uploads
+struct MeshVertex {
+    float px, py, pz;
+    float nx, ny, nz;
+    float cr, cg, cb;
+};
+
+// The map's vertices for one XZ chunk. Coarse blocks come first, so a
+// distant chunk can draw just [first, first + coarseCount).
+struct MapMeshChunk {
+    AABB bounds;
+    int  first = 0;
+    int  count = 0;       // All blocks
+    int  coarseCount = 0; // Without detail blocks
+};
+
+// 36 vertices (two triangles per face) for an axis-aligned box
+void appendBoxMesh(std::vector<MeshVertex>& verts, const Vec3& mn, const Vec3& mx, const Vec3& color);
+
 // ============================================================================
 // GameMap
 // ============================================================================
 
+// Binary map cache: the finished map (blocks, spatial index, flattened
+// waypoint graph, spawns, pickups and optionally the baked mesh and
+// visibility sets) as POD
+// sections behind a section table, loaded with one copy per section from a
+// read-only mapping. Bump MAP_CACHE_VERSION when the layout of any section
+// (or what it holds) changes; caches of another version are rejected.
+constexpr uint32_t MAP_CACHE_VERSION = 3;
+
 class GameMap {
 public:
     void buildArcticMap();
 
+    // Replace this map with one from a cache file; the mesh is skipped
+    // unless withMesh. Returns false (map unchanged) if the file is missing,
+    // of another version or malformed.
+    bool loadCache(const char* path, bool withMesh);
+    // Write this map, and its mesh if baked, as a cache file
+    bool saveCache(const char* path) const;
+
+    // Render mesh of the blocks, grouped into chunks (the server never needs it)
+    static constexpr float MESH_CHUNK_SIZE  = 32.0f;
+    static constexpr float MESH_DETAIL_SIZE = 1.5f; // Blocks no larger than this on every axis
+    void bakeMesh();
+    const std::vector<MeshVertex>&   meshVertices() const { return meshVertices_; }
+    const std::vector<MapMeshChunk>& meshChunks() const { return meshChunks_; }
+    void releaseMesh() { meshVertices_ = {}; meshChunks_ = {}; }
+
+    // Potentially visible sets, baked here (a fraction of a second, spread
+    // over the hardware threads) or loaded from a cache
+    void bakeVisibility();
+    const VisibilityGrid& visibility() const { return vis_; }
+    bool potentiallyVisible(const Vec3& from, const Vec3& to) const { return vis_.potentiallyVisible(from, to); }
+    bool potentiallyVisible(const Vec3& from, const Vec3& center, float radius) const {
+        return vis_.potentiallyVisible(from, center, radius);
+    }
+
+    // Spatial index (built at the end of buildArcticMap). When disabled, every
+    // query falls back to a linear scan over blocks_ (kept for diffing results).
+    void buildSpatialIndex();
+    void setUseSpatialIndex(bool enable) { useSpatialIndex_ = enable; }
+    bool usesSpatialIndex() const { return useSpatialIndex_ && !grid_.empty(); }
+    const BlockGrid& spatialIndex() const { return grid_; }
+    // Run random queries through both paths; returns number of mismatches
+    int verifySpatialIndex(int samples) const;
+
     const std::vector<MapBlock>&    blocks() const { return blocks_; }
     const std::vector<SpawnPoint>&  spawns() const { return spawns_; }
     const std::vector<SpawnPoint>&  teamSpawns(int team) const { return teamSpawns_[team]; }
-    std::vector<WeaponPickup>&      weaponPickups() { return pickups_; }
-    const std::vector<WeaponPickup>& weaponPickups() const { return pickups_; }
+    const std::vector<WeaponPickup>& weaponPickups() const { return pickups_; } // As placed, see World::pickups
     const std::vector<Waypoint>&       waypoints() const { return waypoints_; }
-    std::vector<Waypoint>&             waypoints() { return waypoints_; }
+    std::span<const int> waypointNeighbors(int wp) const {
+        const Waypoint& w = waypoints_[wp];
+        return {waypointLinks_.data() + w.firstNeighbor, w.numNeighbors};
+    }
     const std::vector<VehicleSpawn>&   vehicleSpawns() const { return vehicleSpawns_; }
     Vec3 flagBasePos(int team) const { return flagBasePos_[team]; }
 
@@ -73,20 +371,47 @@ public:
     static int raycastPlayers(const Vec3& origin, const Vec3& dir, float maxDist,
                               const PlayerData players[], int numPlayers,
                               int ignorePlayer, float& hitDist);
+    // Same result as above, but only tests players the grid has near the ray
+    static int raycastPlayers(const Vec3& origin, const Vec3& dir, float maxDist,
+                              const PlayerData players[], const PlayerGrid& grid,
+                              int ignorePlayer, float& hitDist);
+    // Against explicit hitbox positions (feet) in per-axis arrays, e.g.
+    // rewound for lag compensation; players with hittable[i] == 0 are skipped
+    static int raycastPlayers(const Vec3& origin, const Vec3& dir, float maxDist,
+                              const float x[], const float y[], const float z[],
+                              const uint8_t hittable[], int numPlayers,
+                              int ignorePlayer, float& hitDist);
 
 private:
     std::vector<MapBlock>      blocks_;
+    BlockGrid                  grid_;
+    bool                       useSpatialIndex_ = true;
     std::vector<SpawnPoint>    spawns_;
     std::vector<SpawnPoint>    teamSpawns_[2]; // Team-separated spawns
     std::vector<WeaponPickup>  pickups_;
     std::vector<Waypoint>      waypoints_;
+    std::vector<int>           waypointLinks_; // Neighbor lists of all waypoints, back to back
     std::vector<VehicleSpawn>  vehicleSpawns_;
     Vec3                       flagBasePos_[2]; // CTF flag positions
+    std::vector<MeshVertex>    meshVertices_;
+    std::vector<MapMeshChunk>  meshChunks_;
+    VisibilityGrid             vis_;
 
     // Helpers for map building
     void addBlock(const Vec3& min, const Vec3& max, const Vec3& color, bool isFloor = false);
     void addWall(float x1, float z1, float x2, float z2, float height, float baseY, const Vec3& color);
     void addBuilding(float x, float z, float w, float d, float h, int stories, const Vec3& wallColor, const Vec3& floorColor);
+
+    // Query implementations; useGrid selects the spatial index or the
+    // reference linear scan over blocks_ (both must give identical results)
+    bool boxOverlapsAny(const AABB& box, bool useGrid) const;
+    void gatherBlocks(const AABB& box, std::vector<uint32_t>& out) const;
+    bool raycastImpl(const Vec3& origin, const Vec3& dir, float maxDist,
+                     Vec3& hitPoint, float& hitDist, bool useGrid) const;
+    bool hasObstacleAheadImpl(const Vec3& pos, float yaw, float checkDist,
+                              float& obstacleHeight, bool useGrid) const;
+    bool isOnGroundImpl(const Vec3& pos, float radius, bool useGrid) const;
+    Vec3 resolveCollisionImpl(const Vec3& newPos, float radius, float height, bool useGrid) const;
 };
 
 // ============================================================================
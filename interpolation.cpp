@@ -0,0 +1,110 @@
+#include "interpolation.h"
+
+// ============================================================================
+// Entity History
+// ============================================================================
+
+static bool sameState(const InterpState& a, const InterpState& b) {
+    // Snapshots carry quantized values, so unchanged states compare exactly
+    return a.position.x == b.position.x && a.position.y == b.position.y && a.position.z == b.position.z &&
+           a.yaw == b.yaw && a.pitch == b.pitch &&
+           a.turretYaw == b.turretYaw && a.rotorAngle == b.rotorAngle;
+}
+
+// Signed shortest turn from a to b
+static float angleDelta(float a, float b) {
+    return remainderf(b - a, 2.0f * PI);
+}
+
+static InterpState blend(const InterpState& a, const InterpState& b, float t) {
+    InterpState r;
+    r.position   = a.position + (b.position - a.position) * t;
+    r.yaw        = a.yaw + angleDelta(a.yaw, b.yaw) * t;
+    r.pitch      = a.pitch + angleDelta(a.pitch, b.pitch) * t;
+    r.turretYaw  = a.turretYaw + angleDelta(a.turretYaw, b.turretYaw) * t;
+    r.rotorAngle = a.rotorAngle + angleDelta(a.rotorAngle, b.rotorAngle) * t;
+    return r;
+}
+
+void EntityHistory::push(uint32_t tick, const InterpState& state) {
+    if (count_ == SIZE) {
+        head_ = (head_ + 1) % SIZE;
+        count_--;
+    }
+    samples_[(head_ + count_) % SIZE] = {tick, state};
+    count_++;
+}
+
+void EntityHistory::record(uint32_t tick, const InterpState& state) {
+    if (count_ > 0) {
+        const Sample& last = at(count_ - 1);
+        if (tick <= last.tick) return;
+        if (sameState(last.state, state)) {
+            lastSeenTick_ = tick;
+            return;
+        }
+        // The entity stood still through snapshots we received. Anchor the
+        // standstill so the move starts near its real tick instead of
+        // stretching over the whole pause.
+        if (lastSeenTick_ > last.tick && tick - last.tick > HOLD_GAP_TICKS) {
+            InterpState held = last.state;
+            push(tick - HOLD_GAP_TICKS, held);
+        }
+    }
+    push(tick, state);
+    lastSeenTick_ = tick;
+}
+
+InterpState EntityHistory::sample(double renderTick, double extrapolateUntil) const {
+    if (count_ == 0) return {};
+
+    const Sample& newest = at(count_ - 1);
+    if (renderTick >= newest.tick) {
+        // Extend the last motion only while it is recent and continuous
+        if (count_ < 2 || lastSeenTick_ - newest.tick > HOLD_GAP_TICKS) return newest.state;
+        const Sample& prev = at(count_ - 2);
+        uint32_t span = newest.tick - prev.tick;
+        if (span > HOLD_GAP_TICKS ||
+            (newest.state.position - prev.state.position).lengthSq() > SNAP_DISTANCE * SNAP_DISTANCE)
+            return newest.state;
+        double ahead = std::min(renderTick, extrapolateUntil) - newest.tick;
+        if (ahead <= 0) return newest.state;
+        return blend(prev.state, newest.state, (float)(1.0 + ahead / span));
+    }
+
+    if (renderTick <= at(0).tick) return at(0).state;
+
+    int i = count_ - 2;
+    while (i > 0 && at(i).tick > renderTick) i--;
+    const Sample& a = at(i);
+    const Sample& b = at(i + 1);
+    if ((b.state.position - a.state.position).lengthSq() > SNAP_DISTANCE * SNAP_DISTANCE)
+        return a.state;
+    return blend(a.state, b.state, (float)((renderTick - a.tick) / (b.tick - a.tick)));
+}
+
+// ============================================================================
+// Interpolation Clock
+// ============================================================================
+
+void InterpClock::onSnapshot(uint32_t tick) {
+    if (!valid_) {
+        serverTick_ = tick;
+        newestTick_ = tick;
+        valid_ = true;
+    } else if (tick > newestTick_) {
+        newestTick_ = tick;
+    }
+}
+
+void InterpClock::advance(float dt) {
+    if (!valid_) return;
+    double error = (double)newestTick_ - serverTick_;
+    if (fabs(error) > TICK_RATE * 0.5) {
+        serverTick_ = newestTick_; // Stalled or far off: resync instead of drifting back
+        return;
+    }
+    // Up to 10% faster or slower until caught up
+    double rate = 1.0 + std::clamp(error * 0.02, -0.1, 0.1);
+    serverTick_ += dt * TICK_RATE * rate;
+}
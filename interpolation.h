@@ -0,0 +1,76 @@
+#pragma once
+
+#include "common.h"
+
+// ============================================================================
+// Entity Interpolation
+// ============================================================================
+
+// The part of an entity's state that is smoothed between snapshots. Angles
+// are in radians and blend along the shortest arc.
+struct InterpState {
+    Vec3  position;
+    float yaw = 0, pitch = 0;
+    float turretYaw = 0, rotorAngle = 0; // Vehicles only
+};
+
+// Recent states of one entity, keyed by server tick. A sample is recorded
+// only when a snapshot changes the state, so entities the server refreshes
+// every few ticks (relevancy) still get one sample per real update.
+class EntityHistory {
+public:
+    static constexpr int SIZE = 16;
+    // Longer than the slowest relevancy refresh: a change arriving after a
+    // bigger gap follows a standstill, not a slow move
+    static constexpr int   HOLD_GAP_TICKS = 4;
+    static constexpr float SNAP_DISTANCE  = 20.0f; // Teleports (respawn) are not blended
+
+    void clear() { count_ = 0; }
+    bool empty() const { return count_ == 0; }
+
+    // Feed the entity's state from the snapshot for `tick` (ticks must increase)
+    void record(uint32_t tick, const InterpState& state);
+
+    // State at a fractional server tick. Interpolates between the samples
+    // around it; past the newest sample it holds that state, or extrapolates
+    // along the last motion up to `extrapolateUntil` while snapshots are late.
+    InterpState sample(double renderTick, double extrapolateUntil) const;
+
+private:
+    struct Sample {
+        uint32_t    tick;
+        InterpState state;
+    };
+    const Sample& at(int i) const { return samples_[(head_ + i) % SIZE]; } // 0 = oldest
+    void push(uint32_t tick, const InterpState& state);
+
+    Sample   samples_[SIZE];
+    int      head_ = 0;
+    int      count_ = 0;
+    uint32_t lastSeenTick_ = 0; // Newest snapshot that contained the entity
+};
+
+// Playback clock in fractional server ticks. It runs at the tick rate, is
+// steered gently toward the newest snapshot so arrival jitter does not show,
+// and renders `delay` seconds behind it.
+class InterpClock {
+public:
+    static constexpr float MAX_EXTRAPOLATION = 0.1f; // Seconds past the newest snapshot
+
+    void setDelay(float seconds) { delayTicks_ = seconds * TICK_RATE; }
+    float delay() const { return delayTicks_ / TICK_RATE; }
+    void reset() { valid_ = false; }
+
+    void onSnapshot(uint32_t tick);
+    void advance(float dt);
+
+    bool   valid() const { return valid_; }
+    double renderTick() const { return serverTick_ - delayTicks_; }
+    double extrapolateUntil() const { return newestTick_ + MAX_EXTRAPOLATION * TICK_RATE; }
+
+private:
+    double   serverTick_ = 0; // Estimate of the newest tick the server has sent
+    uint32_t newestTick_ = 0;
+    float    delayTicks_ = 0.1f * TICK_RATE;
+    bool     valid_ = false;
+};
@@ -0,0 +1,64 @@
+#include "job_pool.h"
+
+JobPool::JobPool(int threads) {
+    for (int i = 1; i < threads; i++) {
+        workers_.emplace_back([this] { workerLoop(); });
+    }
+}
+
+JobPool::~JobPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+// Claim indices until the range is exhausted. Indices are handed out one at
+// a time since per-item cost (e.g. one bot) varies a lot.
+void JobPool::drain() {
+    for (int i = next_.fetch_add(1); i < count_; i = next_.fetch_add(1)) {
+        (*fn_)(i);
+    }
+}
+
+void JobPool::run(int count, const std::function<void(int)>& fn) {
+    if (count <= 0) return;
+    if (workers_.empty() || count == 1) {
+        for (int i = 0; i < count; i++) fn(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fn_ = &fn;
+        count_ = count;
+        next_.store(0);
+        busy_ = (int)workers_.size();
+        jobGen_++;
+    }
+    wake_.notify_all();
+    drain();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return busy_ == 0; });
+    fn_ = nullptr;
+}
+
+void JobPool::workerLoop() {
+    uint64_t seenGen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stopping_ || jobGen_ != seenGen; });
+            if (stopping_) return;
+            seenGen = jobGen_;
+        }
+        drain();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--busy_ == 0) done_.notify_one();
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// Job Pool
+// ============================================================================
+
+// Fixed set of worker threads for data-parallel loops. run() splits an index
+// range across the workers and the calling thread and returns once every
+// index has been processed. Only one run() may be in flight at a time.
+class JobPool {
+public:
+    explicit JobPool(int threads); // Total threads including the caller; <= 1 runs inline
+    ~JobPool();
+
+    JobPool(const JobPool&) = delete;
+    JobPool& operator=(const JobPool&) = delete;
+
+    void run(int count, const std::function<void(int)>& fn);
+    int  threads() const { return (int)workers_.size() + 1; }
+
+private:
+    void workerLoop();
+    void drain();
+
+    std::vector<std::thread>         workers_;
+    std::mutex                       mutex_;
+    std::condition_variable          wake_;
+    std::condition_variable          done_;
+    const std::function<void(int)>*  fn_ = nullptr;
+    int                              count_ = 0;
+    std::atomic<int>                 next_{0};
+    int                              busy_ = 0;     // Workers still inside the current job
+    uint64_t                         jobGen_ = 0;   // Bumped per run() so workers join each job once
+    bool                             stopping_ = false;
+};
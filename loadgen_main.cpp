@@ -0,0 +1,411 @@
+#include "common.h"
+#include "network.h"
+#include "snapshot.h"
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// Headless Load Generator
+// ============================================================================
+
+// Runs many simulated clients against a server from one process. Each client
+// has its own UDP socket and speaks the real protocol: join, one input per
+// tick from a scripted pattern, decode (or at least ack) every snapshot.
+// Clients are split across a few threads, each driving its share from one
+// epoll loop.
+
+enum class InputPattern : uint8_t { IDLE, WALK, STRAFE, FIGHT };
+
+struct LoadgenConfig {
+    const char*  host = "127.0.0.1";
+    int          port = DEFAULT_PORT;
+    int          clients = 100;
+    int          threads = 4;
+    float        duration = 30.0f;   // Seconds, from the first join
+    float        joinRate = 200.0f;  // New clients per second
+    InputPattern pattern = InputPattern::WALK;
+    bool         decode = true;      // false: ack snapshot headers without decoding
+};
+
+static LoadgenConfig g_config;
+
+static int64_t nowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// ============================================================================
+// Simulated Client
+// ============================================================================
+
+enum class LoadState : uint8_t { WAITING, JOINING, PLAYING, REJECTED };
+
+struct LoadClient {
+    UDPSocket    socket;
+    LoadState    state = LoadState::WAITING;
+    int          index = 0;
+    int64_t      joinAtNs = 0;        // When this client is scheduled to join
+    int64_t      joinSentNs = 0;      // First join attempt, for latency
+    int64_t      lastJoinSendNs = 0;
+    int64_t      joinedNs = 0;
+    int          playerId = -1;
+    uint32_t     inputSeq = 0;
+    uint32_t     lastSnapshotTick = NO_SNAPSHOT_ACK;
+    uint32_t     nextEventSeq = 0;    // Reliable events received, acked like a real client
+    std::unique_ptr<SnapshotRing> ring; // Only when decoding
+
+    // Stats
+    int64_t      lastArrivalNs = 0;
+    uint64_t     snapshots = 0;
+    uint64_t     bytes = 0;
+    uint64_t     decodeFailures = 0;
+    uint64_t     events = 0;
+    uint64_t     eventsLost = 0;      // Skipped by the server, we fell behind its log
+};
+
+// Per-thread results, merged at the end
+struct LoadStats {
+    std::vector<float> joinLatencyMs;
+    std::vector<float> intervalMs;    // Snapshot inter-arrival times
+    std::vector<float> bytesPerSec;   // Per playing client
+    uint64_t snapshots = 0;
+    uint64_t decodeFailures = 0;
+    uint64_t events = 0, eventsLost = 0;
+    int      joined = 0, rejected = 0, neverJoined = 0;
+};
+
+static uint16_t patternKeys(InputPattern pattern, int index, uint32_t seq) {
+    uint32_t phase = (seq / (TICK_RATE * 2) + index) % 4; // New move every 2 s
+    switch (pattern) {
+        case InputPattern::IDLE:
+            return 0;
+        case InputPattern::WALK:
+            return InputState::KEY_W;
+        case InputPattern::STRAFE: {
+            static const uint16_t keys[4] = {InputState::KEY_W | InputState::KEY_A, InputState::KEY_S,
+                                             InputState::KEY_W | InputState::KEY_D, InputState::KEY_JUMP};
+            return keys[phase];
+        }
+        case InputPattern::FIGHT: {
+            uint16_t keys = (phase & 1) ? InputState::KEY_A : InputState::KEY_D;
+            if ((seq + index) % 8 < 4) keys |= InputState::KEY_SHOOT;
+            return keys | InputState::KEY_W;
+        }
+    }
+    return 0;
+}
+
+static void sendJoin(LoadClient& c, const sockaddr_in& server, int64_t now) {
+    JoinPacket join;
+    snprintf(join.name, sizeof(join.name), "load%d", c.index);
+    c.socket.sendTo(&join, sizeof(join), server);
+    if (c.joinSentNs == 0) c.joinSentNs = now;
+    c.lastJoinSendNs = now;
+}
+
+static void sendInput(LoadClient& c, const sockaddr_in& server) {
+    InputPacket pkt;
+    pkt.seq = ++c.inputSeq;
+    pkt.keys = patternKeys(g_config.pattern, c.index, pkt.seq);
+    // Sweep the view slowly so movement covers the map instead of a line
+    pkt.yaw = fmodf(c.index * 2.399f + pkt.seq * 0.004f, 2.0f * PI);
+    pkt.pitch = g_config.pattern == InputPattern::FIGHT ? sinf(pkt.seq * 0.05f) * 0.2f : 0.0f;
+    pkt.ackSnapshotTick = c.lastSnapshotTick;
+    pkt.viewTick = c.lastSnapshotTick;
+    pkt.ackEventSeq = c.nextEventSeq;
+    c.socket.sendTo(&pkt, sizeof(pkt), server);
+}
+
+static void handleSnapshot(LoadClient& c, const uint8_t* buf, int len, int64_t now, LoadStats& stats) {
+    SnapshotPacket hdr;
+    if (!peekSnapshotHeader(buf, len, hdr)) {
+        c.decodeFailures++;
+        return;
+    }
+    // Events count even in a snapshot that arrived out of order. The server
+    // starts a client's events at its join and skips ahead only if it falls
+    // behind the whole log.
+    int32_t skipped = (int32_t)(hdr.firstEventSeq - c.nextEventSeq);
+    if (skipped > 0) {
+        c.eventsLost += (uint32_t)skipped;
+        c.nextEventSeq = hdr.firstEventSeq;
+    }
+    bool eventsOk = forEachSnapshotEvent(buf, hdr, [&](uint32_t seq, const uint8_t*, int) {
+        if (seq == c.nextEventSeq) {
+            c.nextEventSeq++;
+            c.events++;
+        }
+    });
+    if (!eventsOk) {
+        c.decodeFailures++;
+        return;
+    }
+    if (c.lastSnapshotTick != NO_SNAPSHOT_ACK && hdr.serverTick <= c.lastSnapshotTick) return;
+
+    if (c.ring) {
+        const WorldSnapshot* base = nullptr;
+        if (hdr.baseTick != NO_SNAPSHOT_ACK) {
+            base = c.ring->find(hdr.baseTick);
+            if (!base) {
+                c.decodeFailures++;
+                return;
+            }
+        }
+        WorldSnapshot& out = c.ring->slotFor(hdr.serverTick);
+        if (!decodeSnapshot(buf, len, base, out)) {
+            c.decodeFailures++;
+            return;
+        }
+    }
+    c.lastSnapshotTick = hdr.serverTick;
+
+    if (c.lastArrivalNs != 0) stats.intervalMs.push_back((now - c.lastArrivalNs) / 1e6f);
+    c.lastArrivalNs = now;
+    c.snapshots++;
+    c.bytes += len;
+}
+
+static void receive(LoadClient& c, int64_t now, LoadStats& stats) {
+    uint8_t buf[8192];
+    sockaddr_in from;
+    int len;
+    while ((len = c.socket.recvFrom(buf, sizeof(buf), from)) > 0) {
+        switch ((ServerPacket)buf[0]) {
+            case ServerPacket::JOIN_ACK: {
+                if (c.state != LoadState::JOINING || len < (int)sizeof(JoinAckPacket)) break;
+                JoinAckPacket ack;
+                memcpy(&ack, buf, sizeof(ack));
+                if (ack.result != (uint8_t)JoinResult::OK) {
+                    c.state = LoadState::REJECTED;
+                    stats.rejected++;
+                    break;
+                }
+                c.state = LoadState::PLAYING;
+                c.playerId = ack.playerId;
+                c.joinedNs = now;
+                stats.joined++;
+                stats.joinLatencyMs.push_back((now - c.joinSentNs) / 1e6f);
+                break;
+            }
+            case ServerPacket::SNAPSHOT:
+                if (c.state == LoadState::PLAYING) handleSnapshot(c, buf, len, now, stats);
+                break;
+            default:
+                break; // Hit/death events carry nothing we measure
+        }
+    }
+}
+
+// ============================================================================
+// Event Loop Thread
+// ============================================================================
+
+static void runThread(std::vector<LoadClient*> clients, int64_t startNs, LoadStats& stats) {
+    sockaddr_in server = UDPSocket::makeAddr(g_config.host, (uint16_t)g_config.port);
+    int ep = epoll_create1(0);
+    if (ep < 0) {
+        perror("epoll_create1");
+        return;
+    }
+
+    const int64_t tickNs = (int64_t)(TICK_DURATION * 1e9);
+    const int64_t endNs = startNs + (int64_t)(g_config.duration * 1e9);
+    int64_t nextTick = startNs;
+    std::vector<epoll_event> events(256);
+
+    for (;;) {
+        int64_t now = nowNs();
+        if (now >= endNs) break;
+
+        if (now >= nextTick) {
+            for (LoadClient* c : clients) {
+                switch (c->state) {
+                    case LoadState::WAITING:
+                        if (now < c->joinAtNs) break;
+                        if (!c->socket.open()) {
+                            c->state = LoadState::REJECTED;
+                            stats.rejected++;
+                            break;
+                        }
+                        c->socket.setNonBlocking(true);
+                        {
+                            epoll_event ev = {};
+                            ev.events = EPOLLIN;
+                            ev.data.ptr = c;
+                            epoll_ctl(ep, EPOLL_CTL_ADD, c->socket.fd(), &ev);
+                        }
+                        c->state = LoadState::JOINING;
+                        sendJoin(*c, server, now);
+                        break;
+                    case LoadState::JOINING:
+                        if (now - c->lastJoinSendNs > 1000000000) sendJoin(*c, server, now); // Lost join
+                        break;
+                    case LoadState::PLAYING:
+                        sendInput(*c, server);
+                        break;
+                    case LoadState::REJECTED:
+                        break;
+                }
+            }
+            nextTick += tickNs;
+            if (nextTick < now) nextTick = now + tickNs; // Fell behind: do not burst
+        }
+
+        int timeoutMs = (int)std::max<int64_t>(0, (nextTick - nowNs()) / 1000000);
+        int n = epoll_wait(ep, events.data(), (int)events.size(), timeoutMs);
+        now = nowNs();
+        for (int i = 0; i < n; i++) {
+            receive(*(LoadClient*)events[i].data.ptr, now, stats);
+        }
+    }
+
+    int64_t now = nowNs();
+    DisconnectPacket bye;
+    for (LoadClient* c : clients) {
+        if (c->state == LoadState::PLAYING) {
+            c->socket.sendTo(&bye, sizeof(bye), server);
+            double seconds = (now - c->joinedNs) / 1e9;
+            if (seconds > 0) stats.bytesPerSec.push_back((float)(c->bytes / seconds));
+        } else if (c->state == LoadState::JOINING || c->state == LoadState::WAITING) {
+            stats.neverJoined++;
+        }
+        stats.snapshots += c->snapshots;
+        stats.decodeFailures += c->decodeFailures;
+        stats.events += c->events;
+        stats.eventsLost += c->eventsLost;
+        c->socket.close();
+    }
+    ::close(ep);
+}
+
+// ============================================================================
+// Report
+// ============================================================================
+
+static float percentile(std::vector<float>& v, double p) {
+    if (v.empty()) return 0;
+    size_t k = std::min(v.size() - 1, (size_t)(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+static float mean(const std::vector<float>& v) {
+    if (v.empty()) return 0;
+    double sum = 0;
+    for (float x : v) sum += x;
+    return (float)(sum / v.size());
+}
+
+static void printReport(LoadStats& s) {
+    printf("\n=== LOADGEN REPORT ===\n");
+    printf("Clients: %d joined, %d rejected, %d never joined\n", s.joined, s.rejected, s.neverJoined);
+    printf("Join latency: avg %.2f p50 %.2f p99 %.2f max %.2f ms\n",
+           mean(s.joinLatencyMs), percentile(s.joinLatencyMs, 0.5),
+           percentile(s.joinLatencyMs, 0.99), percentile(s.joinLatencyMs, 1.0));
+
+    // Jitter: spread of inter-arrival times around the tick period
+    float avg = mean(s.intervalMs);
+    double var = 0;
+    for (float x : s.intervalMs) var += (x - avg) * (x - avg);
+    float stddev = s.intervalMs.empty() ? 0.0f : (float)sqrt(var / s.intervalMs.size());
+    printf("Snapshot interval: avg %.2f p50 %.2f p99 %.2f max %.2f ms, jitter (stddev) %.2f ms, "
+           "tick %.2f ms\n",
+           avg, percentile(s.intervalMs, 0.5), percentile(s.intervalMs, 0.99),
+           percentile(s.intervalMs, 1.0), stddev, TICK_DURATION * 1000.0f);
+    printf("Snapshots: %llu received, %llu undecodable\n",
+           (unsigned long long)s.snapshots, (unsigned long long)s.decodeFailures);
+    printf("Reliable events: %llu received, %llu lost\n",
+           (unsigned long long)s.events, (unsigned long long)s.eventsLost);
+    printf("Bandwidth per client: avg %.0f p50 %.0f p99 %.0f max %.0f B/s\n",
+           mean(s.bytesPerSec), percentile(s.bytesPerSec, 0.5),
+           percentile(s.bytesPerSec, 0.99), percentile(s.bytesPerSec, 1.0));
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+static bool parsePattern(const char* name, InputPattern& out) {
+    static const char* names[] = {"idle", "walk", "strafe", "fight"};
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            out = (InputPattern)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-host") == 0 && i + 1 < argc) {
+            g_config.host = argv[++i];
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            g_config.port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-clients") == 0 && i + 1 < argc) {
+            g_config.clients = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+            g_config.threads = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-duration") == 0 && i + 1 < argc) {
+            g_config.duration = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "-joinrate") == 0 && i + 1 < argc) {
+            g_config.joinRate = std::max(1.0f, (float)atof(argv[++i]));
+        } else if (strcmp(argv[i], "-pattern") == 0 && i + 1 < argc) {
+            if (!parsePattern(argv[++i], g_config.pattern)) {
+                fprintf(stderr, "Unknown pattern '%s' (idle, walk, strafe, fight)\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-nodecode") == 0) {
+            g_config.decode = false;
+        }
+    }
+    g_config.threads = std::min(g_config.threads, g_config.clients);
+
+    printf("=== ARCTIC ASSAULT LOADGEN ===\n");
+    printf("Target %s:%d, %d clients on %d thread(s), %.0f s, join rate %.0f/s%s\n",
+           g_config.host, g_config.port, g_config.clients, g_config.threads, g_config.duration,
+           g_config.joinRate, g_config.decode ? "" : ", not decoding");
+
+    std::vector<LoadClient> clients(g_config.clients);
+    int64_t startNs = nowNs();
+    for (int i = 0; i < g_config.clients; i++) {
+        clients[i].index = i;
+        clients[i].joinAtNs = startNs + (int64_t)(i / g_config.joinRate * 1e9);
+        if (g_config.decode) clients[i].ring = std::make_unique<SnapshotRing>();
+    }
+
+    std::vector<LoadStats> stats(g_config.threads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < g_config.threads; t++) {
+        std::vector<LoadClient*> mine;
+        for (int i = t; i < g_config.clients; i += g_config.threads) mine.push_back(&clients[i]);
+        threads.emplace_back(runThread, std::move(mine), startNs, std::ref(stats[t]));
+    }
+    for (auto& th : threads) th.join();
+
+    LoadStats total;
+    for (LoadStats& s : stats) {
+        total.joinLatencyMs.insert(total.joinLatencyMs.end(), s.joinLatencyMs.begin(), s.joinLatencyMs.end());
+        total.intervalMs.insert(total.intervalMs.end(), s.intervalMs.begin(), s.intervalMs.end());
+        total.bytesPerSec.insert(total.bytesPerSec.end(), s.bytesPerSec.begin(), s.bytesPerSec.end());
+        total.snapshots += s.snapshots;
+        total.decodeFailures += s.decodeFailures;
+        total.events += s.events;
+        total.eventsLost += s.eventsLost;
+        total.joined += s.joined;
+        total.rejected += s.rejected;
+        total.neverJoined += s.neverJoined;
+    }
+    printReport(total);
+    return 0;
+}
@@ -6,7 +6,7 @@
 #include <cstring>
 #include <cstdio>
 
-bool UDPSocket::bind(uint16_t port) {
+bool UDPSocket::bind(uint16_t port, bool reusePort) {
     fd_ = socket(AF_INET, SOCK_DGRAM, 0);
     if (fd_ < 0) {
         perror("socket");
@@ -15,6 +15,12 @@ bool UDPSocket::bind(uint16_t port) {
 
     int opt = 1;
     setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (reusePort && setsockopt(fd_, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("setsockopt(SO_REUSEPORT)");
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
 
     sockaddr_in addr = {};
     addr.sin_family = AF_INET;
@@ -52,11 +58,90 @@ int UDPSocket::sendTo(const void* data, size_t len, const sockaddr_in& addr) {
     return ::sendto(fd_, data, len, 0, (const sockaddr*)&addr, sizeof(addr));
 }
 
+int UDPSocket::sendBatch(const BatchPacket* packets, int count) {
+    constexpr int CHUNK = 64;
+    int sent = 0;
+    while (sent < count) {
+        int n = std::min(count - sent, CHUNK);
+        iovec iov[CHUNK][2];
+#ifdef __linux__
+        mmsghdr msgs[CHUNK];
+        memset(msgs, 0, sizeof(msgs[0]) * n);
+#endif
+        for (int i = 0; i < n; i++) {
+            const BatchPacket& p = packets[sent + i];
+            int iovCount = 0;
+            if (p.headLen > 0) iov[i][iovCount++] = {const_cast<void*>(p.head), p.headLen};
+            if (p.bodyLen > 0) iov[i][iovCount++] = {const_cast<void*>(p.body), p.bodyLen};
+#ifdef __linux__
+            msghdr& m = msgs[i].msg_hdr;
+#else
+            msghdr m = {};
+#endif
+            m.msg_name = const_cast<sockaddr_in*>(p.addr);
+            m.msg_namelen = sizeof(sockaddr_in);
+            m.msg_iov = iov[i];
+            m.msg_iovlen = iovCount;
+#ifndef __linux__
+            if (::sendmsg(fd_, &m, 0) < 0) return sent + i;
+#endif
+        }
+#ifdef __linux__
+        int r = ::sendmmsg(fd_, msgs, n, 0);
+        if (r <= 0) return sent;
+        sent += r;
+        if (r < n) return sent;
+#else
+        sent += n;
+#endif
+    }
+    return sent;
+}
+
 int UDPSocket::recvFrom(void* buf, size_t maxLen, sockaddr_in& fromAddr) {
     socklen_t addrLen = sizeof(fromAddr);
     return ::recvfrom(fd_, buf, maxLen, 0, (sockaddr*)&fromAddr, &addrLen);
 }
 
+int UDPSocket::recvBatch(RecvBatch& batch) {
+    constexpr int CHUNK = 64;
+    const int slots = std::min((int)batch.packets_.size(), CHUNK);
+    batch.count_ = 0;
+    iovec iov[CHUNK];
+#ifdef __linux__
+    mmsghdr msgs[CHUNK];
+    memset(msgs, 0, sizeof(msgs[0]) * slots);
+    for (int i = 0; i < slots; i++) {
+        iov[i] = {batch.storage_.data() + (size_t)i * batch.slotSize_, (size_t)batch.slotSize_};
+        msghdr& m = msgs[i].msg_hdr;
+        m.msg_name = &batch.packets_[i].from;
+        m.msg_namelen = sizeof(sockaddr_in);
+        m.msg_iov = &iov[i];
+        m.msg_iovlen = 1;
+    }
+    int r = ::recvmmsg(fd_, msgs, slots, MSG_DONTWAIT, nullptr);
+    if (r <= 0) return 0;
+    for (int i = 0; i < r; i++) {
+        RecvBatch::Packet& p = batch.packets_[i];
+        p.data = (const uint8_t*)iov[i].iov_base;
+        // Truncated datagrams are passed on clipped to the slot, like recvFrom
+        p.len = std::min((int)msgs[i].msg_len, batch.slotSize_);
+    }
+    batch.count_ = r;
+#else
+    for (int i = 0; i < slots; i++) {
+        RecvBatch::Packet& p = batch.packets_[i];
+        uint8_t* slot = batch.storage_.data() + (size_t)i * batch.slotSize_;
+        int len = recvFrom(slot, batch.slotSize_, p.from);
+        if (len <= 0) break;
+        p.data = slot;
+        p.len = len;
+        batch.count_++;
+    }
+#endif
+    return batch.count_;
+}
+
 void UDPSocket::close() {
     if (fd_ >= 0) {
         ::close(fd_);
@@ -75,3 +160,56 @@ sockaddr_in UDPSocket::makeAddr(const char* ip, uint16_t port) {
 bool UDPSocket::addrEqual(const sockaddr_in& a, const sockaddr_in& b) {
     return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
 }
+
+// ============================================================================
+// AddrTable
+// ============================================================================
+
+uint32_t AddrTable::hash(const sockaddr_in& addr) {
+    uint64_t key = ((uint64_t)addr.sin_addr.s_addr << 16) | addr.sin_port;
+    key *= 0x9E3779B97F4A7C15ull;
+    return (uint32_t)(key >> 32);
+}
+
+int AddrTable::probe(const sockaddr_in& addr) const {
+    for (uint32_t i = hash(addr), n = 0; n < CAPACITY; i++, n++) {
+        const Entry& e = entries_[i & (CAPACITY - 1)];
+        if (e.slot < 0) return -1;
+        if (e.ip == addr.sin_addr.s_addr && e.port == addr.sin_port) return i & (CAPACITY - 1);
+    }
+    return -1;
+}
+
+int AddrTable::find(const sockaddr_in& addr) const {
+    int idx = probe(addr);
+    return idx < 0 ? -1 : entries_[idx].slot;
+}
+
+void AddrTable::insert(const sockaddr_in& addr, int slot) {
+    int idx = probe(addr);
+    if (idx < 0) {
+        idx = hash(addr) & (CAPACITY - 1);
+        while (entries_[idx].slot >= 0) idx = (idx + 1) & (CAPACITY - 1);
+    }
+    entries_[idx] = {addr.sin_addr.s_addr, addr.sin_port, (int16_t)slot};
+}
+
+void AddrTable::erase(const sockaddr_in& addr) {
+    int idx = probe(addr);
+    if (idx < 0) return;
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    int hole = idx;
+    for (int j = (idx + 1) & (CAPACITY - 1); entries_[j].slot >= 0; j = (j + 1) & (CAPACITY - 1)) {
+        sockaddr_in a = {};
+        a.sin_addr.s_addr = entries_[j].ip;
+        a.sin_port = entries_[j].port;
+        int home = hash(a) & (CAPACITY - 1);
+        // Move j into the hole unless its home lies cyclically in (hole, j]
+        bool stays = hole <= j ? (home > hole && home <= j) : (home > hole || home <= j);
+        if (!stays) {
+            entries_[hole] = entries_[j];
+            hole = j;
+        }
+    }
+    entries_[hole] = Entry{};
+}
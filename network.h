@@ -2,6 +2,7 @@
 
 #include "common.h"
 #include <netinet/in.h>
+#include <vector>
 
 // ============================================================================
 // Packet Types
@@ -31,12 +32,19 @@ struct PacketHeader {
     uint8_t type;
 };
 
+// Bumped whenever any packet layout changes. Clients and servers only talk
+// when the versions match exactly.
+constexpr uint16_t PROTOCOL_VERSION = 7;
+
 // Client -> Server: Join request
 struct JoinPacket {
-    uint8_t type = (uint8_t)ClientPacket::JOIN;
-    char    name[32] = {};
+    uint8_t  type = (uint8_t)ClientPacket::JOIN;
+    char     name[32] = {};
+    uint16_t protocolVersion = PROTOCOL_VERSION;
 };
 
+constexpr uint32_t NO_SNAPSHOT_ACK = 0xFFFFFFFF;
+
 // Client -> Server: Input per tick
 struct InputPacket {
     uint8_t  type = (uint8_t)ClientPacket::INPUT;
@@ -45,6 +53,10 @@ struct InputPacket {
     float    yaw = 0;
     float    pitch = 0;
     uint8_t  classSelect = 0xFF; // 0xFF = no change, 0-3 = select class
+    uint32_t ackSnapshotTick = NO_SNAPSHOT_ACK; // Newest snapshot decoded, delta baseline
+    uint32_t viewTick = NO_SNAPSHOT_ACK;        // Server tick remote players were drawn at,
+    uint8_t  viewTickFrac = 0;                  // plus viewTickFrac / 256; lag compensation
+    uint32_t ackEventSeq = 0;                   // Every reliable event before this one arrived
 };
 
 // Client -> Server: Disconnect
@@ -52,11 +64,19 @@ struct DisconnectPacket {
     uint8_t type = (uint8_t)ClientPacket::DISCONNECT;
 };
 
+enum class JoinResult : uint8_t {
+    OK               = 0,
+    VERSION_MISMATCH = 1,
+    SERVER_FULL      = 2,
+};
+
 // Server -> Client: Join acknowledgement
 struct JoinAckPacket {
     uint8_t  type = (uint8_t)ServerPacket::JOIN_ACK;
     uint8_t  playerId = 0;
     uint8_t  numBots = 0;
+    uint16_t protocolVersion = PROTOCOL_VERSION;
+    uint8_t  result = (uint8_t)JoinResult::OK;
 };
 
 // Per-player state in snapshot
@@ -71,7 +91,10 @@ struct NetPlayerState {
     int16_t  vehicleId = -1;
     uint8_t  teamId = 0;
     uint8_t  playerClass = 0;
+    uint8_t  isBot = 0;
     uint8_t  spotted = 0;
+    uint8_t  relevant = 1; // 0: out of this client's interest; only state,
+                           // health, team, class and isBot are current
 };
 
 // Per-vehicle state in snapshot
@@ -112,24 +135,27 @@ struct NetWeaponState {
     uint8_t  active = 0;
 };
 
-// Server -> Client: Full world snapshot
+// Server -> Client: World snapshot, full or delta against an acked baseline
 struct SnapshotPacket {
     uint8_t  type = (uint8_t)ServerPacket::SNAPSHOT;
     uint32_t serverTick = 0;
+    uint32_t baseTick = NO_SNAPSHOT_ACK; // NO_SNAPSHOT_ACK = full snapshot
     uint32_t ackInputSeq = 0;
-    uint8_t  numPlayers = 0;
     uint8_t  teamScores[2] = {0, 0}; // CTF scores
-    // Followed by: NetPlayerState[numPlayers]
-    // Then: uint8_t numWeapons
-    // Then: NetWeaponState[numWeapons]
-    // Then: uint8_t numVehicles
-    // Then: NetVehicleState[numVehicles]
-    // Then: 2x NetFlagState (team 0, team 1)
-    // Then: uint8_t numTornados
-    // Then: NetTornadoState[numTornados]
+    uint32_t firstEventSeq = 0;      // Sequence number of the first reliable event
+    uint16_t eventBytes = 0;
+    // Followed by eventBytes of reliable events: hit/death packets back to
+    // back, numbered firstEventSeq, firstEventSeq + 1, ... The server repeats
+    // unacked events, oldest first and as many as fit, in each snapshot
+    // until the client's ackEventSeq passes them. firstEventSeq jumps
+    // forward only when a client fell behind the server's whole event log.
+    // Then a bit-packed stream with one section per entity kind
+    // (players, weapons, vehicles, flags, tornados). Each entry carries a
+    // slot, a field-group mask and the changed groups, quantized;
+    // mask == 0 removes the entity. See snapshot.cpp.
 };
 
-// Server -> Client: Hit notification
+// Server -> Client: Hit notification, a reliable event (see SnapshotPacket)
 struct PlayerHitPacket {
     uint8_t type = (uint8_t)ServerPacket::PLAYER_HIT;
     uint8_t attackerId = 0;
@@ -137,28 +163,90 @@ struct PlayerHitPacket {
     int16_t damage = 0;
 };
 
-// Server -> Client: Death notification
+// Server -> Client: Death notification, a reliable event. Names aren't
+// replicated, so the kill feed tells bots from players by these flags.
 struct PlayerDiedPacket {
     uint8_t type = (uint8_t)ServerPacket::PLAYER_DIED;
     uint8_t victimId = 0;
     uint8_t killerId = 0;
+    uint8_t victimIsBot = 0;
+    uint8_t killerIsBot = 0;
 };
 
 #pragma pack(pop)
 
+// Size of a reliable event record by its type byte; 0 if it is not one
+inline int reliableEventSize(uint8_t type) {
+    switch ((ServerPacket)type) {
+        case ServerPacket::PLAYER_HIT:  return (int)sizeof(PlayerHitPacket);
+        case ServerPacket::PLAYER_DIED: return (int)sizeof(PlayerDiedPacket);
+        default:                        return 0;
+    }
+}
+
 // ============================================================================
 // UDP Socket Wrapper
 // ============================================================================
 
+// Preallocated packet slots filled by UDPSocket::recvBatch. The slots are
+// reused on every call, so packets are only valid until the next recvBatch
+// into the same batch.
+class RecvBatch {
+public:
+    struct Packet {
+        const uint8_t* data = nullptr;
+        int            len = 0;
+        sockaddr_in    from = {};
+
+        // View the datagram as a packed packet struct without copying, or
+        // nullptr if it is too short
+        template<typename T>
+        const T* as() const { return len >= (int)sizeof(T) ? reinterpret_cast<const T*>(data) : nullptr; }
+    };
+
+    RecvBatch(int slots, int slotSize)
+        : storage_((size_t)slots * slotSize), packets_(slots), slotSize_(slotSize) {}
+
+    int count() const { return count_; }
+    const Packet& operator[](int i) const { return packets_[i]; }
+
+private:
+    friend class UDPSocket;
+    std::vector<uint8_t> storage_;
+    std::vector<Packet>  packets_;
+    int                  slotSize_;
+    int                  count_ = 0;
+};
+
 class UDPSocket {
 public:
-    bool bind(uint16_t port);
+    // One datagram for sendBatch: a per-recipient head followed by a body
+    // that is usually shared by many recipients. Both are gathered straight
+    // from the caller's memory; either may be empty.
+    struct BatchPacket {
+        const sockaddr_in* addr = nullptr;
+        const void*        head = nullptr;
+        size_t             headLen = 0;
+        const void*        body = nullptr;
+        size_t             bodyLen = 0;
+    };
+
+    // reusePort lets several sockets bind the same port (SO_REUSEPORT); the
+    // kernel then spreads senders across them by address hash
+    bool bind(uint16_t port, bool reusePort = false);
     bool open();
     void setNonBlocking(bool enable);
     int  sendTo(const void* data, size_t len, const sockaddr_in& addr);
     int  recvFrom(void* buf, size_t maxLen, sockaddr_in& fromAddr);
+    // Receive up to one batch of datagrams with a single syscall (recvmmsg
+    // on Linux). Returns how many arrived; 0 when nothing is pending.
+    int  recvBatch(RecvBatch& batch);
+    // Send many datagrams with as few syscalls as possible (sendmmsg on
+    // Linux). Returns how many were sent; stops early if the socket would block.
+    int  sendBatch(const BatchPacket* packets, int count);
     void close();
     bool isValid() const { return fd_ >= 0; }
+    int  fd() const { return fd_; } // For epoll/poll readiness only
 
     static sockaddr_in makeAddr(const char* ip, uint16_t port);
     static bool addrEqual(const sockaddr_in& a, const sockaddr_in& b);
@@ -166,3 +254,28 @@ public:
 private:
     int fd_ = -1;
 };
+
+// ============================================================================
+// Address Table
+// ============================================================================
+
+// Open-addressing hash from peer address (ip + port) to a connection slot,
+// so per-packet sender lookup does not scan every connection
+class AddrTable {
+public:
+    int  find(const sockaddr_in& addr) const; // -1 if unknown
+    void insert(const sockaddr_in& addr, int slot);
+    void erase(const sockaddr_in& addr);
+
+private:
+    static constexpr int CAPACITY = 256; // Power of two, >= 2 * MAX_PLAYERS
+    struct Entry {
+        uint32_t ip = 0;
+        uint16_t port = 0;
+        int16_t  slot = -1; // -1 = empty
+    };
+    static uint32_t hash(const sockaddr_in& addr);
+    int probe(const sockaddr_in& addr) const; // Index holding addr, or -1
+
+    Entry entries_[CAPACITY];
+};
@@ -0,0 +1,70 @@
+#include "prediction.h"
+
+// ============================================================================
+// Movement Predictor
+// ============================================================================
+
+void MovementPredictor::reset() {
+    active_ = false;
+    correction_ = {0, 0, 0};
+}
+
+void MovementPredictor::predict(uint32_t seq, const InputState& input, PlayerData& player,
+                                const GameMap& map) {
+    prevPosition_ = player.position;
+    active_ = true;
+    tickPlayer(player, input, map, TICK_DURATION);
+
+    Entry& e = history_[seq % HISTORY];
+    e.seq = seq;
+    e.input = input;
+    e.after = player;
+    newestSeq_ = seq;
+}
+
+void MovementPredictor::reconcile(uint32_t ackSeq, const Vec3& serverPos, PlayerData& player,
+                                  const GameMap& map) {
+    const Entry& acked = history_[ackSeq % HISTORY];
+    if (!active_ || acked.seq != ackSeq || ackSeq > newestSeq_) {
+        // Nothing predicted from this input on (just spawned, or too old)
+        player.position = serverPos;
+        prevPosition_ = serverPos;
+        correction_ = {0, 0, 0};
+        return;
+    }
+
+    // Server position, plus what only the client tracks (velocity) as it was
+    // predicted at that input; then replay everything newer
+    PlayerData state = acked.after;
+    state.position = serverPos;
+    state.state = player.state;
+    state.playerClass = player.playerClass;
+    for (uint32_t seq = ackSeq + 1; seq <= newestSeq_; seq++) {
+        Entry& e = history_[seq % HISTORY];
+        if (e.seq != seq) break;
+        tickPlayer(state, e.input, map, TICK_DURATION);
+        e.after = state;
+    }
+
+    Vec3 error = player.position - state.position;
+    player.position = state.position;
+    player.velocity = state.velocity;
+    if (error.lengthSq() > SNAP_DISTANCE * SNAP_DISTANCE) {
+        prevPosition_ = player.position;
+        correction_ = {0, 0, 0};
+    } else {
+        // Shift the whole drawn path so nothing visibly moves this frame
+        prevPosition_ = prevPosition_ - error;
+        correction_ += error;
+    }
+}
+
+void MovementPredictor::update(float dt) {
+    correction_ = correction_ * expf(-CORRECTION_RATE * dt);
+}
+
+Vec3 MovementPredictor::renderPosition(const PlayerData& player, float alpha) const {
+    if (!active_) return player.position;
+    alpha = std::clamp(alpha, 0.0f, 1.0f);
+    return prevPosition_ + (player.position - prevPosition_) * alpha + correction_;
+}
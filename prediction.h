@@ -0,0 +1,48 @@
+#pragma once
+
+#include "common.h"
+#include "game.h"
+
+// ============================================================================
+// Local Movement Prediction
+// ============================================================================
+
+// Runs the local player's inputs through tickPlayer as soon as they are sent
+// instead of waiting a round trip for the server. Every input is kept with
+// the state it produced until the server acks it. A snapshot then restarts
+// from the server's position after the acked input and replays the newer
+// ones; the visible difference is blended out over a few frames.
+class MovementPredictor {
+public:
+    static constexpr int   HISTORY = 128;          // Inputs kept, 2 s at the tick rate
+    static constexpr float SNAP_DISTANCE = 4.0f;   // Bigger errors (respawn, knockback) jump
+    static constexpr float CORRECTION_RATE = 10.0f; // Per second, decay of the visible error
+
+    void reset();
+
+    // Apply one tick of input, already sent to the server as `seq`
+    void predict(uint32_t seq, const InputState& input, PlayerData& player, const GameMap& map);
+
+    // The server had the local player at serverPos after processing input
+    // ackSeq. Replays every newer input on top of it.
+    void reconcile(uint32_t ackSeq, const Vec3& serverPos, PlayerData& player, const GameMap& map);
+
+    // Decay the visible correction
+    void update(float dt);
+
+    // Where to draw the player: between the last two predicted ticks
+    // (alpha = fraction of the current tick elapsed) plus the correction
+    Vec3 renderPosition(const PlayerData& player, float alpha) const;
+
+private:
+    struct Entry {
+        uint32_t    seq = 0;
+        InputState  input;
+        PlayerData  after; // State once this input was applied
+    };
+    Entry    history_[HISTORY];
+    uint32_t newestSeq_ = 0;
+    bool     active_ = false;
+    Vec3     prevPosition_;  // Predicted position one tick before the current one
+    Vec3     correction_;    // Visible offset still to blend out
+};
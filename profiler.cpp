@@ -0,0 +1,156 @@
+#include "profiler.h"
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+// ============================================================================
+// Per-Thread Counters
+// ============================================================================
+
+namespace {
+
+struct ZoneCounters {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> totalNs{0};
+    std::atomic<uint64_t> buckets[Profiler::BUCKETS] = {};
+};
+
+// One per thread that ever recorded. Blocks are never freed, so the reporter
+// can read a thread's counters after it exits.
+struct ThreadCounters {
+    ZoneCounters     zones[Profiler::MAX_ZONES];
+    std::atomic<int> group{-1};
+    ThreadCounters*  next = nullptr;
+};
+
+std::mutex                   g_registryMutex;
+const char*                  g_zoneNames[Profiler::MAX_ZONES] = {};
+std::atomic<int>             g_numZones{0};
+std::atomic<ThreadCounters*> g_threads{nullptr};
+
+struct ZoneTotals {
+    uint64_t calls = 0, totalNs = 0;
+    uint64_t buckets[Profiler::BUCKETS] = {};
+};
+// Totals at the previous report, per group (row 0 is group -1), so
+// reporting never writes the counters
+ZoneTotals g_lastReport[Profiler::MAX_GROUPS + 1][Profiler::MAX_ZONES];
+
+thread_local ThreadCounters* t_counters = nullptr;
+
+ThreadCounters* threadCounters() {
+    if (!t_counters) {
+        ThreadCounters* tc = new ThreadCounters();
+        tc->next = g_threads.load();
+        while (!g_threads.compare_exchange_weak(tc->next, tc)) {}
+        t_counters = tc;
+    }
+    return t_counters;
+}
+
+bool inGroup(const ThreadCounters* tc, int group) {
+    return group < 0 || tc->group.load(std::memory_order_relaxed) == group;
+}
+
+// Single writer per counter: a plain load + store is enough
+void bump(std::atomic<uint64_t>& c, uint64_t v) {
+    c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+int bucketFor(int64_t ns) {
+    uint64_t us = (uint64_t)(ns / 1000);
+    int b = 0;
+    while (us > 0 && b < Profiler::BUCKETS - 1) {
+        us >>= 1;
+        b++;
+    }
+    return b;
+}
+
+// Upper bound of a bucket in microseconds
+double bucketLimitUs(int b) {
+    return (double)(1ull << b);
+}
+
+} // namespace
+
+// ============================================================================
+// Profiler
+// ============================================================================
+
+int Profiler::registerZone(const char* name) {
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    int n = g_numZones.load();
+    for (int i = 0; i < n; i++) {
+        if (strcmp(g_zoneNames[i], name) == 0) return i;
+    }
+    if (n == MAX_ZONES) return MAX_ZONES - 1; // Overflow shares the last zone
+    g_zoneNames[n] = name;
+    g_numZones.store(n + 1);
+    return n;
+}
+
+void Profiler::record(int zone, int64_t ns) {
+    ZoneCounters& z = threadCounters()->zones[zone];
+    bump(z.calls, 1);
+    bump(z.totalNs, (uint64_t)ns);
+    bump(z.buckets[bucketFor(ns)], 1);
+}
+
+void Profiler::setThreadGroup(int group) {
+    threadCounters()->group.store(group < MAX_GROUPS ? group : -1, std::memory_order_relaxed);
+}
+
+int Profiler::numZones() {
+    return g_numZones.load();
+}
+
+Profiler::ZoneTotal Profiler::zoneTotal(int zone, int group) {
+    ZoneTotal t = {g_zoneNames[zone], 0, 0};
+    for (ThreadCounters* tc = g_threads.load(); tc; tc = tc->next) {
+        if (!inGroup(tc, group)) continue;
+        t.calls += tc->zones[zone].calls.load(std::memory_order_relaxed);
+        t.totalNs += tc->zones[zone].totalNs.load(std::memory_order_relaxed);
+    }
+    return t;
+}
+
+void Profiler::report(FILE* out, double seconds, int group) {
+    if (group >= MAX_GROUPS) group = -1;
+    int n = g_numZones.load();
+    for (int zone = 0; zone < n; zone++) {
+        ZoneTotals now;
+        for (ThreadCounters* tc = g_threads.load(); tc; tc = tc->next) {
+            if (!inGroup(tc, group)) continue;
+            const ZoneCounters& z = tc->zones[zone];
+            now.calls += z.calls.load(std::memory_order_relaxed);
+            now.totalNs += z.totalNs.load(std::memory_order_relaxed);
+            for (int b = 0; b < BUCKETS; b++) now.buckets[b] += z.buckets[b].load(std::memory_order_relaxed);
+        }
+
+        ZoneTotals& last = g_lastReport[group + 1][zone];
+        uint64_t calls = now.calls - last.calls;
+        uint64_t totalNs = now.totalNs - last.totalNs;
+        uint64_t hist[BUCKETS];
+        for (int b = 0; b < BUCKETS; b++) hist[b] = now.buckets[b] - last.buckets[b];
+        last = now;
+        if (calls == 0) continue;
+
+        // Percentiles resolve to the bucket they fall in
+        double p50 = 0, p99 = 0;
+        uint64_t seen = 0;
+        for (int b = 0; b < BUCKETS; b++) {
+            seen += hist[b];
+            if (p50 == 0 && seen * 2 >= calls) p50 = bucketLimitUs(b);
+            if (p99 == 0 && seen * 100 >= calls * 99) p99 = bucketLimitUs(b);
+        }
+
+        fprintf(out, "  %-16s %8llu calls %8.2f ms/s  avg %8.1f us  p50 <%6.0f us  p99 <%6.0f us  |",
+                g_zoneNames[zone], (unsigned long long)calls,
+                seconds > 0 ? totalNs / 1e6 / seconds : 0.0, totalNs / 1e3 / calls, p50, p99);
+        int lastBucket = BUCKETS - 1;
+        while (lastBucket > 0 && hist[lastBucket] == 0) lastBucket--;
+        for (int b = 0; b <= lastBucket; b++) fprintf(out, " %llu", (unsigned long long)hist[b]);
+        fprintf(out, "\n");
+    }
+}
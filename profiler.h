@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// ============================================================================
+// Scoped Profiler
+// ============================================================================
+
+// PROFILE_SCOPE("name") times the rest of the enclosing block into a named
+// zone. Each thread counts into its own block of relaxed atomics (only that
+// thread writes them), so timing a scope costs two clock reads and a few
+// uncontended stores. Profiler::report() sums all threads' counters since
+// the previous report into a per-zone line with a log2 time histogram.
+//
+// Building with -DFPS_NO_PROFILE (make PROFILE=0) compiles every scope out.
+class Profiler {
+public:
+    static constexpr int MAX_ZONES = 32;
+    static constexpr int BUCKETS   = 16; // Bucket b holds times below 2^b microseconds
+    static constexpr int MAX_GROUPS = 64;
+
+    // Tag the calling thread's counters with a group in [0, MAX_GROUPS),
+    // e.g. the match shard it runs, so reports can be split by it. Threads
+    // start in no group; group -1 in a query means all threads.
+    static void setThreadGroup(int group);
+
+    // Zone id for a name; the same name always maps to the same zone
+    static int  registerZone(const char* name);
+    static void record(int zone, int64_t ns);
+
+    // Print every zone used since the last report of the same group;
+    // `seconds` is the time that report covers, for the per-second columns
+    static void report(FILE* out, double seconds, int group = -1);
+
+    // Lifetime totals of one zone summed over all threads, for tools that
+    // want raw numbers rather than a report
+    struct ZoneTotal {
+        const char* name;
+        uint64_t    calls;
+        uint64_t    totalNs;
+    };
+    static int       numZones();
+    static ZoneTotal zoneTotal(int zone, int group = -1);
+};
+
+#ifndef FPS_NO_PROFILE
+
+class ProfileScope {
+public:
+    explicit ProfileScope(int zone) : zone_(zone), start_(std::chrono::steady_clock::now()) {}
+    ~ProfileScope() {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count();
+        Profiler::record(zone_, ns);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    int zone_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) \
+    static const int PROFILE_CONCAT(profileZone_, __LINE__) = Profiler::registerZone(name); \
+    ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(PROFILE_CONCAT(profileZone_, __LINE__))
+
+#else
+
+#define PROFILE_SCOPE(name) do {} while (0)
+
+#endif
@@ -1,8 +1,10 @@
 #include "renderer.h"
+#include "profiler.h"
 #include <cstdio>
 #include <cstring>
 #include <cmath>
 #include <cstdlib>
+#include <cstddef>
 #include <vector>
 #include <algorithm>
 
@@ -48,32 +50,51 @@ void main() {
 }
 )";
 
+// Entity parts: same lighting as worldVertSrc, but the model matrix and
+// color come from per-instance attributes (one instance per part)
+static const char* instancedVertSrc = R"(
+#version 330 core
+layout(location=0) in vec3 aPos;
+layout(location=1) in vec3 aNormal;
+layout(location=3) in mat4 iModel; // Locations 3-6
+layout(location=7) in vec3 iColor;
+uniform mat4 uViewProj;
+out vec3 vNormal;
+out vec3 vColor;
+out vec3 vWorldPos;
+void main() {
+    vec4 world = iModel * vec4(aPos, 1.0);
+    gl_Position = uViewProj * world;
+    vNormal = mat3(iModel) * aNormal;
+    vColor = iColor;
+    vWorldPos = world.xyz;
+}
+)";
+
 static const char* hudVertSrc = R"(
 #version 330 core
 layout(location=0) in vec2 aPos;
 layout(location=1) in vec2 aUV;
+layout(location=2) in vec4 aColor;
 uniform mat4 uProj;
 out vec2 vUV;
+out vec4 vColor;
 void main() {
     gl_Position = uProj * vec4(aPos, 0.0, 1.0);
     vUV = aUV;
+    vColor = aColor;
 }
 )";
 
 static const char* hudFragSrc = R"(
 #version 330 core
 in vec2 vUV;
+in vec4 vColor;
 out vec4 FragColor;
-uniform vec4 uColor;
 uniform sampler2D uTex;
-uniform int uUseTexture;
 void main() {
-    if (uUseTexture == 1) {
-        float a = texture(uTex, vUV).r;
-        FragColor = vec4(uColor.rgb, uColor.a * a);
-    } else {
-        FragColor = uColor;
-    }
+    // Rects sample the atlas' solid texel, so text and rects share one draw
+    FragColor = vec4(vColor.rgb, vColor.a * texture(uTex, vUV).r);
 }
 )";
 
@@ -86,10 +107,10 @@ static const char* particleVertSrc = R"(
 layout(location=0) in vec3 aPos;
 layout(location=1) in vec4 aColor;
 layout(location=2) in float aSize;
-uniform mat4 uVP;
+uniform mat4 uViewProj;
 out vec4 vColor;
 void main() {
-    gl_Position = uVP * vec4(aPos, 1.0);
+    gl_Position = uViewProj * vec4(aPos, 1.0);
     gl_PointSize = aSize / gl_Position.w * 400.0;
     vColor = aColor;
 }
@@ -374,13 +395,26 @@ void Renderer::init(int width, int height) {
         compileShader(GL_VERTEX_SHADER, particleVertSrc),
         compileShader(GL_FRAGMENT_SHADER, particleFragSrc));
 
+    instancedShader_ = linkProgram(
+        compileShader(GL_VERTEX_SHADER, instancedVertSrc),
+        compileShader(GL_FRAGMENT_SHADER, worldFragSrc));
+
+    // Uniform locations never change after linking
+    resolveUniforms(worldShader_, worldLoc_);
+    resolveUniforms(instancedShader_, instancedLoc_);
+    resolveUniforms(hudShader_, hudLoc_);
+    resolveUniforms(particleShader_, particleLoc_);
+
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); // The only blend mode used
+
     glEnable(GL_PROGRAM_POINT_SIZE);
 
     buildPrimitiveMeshes();
+    buildInstancedMeshes();
     buildParticleMesh();
     buildFontTexture();
+    buildHudBatch();
 
-    particles_.reserve(MAX_PARTICLES);
     footprints_.reserve(MAX_FOOTPRINTS);
 }
 
@@ -389,12 +423,28 @@ void Renderer::shutdown() {
     if (cubeVAO_) { glDeleteVertexArrays(1, &cubeVAO_); glDeleteBuffers(1, &cubeVBO_); }
     if (sphereVAO_) { glDeleteVertexArrays(1, &sphereVAO_); glDeleteBuffers(1, &sphereVBO_); }
     if (cylinderVAO_) { glDeleteVertexArrays(1, &cylinderVAO_); glDeleteBuffers(1, &cylinderVBO_); }
-    if (quadVAO_) { glDeleteVertexArrays(1, &quadVAO_); glDeleteBuffers(1, &quadVBO_); }
+    if (hudVAO_) {
+        for (GLsync& fence : hudFence_) {
+            if (fence) glDeleteSync(fence);
+            fence = nullptr;
+        }
+        if (hudMapped_) {
+            glBindBuffer(GL_ARRAY_BUFFER, hudVBO_);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            hudMapped_ = nullptr;
+        }
+        glDeleteVertexArrays(1, &hudVAO_);
+        glDeleteBuffers(1, &hudVBO_);
+    }
+    for (int m = 0; m < MESH_COUNT; m++) {
+        if (instanceVAO_[m]) { glDeleteVertexArrays(1, &instanceVAO_[m]); glDeleteBuffers(1, &instanceVBO_[m]); }
+    }
     if (particleVAO_) { glDeleteVertexArrays(1, &particleVAO_); glDeleteBuffers(1, &particleVBO_); }
     if (fontTexture_) glDeleteTextures(1, &fontTexture_);
     if (worldShader_) glDeleteProgram(worldShader_);
     if (hudShader_) glDeleteProgram(hudShader_);
     if (particleShader_) glDeleteProgram(particleShader_);
+    if (instancedShader_) glDeleteProgram(instancedShader_);
 }
 
 void Renderer::resize(int width, int height) {
@@ -407,53 +457,14 @@ void Renderer::resize(int width, int height) {
 // Mesh Generation
 // ============================================================================
 
-struct Vertex {
-    float px, py, pz;
-    float nx, ny, nz;
-    float cr, cg, cb;
-};
-
-static void addQuadFace(std::vector<Vertex>& verts,
-                        Vec3 p0, Vec3 p1, Vec3 p2, Vec3 p3, Vec3 normal, Vec3 color) {
-    Vertex v;
-    v.nx = normal.x; v.ny = normal.y; v.nz = normal.z;
-    v.cr = color.x; v.cg = color.y; v.cb = color.z;
-
-    // Triangle 1
-    v.px = p0.x; v.py = p0.y; v.pz = p0.z; verts.push_back(v);
-    v.px = p1.x; v.py = p1.y; v.pz = p1.z; verts.push_back(v);
-    v.px = p2.x; v.py = p2.y; v.pz = p2.z; verts.push_back(v);
-    // Triangle 2
-    v.px = p0.x; v.py = p0.y; v.pz = p0.z; verts.push_back(v);
-    v.px = p2.x; v.py = p2.y; v.pz = p2.z; verts.push_back(v);
-    v.px = p3.x; v.py = p3.y; v.pz = p3.z; verts.push_back(v);
-}
-
-static void addBox(std::vector<Vertex>& verts, const Vec3& mn, const Vec3& mx, const Vec3& color) {
-    Vec3 c = color;
-    // Front (+Z)
-    addQuadFace(verts, {mn.x,mn.y,mx.z},{mx.x,mn.y,mx.z},{mx.x,mx.y,mx.z},{mn.x,mx.y,mx.z}, {0,0,1}, c);
-    // Back (-Z)
-    addQuadFace(verts, {mx.x,mn.y,mn.z},{mn.x,mn.y,mn.z},{mn.x,mx.y,mn.z},{mx.x,mx.y,mn.z}, {0,0,-1}, c);
-    // Right (+X)
-    addQuadFace(verts, {mx.x,mn.y,mx.z},{mx.x,mn.y,mn.z},{mx.x,mx.y,mn.z},{mx.x,mx.y,mx.z}, {1,0,0}, c);
-    // Left (-X)
-    addQuadFace(verts, {mn.x,mn.y,mn.z},{mn.x,mn.y,mx.z},{mn.x,mx.y,mx.z},{mn.x,mx.y,mn.z}, {-1,0,0}, c);
-    // Top (+Y)
-    Vec3 tc = {c.x*1.1f, c.y*1.1f, c.z*1.1f}; // Slightly brighter top
-    addQuadFace(verts, {mn.x,mx.y,mx.z},{mx.x,mx.y,mx.z},{mx.x,mx.y,mn.z},{mn.x,mx.y,mn.z}, {0,1,0}, tc);
-    // Bottom (-Y)
-    Vec3 bc = {c.x*0.7f, c.y*0.7f, c.z*0.7f}; // Darker bottom
-    addQuadFace(verts, {mn.x,mn.y,mn.z},{mx.x,mn.y,mn.z},{mx.x,mn.y,mx.z},{mn.x,mn.y,mx.z}, {0,-1,0}, bc);
-}
+// Same layout as the baked map mesh
+using Vertex = MeshVertex;
 
+// Upload the map's baked mesh (GameMap::bakeMesh or a map cache)
 void Renderer::buildMapMesh(const GameMap& map) {
-    std::vector<Vertex> verts;
-    verts.reserve(map.blocks().size() * 36);
-
-    for (const auto& b : map.blocks()) {
-        addBox(verts, b.bounds.min, b.bounds.max, b.color);
-    }
+    const std::vector<MeshVertex>& verts = map.meshVertices();
+    if (verts.empty()) return;
+    mapChunks_ = map.meshChunks();
 
     mapVertexCount_ = (int)verts.size();
 
@@ -478,7 +489,7 @@ void Renderer::buildPrimitiveMeshes() {
     {
         std::vector<Vertex> verts;
         Vec3 white = {1,1,1};
-        addBox(verts, {-0.5f,-0.5f,-0.5f}, {0.5f,0.5f,0.5f}, white);
+        appendBoxMesh(verts, {-0.5f,-0.5f,-0.5f}, {0.5f,0.5f,0.5f}, white);
         cubeVertexCount_ = (int)verts.size();
 
         glGenVertexArrays(1, &cubeVAO_);
@@ -590,27 +601,34 @@ void Renderer::buildPrimitiveMeshes() {
         glEnableVertexAttribArray(2);
         glBindVertexArray(0);
     }
+}
 
-    // --- Screen quad for HUD ---
-    {
-        float quadData[] = {
-            // pos (x,y), uv (u,v)
-            0, 0,  0, 0,
-            1, 0,  1, 0,
-            1, 1,  1, 1,
-            0, 0,  0, 0,
-            1, 1,  1, 1,
-            0, 1,  0, 1,
-        };
-        glGenVertexArrays(1, &quadVAO_);
-        glGenBuffers(1, &quadVBO_);
-        glBindVertexArray(quadVAO_);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO_);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadData), quadData, GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)0);
+// Instanced VAOs reuse the primitive mesh VBOs for per-vertex data and add
+// a per-instance stream (model matrix + color) with divisor 1
+void Renderer::buildInstancedMeshes() {
+    const GLuint meshVBO[MESH_COUNT] = {cubeVBO_, sphereVBO_, cylinderVBO_};
+    for (int m = 0; m < MESH_COUNT; m++) {
+        glGenVertexArrays(1, &instanceVAO_[m]);
+        glGenBuffers(1, &instanceVBO_[m]);
+        glBindVertexArray(instanceVAO_[m]);
+
+        glBindBuffer(GL_ARRAY_BUFFER, meshVBO[m]);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
         glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)(2*sizeof(float)));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(3*sizeof(float)));
         glEnableVertexAttribArray(1);
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO_[m]);
+        for (int col = 0; col < 4; col++) {
+            glVertexAttribPointer(3 + col, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void*)(col * 4 * sizeof(float)));
+            glEnableVertexAttribArray(3 + col);
+            glVertexAttribDivisor(3 + col, 1);
+        }
+        glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void*)offsetof(InstanceData, r));
+        glEnableVertexAttribArray(7);
+        glVertexAttribDivisor(7, 1);
         glBindVertexArray(0);
     }
 }
@@ -632,8 +650,24 @@ void Renderer::buildFontTexture() {
                 }
             }
         }
+
+        // OpenGL textures: row 0 of pixel data = v=0 (bottom). Our atlas has
+        // glyph row 0 (top of char) at lower pixel rows. So lower v = glyph top.
+        // Bottom of quad needs glyph bottom (higher v), top needs glyph top (lower v).
+        GlyphUV& uv = glyphUV_[idx];
+        uv.u0   = cx / (float)atlasW;
+        uv.u1   = (cx + 8) / (float)atlasW;
+        uv.vTop = cy / (float)atlasH;
+        uv.vBot = (cy + 8) / (float)atlasH;
     }
 
+    // The last atlas cell (index 95) is unused by the font; fill it solid for rects
+    int sx = (95 % 16) * 8, sy = (95 / 16) * 8;
+    for (int row = 0; row < 8; row++)
+        memset(&pixels[(sy + row) * atlasW + sx], 255, 8);
+    solidU_ = (sx + 4) / (float)atlasW;
+    solidV_ = (sy + 4) / (float)atlasH;
+
     glGenTextures(1, &fontTexture_);
     glBindTexture(GL_TEXTURE_2D, fontTexture_);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
@@ -644,56 +678,267 @@ void Renderer::buildFontTexture() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 }
 
+// ============================================================================
+// View Frustum
+// ============================================================================
+
+// Gribb-Hartmann: each plane is the last row of the (column-major) matrix
+// plus or minus one of the others
+void Frustum::fromMatrix(const Mat4& vp) {
+    const float* m = vp.m;
+    for (int i = 0; i < 3; i++) {
+        for (int sign = 0; sign < 2; sign++) {
+            float* p = planes[i * 2 + sign];
+            float k = sign ? -1.0f : 1.0f;
+            for (int c = 0; c < 4; c++) p[c] = m[c * 4 + 3] + k * m[c * 4 + i];
+            float len = sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+            if (len > 0) for (int c = 0; c < 4; c++) p[c] /= len;
+        }
+    }
+}
+
+bool Frustum::intersects(const AABB& box) const {
+    for (const auto& p : planes) {
+        // The box corner furthest along the plane normal
+        float x = p[0] >= 0 ? box.max.x : box.min.x;
+        float y = p[1] >= 0 ? box.max.y : box.min.y;
+        float z = p[2] >= 0 ? box.max.z : box.min.z;
+        if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0) return false;
+    }
+    return true;
+}
+
+bool Frustum::intersectsSphere(const Vec3& center, float radius) const {
+    for (const auto& p : planes) {
+        if (p[0] * center.x + p[1] * center.y + p[2] * center.z + p[3] < -radius) return false;
+    }
+    return true;
+}
+
 // ============================================================================
 // Drawing Helpers
 // ============================================================================
 
-void Renderer::drawCube(const Mat4& model, const Vec3& color) {
-    Mat4 mvp = projectionMatrix_ * viewMatrix_ * model;
-    glUseProgram(worldShader_);
-    glUniformMatrix4fv(glGetUniformLocation(worldShader_, "uMVP"), 1, GL_FALSE, mvp.m);
-    glUniformMatrix4fv(glGetUniformLocation(worldShader_, "uModel"), 1, GL_FALSE, model.m);
+void Renderer::resolveUniforms(GLuint program, ProgramUniforms& loc) {
+    loc.mvp        = glGetUniformLocation(program, "uMVP");
+    loc.model      = glGetUniformLocation(program, "uModel");
+    loc.viewProj   = glGetUniformLocation(program, "uViewProj");
+    loc.sunDir     = glGetUniformLocation(program, "uSunDir");
+    loc.sunColor   = glGetUniformLocation(program, "uSunColor");
+    loc.ambient    = glGetUniformLocation(program, "uAmbient");
+    loc.proj       = glGetUniformLocation(program, "uProj");
+    loc.tex        = glGetUniformLocation(program, "uTex");
+}
 
-    // Override color via a uniform trick: we multiply vertex color (white) by our desired color
-    // Actually our cube mesh has white color, so we set sun/ambient to produce desired color
-    // Simpler: use the existing lighting but set uniform for color override
-    Vec3 sunDir = Vec3{0.4f, 0.8f, 0.3f}.normalize();
-    glUniform3f(glGetUniformLocation(worldShader_, "uSunDir"), sunDir.x, sunDir.y, sunDir.z);
-    glUniform3f(glGetUniformLocation(worldShader_, "uSunColor"), 0.6f * color.x, 0.6f * color.y, 0.6f * color.z);
-    glUniform3f(glGetUniformLocation(worldShader_, "uAmbient"), 0.4f * color.x, 0.4f * color.y, 0.4f * color.z);
+const Renderer::ProgramUniforms& Renderer::uniformsFor(GLuint program) const {
+    if (program == instancedShader_) return instancedLoc_;
+    if (program == hudShader_) return hudLoc_;
+    if (program == particleShader_) return particleLoc_;
+    return worldLoc_;
+}
 
-    glBindVertexArray(cubeVAO_);
-    glDrawArrays(GL_TRIANGLES, 0, cubeVertexCount_);
+void Renderer::submit(RenderCommand& cmd) {
+    cmd.key = ((uint64_t)cmd.layer << 56) | ((uint64_t)cmd.state << 48) |
+              ((uint64_t)(cmd.program & 0xFFFFFF) << 24) | (cmd.vao & 0xFFFFFF);
+    commands_.push_back(cmd);
 }
 
-void Renderer::drawSphere(const Mat4& model, const Vec3& color) {
-    Mat4 mvp = projectionMatrix_ * viewMatrix_ * model;
-    glUseProgram(worldShader_);
-    glUniformMatrix4fv(glGetUniformLocation(worldShader_, "uMVP"), 1, GL_FALSE, mvp.m);
-    glUniformMatrix4fv(glGetUniformLocation(worldShader_, "uModel"), 1, GL_FALSE, model.m);
+void Renderer::submitWorld(GLuint vao, int first, int count, const Mat4& model,
+                           const Vec3& sunColor, const Vec3& ambient) {
+    RenderCommand cmd;
+    cmd.state = worldState_;
+    cmd.program = worldShader_;
+    cmd.vao = vao;
+    cmd.first = first;
+    cmd.count = count;
+    cmd.mvp = projectionMatrix_ * viewMatrix_ * model;
+    cmd.model = model;
+    cmd.sunColor = sunColor;
+    cmd.ambient = ambient;
+    submit(cmd);
+}
 
-    Vec3 sunDir = Vec3{0.4f, 0.8f, 0.3f}.normalize();
-    glUniform3f(glGetUniformLocation(worldShader_, "uSunDir"), sunDir.x, sunDir.y, sunDir.z);
-    glUniform3f(glGetUniformLocation(worldShader_, "uSunColor"), 0.6f * color.x, 0.6f * color.y, 0.6f * color.z);
-    glUniform3f(glGetUniformLocation(worldShader_, "uAmbient"), 0.4f * color.x, 0.4f * color.y, 0.4f * color.z);
+// The primitive meshes are white, so the color is folded into the lights
+void Renderer::drawCube(const Mat4& model, const Vec3& color) {
+    submitWorld(cubeVAO_, 0, cubeVertexCount_, model, color * 0.6f, color * 0.4f);
+}
 
-    glBindVertexArray(sphereVAO_);
-    glDrawArrays(GL_TRIANGLES, 0, sphereVertexCount_);
+void Renderer::drawSphere(const Mat4& model, const Vec3& color) {
+    submitWorld(sphereVAO_, 0, sphereVertexCount_, model, color * 0.6f, color * 0.4f);
 }
 
 void Renderer::drawCylinder(const Mat4& model, const Vec3& color) {
-    Mat4 mvp = projectionMatrix_ * viewMatrix_ * model;
-    glUseProgram(worldShader_);
-    glUniformMatrix4fv(glGetUniformLocation(worldShader_, "uMVP"), 1, GL_FALSE, mvp.m);
-    glUniformMatrix4fv(glGetUniformLocation(worldShader_, "uModel"), 1, GL_FALSE, model.m);
+    submitWorld(cylinderVAO_, 0, cylinderVertexCount_, model, color * 0.6f, color * 0.4f);
+}
+
+void Renderer::buildHudBatch() {
+    glGenVertexArrays(1, &hudVAO_);
+    glGenBuffers(1, &hudVBO_);
+    glBindVertexArray(hudVAO_);
+    glBindBuffer(GL_ARRAY_BUFFER, hudVBO_);
+
+    if (GLEW_ARB_buffer_storage) {
+        GLsizeiptr size = (GLsizeiptr)HUD_SECTIONS * HUD_MAX_VERTS * sizeof(HudVertex);
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+        hudMapped_ = (HudVertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+    }
+    if (!hudMapped_) {
+        glBufferData(GL_ARRAY_BUFFER, HUD_MAX_VERTS * sizeof(HudVertex), nullptr, GL_STREAM_DRAW);
+        hudStaging_.resize(HUD_MAX_VERTS);
+    }
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)offsetof(HudVertex, x));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)offsetof(HudVertex, u));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HudVertex), (void*)offsetof(HudVertex, r));
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+}
 
-    Vec3 sunDir = Vec3{0.4f, 0.8f, 0.3f}.normalize();
-    glUniform3f(glGetUniformLocation(worldShader_, "uSunDir"), sunDir.x, sunDir.y, sunDir.z);
-    glUniform3f(glGetUniformLocation(worldShader_, "uSunColor"), 0.6f * color.x, 0.6f * color.y, 0.6f * color.z);
-    glUniform3f(glGetUniformLocation(worldShader_, "uAmbient"), 0.4f * color.x, 0.4f * color.y, 0.4f * color.z);
+void Renderer::hudQuad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1,
+                       const Vec3& color, float alpha, int screenW, int screenH) {
+    if (hudCount_ + 6 > HUD_MAX_VERTS) return; // Section full, drop the quad
+    HudVertex* out = hudMapped_ ? hudMapped_ + hudSection_ * HUD_MAX_VERTS + hudCount_
+                                : hudStaging_.data() + hudCount_;
+    auto c8 = [](float v) { return (uint8_t)lroundf(std::clamp(v, 0.0f, 1.0f) * 255.0f); };
+    uint8_t r = c8(color.x), g = c8(color.y), b = c8(color.z), a = c8(alpha);
+    out[0] = {x0, y0, u0, v0, r, g, b, a};
+    out[1] = {x1, y0, u1, v0, r, g, b, a};
+    out[2] = {x1, y1, u1, v1, r, g, b, a};
+    out[3] = {x0, y0, u0, v0, r, g, b, a};
+    out[4] = {x1, y1, u1, v1, r, g, b, a};
+    out[5] = {x0, y1, u0, v1, r, g, b, a};
+    hudCount_ += 6;
+    hudScreenW_ = screenW;
+    hudScreenH_ = screenH;
+}
+
+// Queue everything batched since the last flush as one HUD command
+void Renderer::submitHudBatch() {
+    if (hudCount_ == 0) return;
+    if (!hudMapped_) {
+        glBindBuffer(GL_ARRAY_BUFFER, hudVBO_);
+        glBufferData(GL_ARRAY_BUFFER, HUD_MAX_VERTS * sizeof(HudVertex), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, hudCount_ * sizeof(HudVertex), hudStaging_.data());
+    }
+    RenderCommand cmd;
+    cmd.layer = LAYER_HUD;
+    cmd.state = STATE_BLEND | STATE_NO_DEPTH_TEST;
+    cmd.program = hudShader_;
+    cmd.vao = hudVAO_;
+    cmd.first = hudMapped_ ? hudSection_ * HUD_MAX_VERTS : 0;
+    cmd.count = hudCount_;
+    cmd.screenW = hudScreenW_;
+    cmd.screenH = hudScreenH_;
+    submit(cmd);
+}
+
+// After the batch was drawn: fence its section and move to the next one,
+// waiting until the GPU has finished reading it (normally long done)
+void Renderer::finishHudBatch() {
+    if (hudCount_ == 0) return;
+    hudCount_ = 0;
+    if (!hudMapped_) return;
+    hudFence_[hudSection_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    hudSection_ = (hudSection_ + 1) % HUD_SECTIONS;
+    GLsync& next = hudFence_[hudSection_];
+    if (next) {
+        glClientWaitSync(next, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        glDeleteSync(next);
+        next = nullptr;
+    }
+}
 
-    glBindVertexArray(cylinderVAO_);
-    glDrawArrays(GL_TRIANGLES, 0, cylinderVertexCount_);
+void Renderer::queueInstance(PrimitiveMesh mesh, const Mat4& model, const Vec3& color) {
+    InstanceData inst;
+    memcpy(inst.model, model.m, sizeof(inst.model));
+    inst.r = color.x; inst.g = color.y; inst.b = color.z;
+    instances_[mesh].push_back(inst);
+}
+
+static void applyRenderState(uint8_t state) {
+    if (state & 1) glDisable(GL_CULL_FACE); else glEnable(GL_CULL_FACE);
+    glDepthMask((state & 2) ? GL_FALSE : GL_TRUE);
+    if (state & 4) glDisable(GL_DEPTH_TEST); else glEnable(GL_DEPTH_TEST);
+    if (state & 8) glEnable(GL_BLEND); else glDisable(GL_BLEND);
+}
+
+void Renderer::flush() {
+    PROFILE_SCOPE("r_flush");
+    // Entity parts become one instanced command per mesh. Color is per
+    // instance, so the lights are white with drawCube's 0.6/0.4 split.
+    const int vertexCount[MESH_COUNT] = {cubeVertexCount_, sphereVertexCount_, cylinderVertexCount_};
+    for (int m = 0; m < MESH_COUNT; m++) {
+        std::vector<InstanceData>& list = instances_[m];
+        if (list.empty()) continue;
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO_[m]);
+        glBufferData(GL_ARRAY_BUFFER, list.size() * sizeof(InstanceData), list.data(), GL_STREAM_DRAW);
+        RenderCommand cmd;
+        cmd.program = instancedShader_;
+        cmd.vao = instanceVAO_[m];
+        cmd.count = vertexCount[m];
+        cmd.instances = (int)list.size();
+        cmd.mvp = projectionMatrix_ * viewMatrix_;
+        cmd.sunColor = {0.6f, 0.6f, 0.6f};
+        cmd.ambient = {0.4f, 0.4f, 0.4f};
+        submit(cmd);
+        list.clear();
+    }
+    submitHudBatch();
+    if (commands_.empty()) return;
+
+    std::stable_sort(commands_.begin(), commands_.end(),
+                     [](const RenderCommand& a, const RenderCommand& b) { return a.key < b.key; });
+
+    const Vec3 sunDir = Vec3{0.4f, 0.8f, 0.3f}.normalize();
+    GLuint program = 0, vao = 0;
+    int state = -1, projW = -1, projH = -1;
+    for (const RenderCommand& cmd : commands_) {
+        if (cmd.state != state) {
+            applyRenderState(cmd.state);
+            state = cmd.state;
+        }
+        const ProgramUniforms& u = uniformsFor(cmd.program);
+        if (cmd.program != program) {
+            program = cmd.program;
+            glUseProgram(program);
+            if (u.sunDir >= 0) glUniform3f(u.sunDir, sunDir.x, sunDir.y, sunDir.z);
+            if (u.tex >= 0) {
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, fontTexture_);
+                glUniform1i(u.tex, 0);
+            }
+            projW = projH = -1;
+        }
+        if (cmd.vao != vao) {
+            vao = cmd.vao;
+            glBindVertexArray(vao);
+        }
+
+        if (u.mvp >= 0) glUniformMatrix4fv(u.mvp, 1, GL_FALSE, cmd.mvp.m);
+        if (u.model >= 0) glUniformMatrix4fv(u.model, 1, GL_FALSE, cmd.model.m);
+        if (u.viewProj >= 0) glUniformMatrix4fv(u.viewProj, 1, GL_FALSE, cmd.mvp.m);
+        if (u.sunColor >= 0) glUniform3f(u.sunColor, cmd.sunColor.x, cmd.sunColor.y, cmd.sunColor.z);
+        if (u.ambient >= 0) glUniform3f(u.ambient, cmd.ambient.x, cmd.ambient.y, cmd.ambient.z);
+        if (u.proj >= 0 && (cmd.screenW != projW || cmd.screenH != projH)) {
+            Mat4 proj = Mat4::ortho(0, (float)cmd.screenW, 0, (float)cmd.screenH, -1, 1);
+            glUniformMatrix4fv(u.proj, 1, GL_FALSE, proj.m);
+            projW = cmd.screenW;
+            projH = cmd.screenH;
+        }
+
+        if (cmd.instances > 0)
+            glDrawArraysInstanced(cmd.mode, cmd.first, cmd.count, cmd.instances);
+        else
+            glDrawArrays(cmd.mode, cmd.first, cmd.count);
+    }
+
+    applyRenderState(0);
+    glBindVertexArray(0);
+    commands_.clear();
+    finishHudBatch();
 }
 
 // ============================================================================
@@ -714,23 +959,34 @@ void Renderer::beginFrame(const Vec3& cameraPos, float yaw, float pitch) {
     };
     Vec3 target = cameraPos + forward;
     viewMatrix_ = Mat4::lookAt(cameraPos, target, {0, 1, 0});
+    frustum_.fromMatrix(projectionMatrix_ * viewMatrix_);
 }
 
 void Renderer::renderMap() {
-    Mat4 model = Mat4::identity();
-    Mat4 mvp = projectionMatrix_ * viewMatrix_ * model;
-
-    glUseProgram(worldShader_);
-    glUniformMatrix4fv(glGetUniformLocation(worldShader_, "uMVP"), 1, GL_FALSE, mvp.m);
-    glUniformMatrix4fv(glGetUniformLocation(worldShader_, "uModel"), 1, GL_FALSE, model.m);
-
-    Vec3 sunDir = Vec3{0.4f, 0.8f, 0.3f}.normalize();
-    glUniform3f(glGetUniformLocation(worldShader_, "uSunDir"), sunDir.x, sunDir.y, sunDir.z);
-    glUniform3f(glGetUniformLocation(worldShader_, "uSunColor"), 0.95f, 0.92f, 0.85f);
-    glUniform3f(glGetUniformLocation(worldShader_, "uAmbient"), 0.35f, 0.38f, 0.45f);
-
-    glBindVertexArray(mapVAO_);
-    glDrawArrays(GL_TRIANGLES, 0, mapVertexCount_);
+    PROFILE_SCOPE("r_map");
+    // Visible chunks whose drawn ranges touch in the VBO merge into one draw
+    int first = 0, count = 0;
+    for (const MapMeshChunk& chunk : mapChunks_) {
+        if (!frustum_.intersects(chunk.bounds)) continue;
+
+        Vec3 nearest = {std::clamp(cameraPos_.x, chunk.bounds.min.x, chunk.bounds.max.x),
+                        std::clamp(cameraPos_.y, chunk.bounds.min.y, chunk.bounds.max.y),
+                        std::clamp(cameraPos_.z, chunk.bounds.min.z, chunk.bounds.max.z)};
+        bool farAway = (nearest - cameraPos_).lengthSq() > MAP_LOD_DISTANCE * MAP_LOD_DISTANCE;
+        int drawCount = farAway ? chunk.coarseCount : chunk.count;
+        if (drawCount == 0) continue;
+
+        if (count > 0 && first + count == chunk.first) {
+            count += drawCount;
+        } else {
+            if (count > 0)
+                submitWorld(mapVAO_, first, count, Mat4::identity(), {0.95f, 0.92f, 0.85f}, {0.35f, 0.38f, 0.45f});
+            first = chunk.first;
+            count = drawCount;
+        }
+    }
+    if (count > 0)
+        submitWorld(mapVAO_, first, count, Mat4::identity(), {0.95f, 0.92f, 0.85f}, {0.35f, 0.38f, 0.45f});
 }
 
 void Renderer::renderPlayer(const PlayerData& p, bool isLocalPlayer) {
@@ -753,12 +1009,12 @@ void Renderer::renderPlayer(const PlayerData& p, bool isLocalPlayer) {
     Mat4 torso = Mat4::translate({pos.x, pos.y + 0.9f, pos.z}) *
                  Mat4::rotateY(-p.yaw) *
                  Mat4::scale({0.6f, 0.8f, 0.35f});
-    drawCube(torso, bodyColor);
+    queueCube(torso, bodyColor);
 
     // Head
     Mat4 head = Mat4::translate({pos.x, pos.y + 1.55f, pos.z}) *
                 Mat4::scale({0.22f, 0.22f, 0.22f});
-    drawSphere(head, skinColor);
+    queueSphere(head, skinColor);
 
     // Legs
     float legOffX = 0.15f;
@@ -767,7 +1023,7 @@ void Renderer::renderPlayer(const PlayerData& p, bool isLocalPlayer) {
         float lz = pos.z + cosf(p.yaw + PI * 0.5f) * legOffX * i;
         Mat4 leg = Mat4::translate({lx, pos.y + 0.25f, lz}) *
                    Mat4::scale({0.12f, 0.5f, 0.12f});
-        drawCylinder(leg, legColor);
+        queueCylinder(leg, legColor);
     }
 
     // Arms
@@ -779,7 +1035,7 @@ void Renderer::renderPlayer(const PlayerData& p, bool isLocalPlayer) {
                    Mat4::rotateY(-p.yaw) *
                    Mat4::rotateX(-0.3f) *
                    Mat4::scale({0.1f, 0.55f, 0.1f});
-        drawCylinder(arm, bodyColor);
+        queueCylinder(arm, bodyColor);
     }
 }
 
@@ -804,18 +1060,20 @@ void Renderer::renderWeaponPickup(const WeaponPickup& w, float time) {
     Mat4 model = Mat4::translate({pos.x, pos.y + 0.4f + bob, pos.z}) *
                  Mat4::rotateY(rot) *
                  Mat4::scale({0.15f, 0.15f, 0.5f});
-    drawCube(model, color);
+    queueCube(model, color);
 
     // Small base platform
     Mat4 base = Mat4::translate({pos.x, pos.y + 0.02f, pos.z}) *
                 Mat4::scale({0.4f, 0.04f, 0.4f});
-    drawCube(base, {0.8f, 0.8f, 0.2f});
+    queueCube(base, {0.8f, 0.8f, 0.2f});
 }
 
 void Renderer::renderFirstPersonWeapon(WeaponType type, float fireCooldown, float time) {
     // Render weapon viewmodel in front of camera
     // We use a separate projection with smaller FOV to prevent clipping
 
+    flush(); // Draw the world with its own matrices before depth is cleared
+
     Mat4 savedProj = projectionMatrix_;
     Mat4 savedView = viewMatrix_;
 
@@ -966,81 +1224,25 @@ void Renderer::renderFirstPersonWeapon(WeaponType type, float fireCooldown, floa
 
 void Renderer::drawText(const char* text, float x, float y, float scale,
                         const Vec3& color, int screenW, int screenH) {
-    glUseProgram(hudShader_);
-    Mat4 proj = Mat4::ortho(0, (float)screenW, 0, (float)screenH, -1, 1);
-    glUniformMatrix4fv(glGetUniformLocation(hudShader_, "uProj"), 1, GL_FALSE, proj.m);
-    glUniform4f(glGetUniformLocation(hudShader_, "uColor"), color.x, color.y, color.z, 1.0f);
-    glUniform1i(glGetUniformLocation(hudShader_, "uUseTexture"), 1);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, fontTexture_);
-    glUniform1i(glGetUniformLocation(hudShader_, "uTex"), 0);
-
     float charW = 8 * scale;
     float charH = 8 * scale;
 
-    glBindVertexArray(quadVAO_);
-
     for (int i = 0; text[i]; i++) {
         int ch = text[i];
         if (ch < 32 || ch > 126) ch = '?';
-        int idx = ch - 32;
-        int col = idx % 16;
-        int row = idx / 16;
-        float u0 = col * 8.0f / 128.0f;
-        float u1 = u0 + 8.0f / 128.0f;
-        // OpenGL textures: row 0 of pixel data = v=0 (bottom). Our atlas has
-        // glyph row 0 (top of char) at lower pixel rows. So lower v = glyph top.
-        // Bottom of quad needs glyph bottom (higher v), top needs glyph top (lower v).
-        float vBot = (row + 1) * 8.0f / 64.0f; // glyph bottom row
-        float vTop = row * 8.0f / 64.0f;        // glyph top row
-
+        const GlyphUV& uv = glyphUV_[ch - 32];
         float qx = x + i * charW;
-        float qy = y;
-
-        // Update quad positions and UVs
-        float quadData[] = {
-            qx,          qy,          u0, vBot,
-            qx + charW,  qy,          u1, vBot,
-            qx + charW,  qy + charH,  u1, vTop,
-            qx,          qy,          u0, vBot,
-            qx + charW,  qy + charH,  u1, vTop,
-            qx,          qy + charH,  u0, vTop,
-        };
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO_);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(quadData), quadData);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        hudQuad(qx, y, qx + charW, y + charH, uv.u0, uv.vBot, uv.u1, uv.vTop,
+                color, 1.0f, screenW, screenH);
     }
 }
 
 void Renderer::drawRect(float x, float y, float w, float h,
                         const Vec3& color, float alpha, int screenW, int screenH) {
-    glUseProgram(hudShader_);
-    Mat4 proj = Mat4::ortho(0, (float)screenW, 0, (float)screenH, -1, 1);
-    glUniformMatrix4fv(glGetUniformLocation(hudShader_, "uProj"), 1, GL_FALSE, proj.m);
-    glUniform4f(glGetUniformLocation(hudShader_, "uColor"), color.x, color.y, color.z, alpha);
-    glUniform1i(glGetUniformLocation(hudShader_, "uUseTexture"), 0);
-
-    float quadData[] = {
-        x,     y,     0, 0,
-        x + w, y,     1, 0,
-        x + w, y + h, 1, 1,
-        x,     y,     0, 0,
-        x + w, y + h, 1, 1,
-        x,     y + h, 0, 1,
-    };
-
-    glBindVertexArray(quadVAO_);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO_);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(quadData), quadData);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    hudQuad(x, y, x + w, y + h, solidU_, solidV_, solidU_, solidV_, color, alpha, screenW, screenH);
 }
 
 void Renderer::renderCrosshair(int screenW, int screenH, bool hitMarker) {
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
     float cx = screenW * 0.5f;
     float cy = screenH * 0.5f;
 
@@ -1064,16 +1266,9 @@ void Renderer::renderCrosshair(int screenW, int screenH, bool hitMarker) {
         drawRect(cx - thick/2, cy - size, thick, size - 3, white, 0.8f, screenW, screenH);
         drawRect(cx - thick/2, cy + 3, thick, size - 3, white, 0.8f, screenW, screenH);
     }
-
-    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
 }
 
 void Renderer::renderMuzzleFlash(int screenW, int screenH, float timer) {
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
     float cx = screenW * 0.5f;
     float cy = screenH * 0.5f;
 
@@ -1086,16 +1281,9 @@ void Renderer::renderMuzzleFlash(int screenW, int screenH, float timer) {
     float coreSize = flashSize * 0.4f;
     drawRect(cx - coreSize/2 + 40, cy - coreSize/2 - 60,
              coreSize, coreSize, {1.0f, 1.0f, 0.8f}, alpha * 0.9f, screenW, screenH);
-
-    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
 }
 
 void Renderer::renderDamageFlash(int screenW, int screenH, float timer) {
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
     float alpha = (timer / 0.3f) * 0.35f;
     drawRect(0, 0, (float)screenW, (float)screenH, {0.8f, 0.0f, 0.0f}, alpha, screenW, screenH);
 
@@ -1105,16 +1293,10 @@ void Renderer::renderDamageFlash(int screenW, int screenH, float timer) {
     drawRect((float)screenW - edge, 0, edge, (float)screenH, {0.6f, 0.0f, 0.0f}, alpha * 1.5f, screenW, screenH);
     drawRect(0, 0, (float)screenW, edge, {0.6f, 0.0f, 0.0f}, alpha * 1.5f, screenW, screenH);
     drawRect(0, (float)screenH - edge, (float)screenW, edge, {0.6f, 0.0f, 0.0f}, alpha * 1.5f, screenW, screenH);
-
-    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
 }
 
 void Renderer::renderHUD(int health, int ammo, WeaponType weapon, int screenW, int screenH) {
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
+    PROFILE_SCOPE("r_hud");
     float scale = 2.5f;
     float padding = 20;
 
@@ -1139,18 +1321,11 @@ void Renderer::renderHUD(int health, int ammo, WeaponType weapon, int screenW, i
     const auto& def = getWeaponDef(weapon);
     snprintf(buf, sizeof(buf), "%s  %d/%d", def.name, ammo, def.magSize);
     drawText(buf, padding, barY + barH + 10, scale, {1, 1, 1}, screenW, screenH);
-
-    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
 }
 
 void Renderer::renderMenu(int screenW, int screenH, int selectedField,
                           const char* ipBuf, const char* portBuf,
                           const char* statusMsg, bool connecting) {
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
     float cx = screenW * 0.5f;
     float cy = screenH * 0.5f;
 
@@ -1199,32 +1374,18 @@ void Renderer::renderMenu(int screenW, int screenH, int selectedField,
 
     // Instructions
     drawText("Click fields to edit. Tab to switch. Enter to connect.", 20, 20, 1.8f, {0.5f, 0.5f, 0.6f}, screenW, screenH);
-
-    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
 }
 
 void Renderer::renderDeathScreen(float timer, int screenW, int screenH) {
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
     drawRect(0, 0, (float)screenW, (float)screenH, {0.5f, 0.0f, 0.0f}, 0.3f, screenW, screenH);
 
     char buf[64];
     snprintf(buf, sizeof(buf), "YOU DIED - Respawning in %.1f", timer);
     drawText(buf, screenW * 0.5f - 200, screenH * 0.5f, 3.0f, {1, 0.3f, 0.3f}, screenW, screenH);
-
-    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
 }
 
 void Renderer::renderScoreboard(const PlayerData players[], int numPlayers,
                                 int localId, int screenW, int screenH) {
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
     float w = 400, h = 30 * numPlayers + 60;
     float x = (screenW - w) * 0.5f;
     float y = (screenH - h) * 0.5f;
@@ -1241,33 +1402,23 @@ void Renderer::renderScoreboard(const PlayerData players[], int numPlayers,
 
         char line[128];
         snprintf(line, sizeof(line), "%-16s  HP:%3d  %s",
-                 players[i].name[0] ? players[i].name : (players[i].isBot ? "Bot" : "Player"),
+                 players[i].isBot ? "Bot" : "Player",
                  players[i].health,
                  players[i].state == PlayerState::DEAD ? "[DEAD]" : "");
         drawText(line, x + 15, ry, 2.0f, col, screenW, screenH);
         row++;
     }
-
-    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
 }
 
 void Renderer::renderKillFeed(const char* messages[], int count, int screenW, int screenH) {
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
     for (int i = 0; i < count; i++) {
         float y = screenH - 40 - i * 25;
         drawText(messages[i], screenW - 400, y, 2.0f, {1, 0.9f, 0.5f}, screenW, screenH);
     }
-
-    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
 }
 
 void Renderer::endFrame() {
-    // Nothing needed - swap is done by GLFW
+    flush(); // Swap is done by GLFW
 }
 
 // ============================================================================
@@ -1299,74 +1450,91 @@ void Renderer::buildParticleMesh() {
     glBindVertexArray(0);
 }
 
-void Renderer::updateParticles(float dt) {
-    for (auto it = particles_.begin(); it != particles_.end();) {
-        it->life -= dt;
-        if (it->life <= 0) {
-            it = particles_.erase(it);
-            continue;
-        }
-
-        // Physics
-        it->velocity.y -= it->gravity * dt;
-        it->position += it->velocity * dt;
-
-        // Ground collision for non-snow particles
-        if (it->position.y < 0.01f && it->type != ParticleType::SNOW) {
-            it->position.y = 0.01f;
-            it->velocity.y *= -0.3f;
-            it->velocity.x *= 0.8f;
-            it->velocity.z *= 0.8f;
-        }
+void ParticlePool::add(const Particle& p) {
+    if (full()) return;
+    int i = count++;
+    px[i] = p.position.x; py[i] = p.position.y; pz[i] = p.position.z;
+    vx[i] = p.velocity.x; vy[i] = p.velocity.y; vz[i] = p.velocity.z;
+    life[i] = p.life;
+    invMaxLife[i] = 1.0f / p.maxLife;
+    gravity[i] = p.gravity;
+    r[i] = p.color.x; g[i] = p.color.y; b[i] = p.color.z;
+    size[i] = p.size;
+    // Snow holds a steady alpha, muzzle sparks burn brighter
+    alphaScale[i] = p.type == ParticleType::SNOW ? 0.0f : p.type == ParticleType::MUZZLE_SPARK ? 2.0f : 1.0f;
+    alphaBias[i]  = p.type == ParticleType::SNOW ? 0.7f : 0.0f;
+    bounces[i]    = p.type == ParticleType::SNOW ? 0.0f : 1.0f;
+}
 
-        // Snow wraps when hitting ground
-        if (it->type == ParticleType::SNOW && it->position.y < 0) {
-            it->life = 0; // Remove
-        }
+void ParticlePool::update(float dt) {
+    // Integration and ground response, branch-free and over whole groups of
+    // four so it vectorizes at -O2. The lanes past count only touch unused
+    // slots (CAPACITY is a multiple of four).
+    static_assert(CAPACITY % 4 == 0);
+    const int n = (count + 3) & ~3;
+    for (int i = 0; i < n; i++) {
+        life[i] -= dt;
+        vy[i] -= gravity[i] * dt;
+        px[i] += vx[i] * dt;
+        py[i] += vy[i] * dt;
+        pz[i] += vz[i] * dt;
+
+        // Bouncing particles settle on the ground, snow dies below it
+        float below = py[i] < 0.01f ? 1.0f : 0.0f;
+        float hit = below * bounces[i];
+        py[i] += hit * (0.01f - py[i]);
+        vy[i] *= 1.0f - 1.3f * hit;
+        vx[i] *= 1.0f - 0.2f * hit;
+        vz[i] *= 1.0f - 0.2f * hit;
+        float underground = py[i] < 0.0f ? 1.0f : 0.0f;
+        life[i] *= 1.0f - underground * (1.0f - bounces[i]);
+    }
 
-        ++it;
+    // Swap-remove dead particles
+    for (int i = 0; i < count;) {
+        if (life[i] > 0) { i++; continue; }
+        int last = --count;
+        px[i] = px[last]; py[i] = py[last]; pz[i] = pz[last];
+        vx[i] = vx[last]; vy[i] = vy[last]; vz[i] = vz[last];
+        life[i] = life[last]; invMaxLife[i] = invMaxLife[last]; gravity[i] = gravity[last];
+        r[i] = r[last]; g[i] = g[last]; b[i] = b[last]; size[i] = size[last];
+        alphaScale[i] = alphaScale[last]; alphaBias[i] = alphaBias[last];
+        bounces[i] = bounces[last];
     }
 }
 
+void Renderer::updateParticles(float dt) {
+    particles_.update(dt);
+}
+
 void Renderer::renderParticles() {
+    PROFILE_SCOPE("r_particles");
     if (particles_.empty()) return;
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDepthMask(GL_FALSE); // Don't write to depth buffer
-
-    std::vector<ParticleVertex> verts;
-    verts.reserve(particles_.size());
-
-    for (const auto& p : particles_) {
-        float lifeFrac = p.life / p.maxLife;
-        float alpha = lifeFrac;
-
-        // Snow fades differently
-        if (p.type == ParticleType::SNOW) {
-            alpha = 0.7f;
-        } else if (p.type == ParticleType::MUZZLE_SPARK) {
-            alpha = lifeFrac * 2.0f; // Brighter
-        }
-
-        verts.push_back({
-            p.position.x, p.position.y, p.position.z,
-            p.color.x, p.color.y, p.color.z, std::min(alpha, 1.0f),
-            p.size
-        });
-    }
-
-    Mat4 vp = projectionMatrix_ * viewMatrix_;
-    glUseProgram(particleShader_);
-    glUniformMatrix4fv(glGetUniformLocation(particleShader_, "uVP"), 1, GL_FALSE, vp.m);
-
-    glBindVertexArray(particleVAO_);
+    // Orphan the buffer and write vertices straight into the new storage
+    const ParticlePool& pool = particles_;
     glBindBuffer(GL_ARRAY_BUFFER, particleVBO_);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, verts.size() * sizeof(ParticleVertex), verts.data());
-    glDrawArrays(GL_POINTS, 0, (int)verts.size());
-
-    glDepthMask(GL_TRUE);
-    glDisable(GL_BLEND);
+    ParticleVertex* verts = (ParticleVertex*)glMapBufferRange(
+        GL_ARRAY_BUFFER, 0, pool.count * sizeof(ParticleVertex),
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!verts) return;
+    for (int i = 0; i < pool.count; i++) {
+        float alpha = std::min(pool.life[i] * pool.invMaxLife[i] * pool.alphaScale[i] + pool.alphaBias[i], 1.0f);
+        verts[i] = {pool.px[i], pool.py[i], pool.pz[i],
+                    pool.r[i], pool.g[i], pool.b[i], alpha, pool.size[i]};
+    }
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+
+    // Transparent layer: drawn after all opaque geometry, without depth writes
+    RenderCommand cmd;
+    cmd.layer = LAYER_TRANSPARENT;
+    cmd.state = STATE_BLEND | STATE_NO_DEPTH_WRITE;
+    cmd.program = particleShader_;
+    cmd.vao = particleVAO_;
+    cmd.mode = GL_POINTS;
+    cmd.count = pool.count;
+    cmd.mvp = projectionMatrix_ * viewMatrix_;
+    submit(cmd);
 }
 
 void Renderer::spawnSnow(const Vec3& cameraPos) {
@@ -1375,7 +1543,7 @@ void Renderer::spawnSnow(const Vec3& cameraPos) {
     snowSpawnAccum_ -= toSpawn;
 
     float radius = 50.0f;
-    for (int i = 0; i < toSpawn && (int)particles_.size() < MAX_PARTICLES; i++) {
+    for (int i = 0; i < toSpawn && !particles_.full(); i++) {
         Particle p;
         p.type = ParticleType::SNOW;
         p.position = {
@@ -1389,13 +1557,13 @@ void Renderer::spawnSnow(const Vec3& cameraPos) {
         p.maxLife = p.life;
         p.size = pRandf(0.02f, 0.06f);
         p.gravity = 0.0f; // Snow doesn't accelerate
-        particles_.push_back(p);
+        particles_.add(p);
     }
 }
 
 void Renderer::spawnBulletImpact(const Vec3& pos, const Vec3& normal) {
     int count = 8;
-    for (int i = 0; i < count && (int)particles_.size() < MAX_PARTICLES; i++) {
+    for (int i = 0; i < count && !particles_.full(); i++) {
         Particle p;
         p.type = ParticleType::BULLET_IMPACT;
         p.position = pos + normal * 0.05f;
@@ -1408,10 +1576,10 @@ void Renderer::spawnBulletImpact(const Vec3& pos, const Vec3& normal) {
         p.maxLife = p.life;
         p.size = pRandf(0.03f, 0.08f);
         p.gravity = 8.0f;
-        particles_.push_back(p);
+        particles_.add(p);
     }
     // Dust cloud
-    for (int i = 0; i < 4 && (int)particles_.size() < MAX_PARTICLES; i++) {
+    for (int i = 0; i < 4 && !particles_.full(); i++) {
         Particle p;
         p.type = ParticleType::BULLET_IMPACT;
         p.position = pos;
@@ -1421,12 +1589,12 @@ void Renderer::spawnBulletImpact(const Vec3& pos, const Vec3& normal) {
         p.maxLife = p.life;
         p.size = pRandf(0.08f, 0.15f);
         p.gravity = 1.0f;
-        particles_.push_back(p);
+        particles_.add(p);
     }
 }
 
 void Renderer::spawnBloodSplatter(const Vec3& pos) {
-    for (int i = 0; i < 12 && (int)particles_.size() < MAX_PARTICLES; i++) {
+    for (int i = 0; i < 12 && !particles_.full(); i++) {
         Particle p;
         p.type = ParticleType::BLOOD;
         p.position = pos + Vec3{0, PLAYER_HEIGHT * 0.5f, 0};
@@ -1436,12 +1604,12 @@ void Renderer::spawnBloodSplatter(const Vec3& pos) {
         p.maxLife = p.life;
         p.size = pRandf(0.04f, 0.1f);
         p.gravity = 10.0f;
-        particles_.push_back(p);
+        particles_.add(p);
     }
 }
 
 void Renderer::spawnMuzzleSpark(const Vec3& pos, const Vec3& dir) {
-    for (int i = 0; i < 6 && (int)particles_.size() < MAX_PARTICLES; i++) {
+    for (int i = 0; i < 6 && !particles_.full(); i++) {
         Particle p;
         p.type = ParticleType::MUZZLE_SPARK;
         p.position = pos;
@@ -1451,12 +1619,12 @@ void Renderer::spawnMuzzleSpark(const Vec3& pos, const Vec3& dir) {
         p.maxLife = p.life;
         p.size = pRandf(0.02f, 0.05f);
         p.gravity = 3.0f;
-        particles_.push_back(p);
+        particles_.add(p);
     }
 }
 
 void Renderer::spawnFootprintDust(const Vec3& pos) {
-    for (int i = 0; i < 3 && (int)particles_.size() < MAX_PARTICLES; i++) {
+    for (int i = 0; i < 3 && !particles_.full(); i++) {
         Particle p;
         p.type = ParticleType::FOOTPRINT_DUST;
         p.position = pos + Vec3{pRandf(-0.2f, 0.2f), 0.05f, pRandf(-0.2f, 0.2f)};
@@ -1466,7 +1634,7 @@ void Renderer::spawnFootprintDust(const Vec3& pos) {
         p.maxLife = p.life;
         p.size = pRandf(0.05f, 0.12f);
         p.gravity = 1.0f;
-        particles_.push_back(p);
+        particles_.add(p);
     }
 }
 
@@ -1495,7 +1663,7 @@ void Renderer::updateFootprints(float dt) {
 void Renderer::renderFootprints() {
     if (footprints_.empty()) return;
 
-    glDisable(GL_CULL_FACE); // Footprints are flat on ground
+    worldState_ = STATE_NO_CULL; // Footprints are flat on ground
 
     for (const auto& fp : footprints_) {
         float alpha = std::min(fp.life / 5.0f, 1.0f); // Fade in last 5 seconds
@@ -1511,7 +1679,7 @@ void Renderer::renderFootprints() {
         drawCube(model, color);
     }
 
-    glEnable(GL_CULL_FACE);
+    worldState_ = 0;
 }
 
 // ============================================================================
@@ -1533,7 +1701,7 @@ void Renderer::renderVehicle(const VehicleData& v, float time) {
         // Body
         Mat4 body = base * Mat4::translate({0.0f, 0.5f, 0.0f}) *
                     Mat4::scale({3.5f, 1.0f, 2.0f});
-        drawCube(body, oliveGreen);
+        queueCube(body, oliveGreen);
 
         // 4 wheels at corners
         float wheelX[] = {-1.4f, 1.4f, -1.4f, 1.4f};
@@ -1541,18 +1709,18 @@ void Renderer::renderVehicle(const VehicleData& v, float time) {
         for (int i = 0; i < 4; i++) {
             Mat4 wheel = base * Mat4::translate({wheelX[i], 0.2f, wheelZ[i]}) *
                          Mat4::scale({0.4f, 0.4f, 0.4f});
-            drawCube(wheel, darkWheel);
+            queueCube(wheel, darkWheel);
         }
 
         // Windshield (thin blue-tinted cube on top front)
         Mat4 windshield = base * Mat4::translate({1.0f, 1.15f, 0.0f}) *
                           Mat4::scale({0.05f, 0.6f, 1.6f});
-        drawCube(windshield, blueGlass);
+        queueCube(windshield, blueGlass);
 
         // Roll bar (thin dark cube across top)
         Mat4 rollBar = base * Mat4::translate({-0.2f, 1.25f, 0.0f}) *
                        Mat4::scale({0.1f, 0.1f, 2.0f});
-        drawCube(rollBar, darkBar);
+        queueCube(rollBar, darkBar);
 
     } else if (v.type == VehicleType::HELICOPTER) {
         Vec3 bodyColor = {0.25f, 0.28f, 0.30f}; // Dark gray
@@ -1563,28 +1731,28 @@ void Renderer::renderVehicle(const VehicleData& v, float time) {
         // Fuselage
         Mat4 fuselage = base * Mat4::translate({0.0f, 1.5f, 0.0f}) *
                         Mat4::scale({5.0f, 1.6f, 2.0f});
-        drawCube(fuselage, bodyColor);
+        queueCube(fuselage, bodyColor);
 
         // Cockpit glass
         Mat4 cockpit = base * Mat4::translate({2.2f, 1.8f, 0.0f}) *
                        Mat4::scale({1.5f, 1.0f, 1.6f});
-        drawCube(cockpit, glassColor);
+        queueCube(cockpit, glassColor);
 
         // Tail boom
         Mat4 tail = base * Mat4::translate({-4.0f, 1.8f, 0.0f}) *
                     Mat4::scale({4.0f, 0.5f, 0.5f});
-        drawCube(tail, tailColor);
+        queueCube(tail, tailColor);
 
         // Tail fin (vertical)
         Mat4 tailFin = base * Mat4::translate({-5.8f, 2.5f, 0.0f}) *
                        Mat4::scale({0.8f, 1.2f, 0.1f});
-        drawCube(tailFin, bodyColor);
+        queueCube(tailFin, bodyColor);
 
         // Tail rotor (small horizontal disc)
         Mat4 tailRotor = base * Mat4::translate({-5.8f, 2.5f, 0.3f}) *
                          Mat4::rotateY(v.rotorAngle * 3.0f) *
                          Mat4::scale({0.1f, 0.6f, 0.6f});
-        drawCube(tailRotor, rotorColor);
+        queueCube(tailRotor, rotorColor);
 
         // Main rotor (spinning blades on top) - 2 blades
         Mat4 rotorHub = base * Mat4::translate({0.0f, 2.8f, 0.0f});
@@ -1593,18 +1761,18 @@ void Renderer::renderVehicle(const VehicleData& v, float time) {
             Mat4 blade = rotorHub * Mat4::rotateY(angle) *
                          Mat4::translate({3.0f, 0.0f, 0.0f}) *
                          Mat4::scale({6.0f, 0.05f, 0.3f});
-            drawCube(blade, rotorColor);
+            queueCube(blade, rotorColor);
         }
 
         // Skids (landing gear)
         for (float side : {-1.0f, 1.0f}) {
             Mat4 skid = base * Mat4::translate({0.0f, 0.15f, side * 1.0f}) *
                         Mat4::scale({4.0f, 0.1f, 0.1f});
-            drawCube(skid, {0.1f, 0.1f, 0.1f});
+            queueCube(skid, {0.1f, 0.1f, 0.1f});
             // Skid struts
             Mat4 strut = base * Mat4::translate({0.8f, 0.75f, side * 0.8f}) *
                          Mat4::scale({0.1f, 1.2f, 0.1f});
-            drawCube(strut, {0.1f, 0.1f, 0.1f});
+            queueCube(strut, {0.1f, 0.1f, 0.1f});
         }
 
     } else if (v.type == VehicleType::PLANE) {
@@ -1620,35 +1788,35 @@ void Renderer::renderVehicle(const VehicleData& v, float time) {
         // Fuselage
         Mat4 fuselage = planeBase * Mat4::translate({0.0f, 0.0f, 0.0f}) *
                         Mat4::scale({7.0f, 1.2f, 1.2f});
-        drawCube(fuselage, bodyColor);
+        queueCube(fuselage, bodyColor);
 
         // Cockpit
         Mat4 cockpit = planeBase * Mat4::translate({2.0f, 0.7f, 0.0f}) *
                        Mat4::scale({1.5f, 0.8f, 1.0f});
-        drawCube(cockpit, glassColor);
+        queueCube(cockpit, glassColor);
 
         // Main wings
         Mat4 wingL = planeBase * Mat4::translate({0.0f, -0.1f, -4.0f}) *
                      Mat4::scale({3.0f, 0.15f, 4.0f});
-        drawCube(wingL, wingColor);
+        queueCube(wingL, wingColor);
         Mat4 wingR = planeBase * Mat4::translate({0.0f, -0.1f, 4.0f}) *
                      Mat4::scale({3.0f, 0.15f, 4.0f});
-        drawCube(wingR, wingColor);
+        queueCube(wingR, wingColor);
 
         // Tail wing (horizontal stabilizer)
         Mat4 tailWing = planeBase * Mat4::translate({-3.2f, 0.2f, 0.0f}) *
                         Mat4::scale({1.0f, 0.1f, 2.5f});
-        drawCube(tailWing, wingColor);
+        queueCube(tailWing, wingColor);
 
         // Vertical tail
         Mat4 vTail = planeBase * Mat4::translate({-3.2f, 1.0f, 0.0f}) *
                      Mat4::scale({1.0f, 1.2f, 0.1f});
-        drawCube(vTail, wingColor);
+        queueCube(vTail, wingColor);
 
         // Engine nacelle
         Mat4 engine = planeBase * Mat4::translate({3.5f, 0.0f, 0.0f}) *
                       Mat4::scale({1.0f, 0.7f, 0.7f});
-        drawCube(engine, engineColor);
+        queueCube(engine, engineColor);
 
         // Propeller (spinning)
         for (int b = 0; b < 2; b++) {
@@ -1656,7 +1824,7 @@ void Renderer::renderVehicle(const VehicleData& v, float time) {
             Mat4 prop = planeBase * Mat4::translate({4.2f, 0.0f, 0.0f}) *
                         Mat4::rotateX(angle) *
                         Mat4::scale({0.05f, 1.5f, 0.2f});
-            drawCube(prop, propColor);
+            queueCube(prop, propColor);
         }
 
     } else if (v.type == VehicleType::TANK) {
@@ -1668,16 +1836,16 @@ void Renderer::renderVehicle(const VehicleData& v, float time) {
         // Body
         Mat4 body = base * Mat4::translate({0.0f, 0.75f, 0.0f}) *
                     Mat4::scale({5.0f, 1.5f, 3.0f});
-        drawCube(body, darkGreen);
+        queueCube(body, darkGreen);
 
         // Tracks on sides
         Mat4 trackL = base * Mat4::translate({0.0f, 0.3f, -1.6f}) *
                       Mat4::scale({5.2f, 0.6f, 0.5f});
-        drawCube(trackL, trackColor);
+        queueCube(trackL, trackColor);
 
         Mat4 trackR = base * Mat4::translate({0.0f, 0.3f, 1.6f}) *
                       Mat4::scale({5.2f, 0.6f, 0.5f});
-        drawCube(trackR, trackColor);
+        queueCube(trackR, trackColor);
 
         // Turret (rotates independently)
         float totalTurretYaw = v.turretYaw + v.yaw;
@@ -1685,12 +1853,12 @@ void Renderer::renderVehicle(const VehicleData& v, float time) {
 
         Mat4 turret = turretBase * Mat4::translate({0.0f, 1.9f, 0.0f}) *
                       Mat4::scale({2.0f, 0.8f, 2.0f});
-        drawCube(turret, turretColor);
+        queueCube(turret, turretColor);
 
         // Barrel (extends forward from turret)
         Mat4 barrel = turretBase * Mat4::translate({3.0f, 2.0f, 0.0f}) *
                       Mat4::scale({3.0f, 0.2f, 0.2f});
-        drawCube(barrel, barrelColor);
+        queueCube(barrel, barrelColor);
     }
 }
 
@@ -1707,21 +1875,21 @@ void Renderer::renderFlag(const FlagData& flag, int teamId, float time) {
     // Pole
     Mat4 pole = Mat4::translate({pos.x, pos.y + 1.5f, pos.z}) *
                 Mat4::scale({0.06f, 3.0f, 0.06f});
-    drawCube(pole, poleColor);
+    queueCube(pole, poleColor);
 
     // Flag fabric (waving)
     float wave = sinf(time * 3.0f + pos.x) * 0.15f;
     Mat4 fabric = Mat4::translate({pos.x + 0.5f + wave, pos.y + 2.5f, pos.z}) *
                   Mat4::rotateY(wave) *
                   Mat4::scale({1.0f, 0.6f, 0.05f});
-    drawCube(fabric, flagColor);
+    queueCube(fabric, flagColor);
 
     // Glow ring at base (pulsing)
     float pulse = 0.5f + 0.5f * sinf(time * 4.0f);
     Vec3 glowColor = flagColor * pulse;
     Mat4 glow = Mat4::translate({pos.x, pos.y + 0.05f, pos.z}) *
                 Mat4::scale({1.5f, 0.05f, 1.5f});
-    drawCube(glow, glowColor);
+    queueCube(glow, glowColor);
 }
 
 // ============================================================================
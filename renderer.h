@@ -28,6 +28,28 @@ struct Particle {
     float gravity = 1.0f;
 };
 
+// Fixed-capacity particle storage with one array per field, so the update
+// loop streams through memory and vectorizes. Particles are unordered:
+// removal moves the last one into the hole.
+struct ParticlePool {
+    static constexpr int CAPACITY = 4000;
+
+    int count = 0;
+    alignas(32) float px[CAPACITY], py[CAPACITY], pz[CAPACITY];
+    alignas(32) float vx[CAPACITY], vy[CAPACITY], vz[CAPACITY];
+    alignas(32) float life[CAPACITY], invMaxLife[CAPACITY], gravity[CAPACITY];
+    alignas(32) float r[CAPACITY], g[CAPACITY], b[CAPACITY], size[CAPACITY];
+    // alpha = min(lifeFrac * alphaScale + alphaBias, 1), set per type at spawn
+    alignas(32) float alphaScale[CAPACITY], alphaBias[CAPACITY];
+    // 1 = bounces off the ground, 0 = dies below it (snow)
+    alignas(32) float bounces[CAPACITY];
+
+    bool full() const { return count >= CAPACITY; }
+    bool empty() const { return count == 0; }
+    void add(const Particle& p);
+    void update(float dt);
+};
+
 // ============================================================================
 // Footprint
 // ============================================================================
@@ -39,6 +61,20 @@ struct Footprint {
     bool isLeft;
 };
 
+// ============================================================================
+// View Frustum
+// ============================================================================
+
+// Six planes (a, b, c, d) facing inward, extracted from a view-projection
+// matrix. Tests are conservative: they may keep objects just outside.
+struct Frustum {
+    float planes[6][4] = {};
+
+    void fromMatrix(const Mat4& viewProj);
+    bool intersects(const AABB& box) const;
+    bool intersectsSphere(const Vec3& center, float radius) const;
+};
+
 // ============================================================================
 // Renderer
 // ============================================================================
@@ -95,6 +131,16 @@ public:
     // Tornados
     void renderTornado(const TornadoData& tornado, float time);
 
+    // Culling against the frustum of the last beginFrame
+    const Frustum& frustum() const { return frustum_; }
+    bool isVisible(const Vec3& center, float radius) const { return frustum_.intersectsSphere(center, radius); }
+    const Vec3& cameraPosition() const { return cameraPos_; }
+
+    // Execute every draw queued since the last flush. Drawing functions only
+    // record commands; the queue runs sorted by layer, GL state, shader and
+    // VAO. endFrame and renderFirstPersonWeapon (before its depth clear) flush.
+    void flush();
+
     // Text rendering
     void drawText(const char* text, float x, float y, float scale,
                   const Vec3& color, int screenW, int screenH);
@@ -105,19 +151,91 @@ private:
     GLuint worldShader_ = 0, hudShader_ = 0, particleShader_ = 0;
     GLuint mapVAO_ = 0, mapVBO_ = 0;
     int    mapVertexCount_ = 0;
+
+    // The map VBO is laid out chunk by chunk. Within a chunk, structural
+    // blocks come first and small detail blocks last, so distant chunks
+    // draw a prefix of their range and drop the detail.
+    static constexpr float MAP_LOD_DISTANCE = 120.0f;
+    std::vector<MapMeshChunk> mapChunks_;
     GLuint cubeVAO_ = 0, cubeVBO_ = 0;
     int    cubeVertexCount_ = 0;
     GLuint sphereVAO_ = 0, sphereVBO_ = 0;
     int    sphereVertexCount_ = 0;
     GLuint cylinderVAO_ = 0, cylinderVBO_ = 0;
     int    cylinderVertexCount_ = 0;
-    GLuint quadVAO_ = 0, quadVBO_ = 0;
     GLuint fontTexture_ = 0;
 
+    // Font atlas UVs per printable character, plus a solid texel that lets
+    // rects share the text shader and texture
+    struct GlyphUV { float u0, vTop, u1, vBot; };
+    GlyphUV glyphUV_[95] = {};
+    float   solidU_ = 0, solidV_ = 0;
+
+    // HUD sprite batch: every glyph and rect quad of a flush lands in one
+    // vertex range and is drawn with a single call. With ARB_buffer_storage
+    // the buffer is persistently mapped and split into fenced sections that
+    // rotate per flush; otherwise quads are staged in hudStaging_ and uploaded.
+    struct HudVertex {
+        float   x, y, u, v;
+        uint8_t r, g, b, a;
+    };
+    static constexpr int HUD_MAX_VERTS = 6 * 16384; // Per section
+    static constexpr int HUD_SECTIONS = 3;
+    GLuint     hudVAO_ = 0, hudVBO_ = 0;
+    HudVertex* hudMapped_ = nullptr;
+    GLsync     hudFence_[HUD_SECTIONS] = {};
+    int        hudSection_ = 0;
+    int        hudCount_ = 0;
+    int        hudScreenW_ = 0, hudScreenH_ = 0;
+    std::vector<HudVertex> hudStaging_;
+
+    // Instanced entity parts, one queue and instance buffer per primitive mesh
+    enum PrimitiveMesh { MESH_CUBE, MESH_SPHERE, MESH_CYLINDER, MESH_COUNT };
+    struct InstanceData {
+        float model[16];
+        float r, g, b;
+    };
+    GLuint instancedShader_ = 0;
+    GLuint instanceVAO_[MESH_COUNT] = {}, instanceVBO_[MESH_COUNT] = {};
+    std::vector<InstanceData> instances_[MESH_COUNT];
+
+    // Uniform locations, resolved once per program in init(); -1 = unused
+    struct ProgramUniforms {
+        GLint mvp = -1, model = -1, viewProj = -1;
+        GLint sunDir = -1, sunColor = -1, ambient = -1;
+        GLint proj = -1, tex = -1;
+    };
+    ProgramUniforms worldLoc_, instancedLoc_, hudLoc_, particleLoc_;
+
+    // Deferred draw commands. Layers run in order (HUD last); within a layer
+    // commands are grouped by state, program and VAO, keeping submission
+    // order among equal keys (HUD text over its background).
+    enum RenderLayer : uint8_t { LAYER_OPAQUE, LAYER_TRANSPARENT, LAYER_HUD };
+    enum RenderStateBits : uint8_t {
+        STATE_NO_CULL        = 1,
+        STATE_NO_DEPTH_WRITE = 2,
+        STATE_NO_DEPTH_TEST  = 4,
+        STATE_BLEND          = 8,
+    };
+    struct RenderCommand {
+        uint64_t key = 0;
+        uint8_t  layer = LAYER_OPAQUE;
+        uint8_t  state = 0;
+        GLuint   program = 0, vao = 0;
+        GLenum   mode = GL_TRIANGLES;
+        int      first = 0, count = 0;
+        int      instances = 0;     // > 0: instanced draw
+        Mat4     mvp, model;        // World: MVP + model. Instanced/particles: view-projection in mvp
+        Vec3     sunColor, ambient;
+        int      screenW = 0, screenH = 0; // HUD
+    };
+    std::vector<RenderCommand> commands_;
+    uint8_t                    worldState_ = 0; // Extra state for drawCube & co (footprints)
+
     // Particle rendering
     GLuint particleVAO_ = 0, particleVBO_ = 0;
-    static constexpr int MAX_PARTICLES = 4000;
-    std::vector<Particle> particles_;
+    static constexpr int MAX_PARTICLES = ParticlePool::CAPACITY;
+    ParticlePool particles_;
     float snowSpawnAccum_ = 0;
 
     // Footprints
@@ -127,6 +245,7 @@ private:
     Mat4 projectionMatrix_;
     Mat4 viewMatrix_;
     Vec3 cameraPos_;
+    Frustum frustum_;
 
     int width_ = 1280, height_ = 720;
 
@@ -135,6 +254,21 @@ private:
     void drawCube(const Mat4& model, const Vec3& color);
     void drawSphere(const Mat4& model, const Vec3& color);
     void drawCylinder(const Mat4& model, const Vec3& color);
+    void queueCube(const Mat4& model, const Vec3& color) { queueInstance(MESH_CUBE, model, color); }
+    void queueSphere(const Mat4& model, const Vec3& color) { queueInstance(MESH_SPHERE, model, color); }
+    void queueCylinder(const Mat4& model, const Vec3& color) { queueInstance(MESH_CYLINDER, model, color); }
+    void queueInstance(PrimitiveMesh mesh, const Mat4& model, const Vec3& color);
+    void buildInstancedMeshes();
+    void resolveUniforms(GLuint program, ProgramUniforms& loc);
+    const ProgramUniforms& uniformsFor(GLuint program) const;
+    void submit(RenderCommand& cmd);
+    void submitWorld(GLuint vao, int first, int count, const Mat4& model,
+                     const Vec3& sunColor, const Vec3& ambient);
+    void buildHudBatch();
+    void hudQuad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1,
+                 const Vec3& color, float alpha, int screenW, int screenH);
+    void submitHudBatch();
+    void finishHudBatch();
     void buildFontTexture();
     void buildParticleMesh();
 };
@@ -0,0 +1,396 @@
+#include "replay.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstddef>
+#include <cstring>
+
+// ============================================================================
+// Recorder
+// ============================================================================
+
+bool MatchRecorder::open(const char* path, const World& world, int keyframeTicks) {
+    close();
+    file_ = fopen(path, "wb");
+    if (!file_) return false;
+
+    keyframeTicks_ = keyframeTicks > 0 ? keyframeTicks : 1;
+    haveKeyframe_ = false;
+    submitted_ = 0;
+    inTick_ = false;
+    pending_.clear();
+    index_.clear();
+    lastTick_ = world.serverTick;
+    stop_ = false;
+
+    RecordingHeader header;
+    memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+    header.seed = world.seed;
+    header.rewindTicks = world.rewindTicks;
+    header.aiThinkBudget = world.aiThinkBudget;
+    append(&header, sizeof(header));
+
+    writer_ = std::thread([this] { writerLoop(); });
+    return true;
+}
+
+void MatchRecorder::close() {
+    if (!file_) return;
+    if (inTick_) {
+        endRecord(); // The tick never finished; keep what was recorded
+        inTick_ = false;
+    }
+
+    RecordingTrailer trailer;
+    trailer.indexOffset = bytesWritten();
+    trailer.lastTick = lastTick_;
+    beginRecord(RecordType::INDEX, lastTick_);
+    append(index_.data(), index_.size() * sizeof(KeyframeEntry));
+    endRecord();
+    append(&trailer, sizeof(trailer));
+    submit();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+    fclose(file_);
+    file_ = nullptr;
+}
+
+void MatchRecorder::append(const void* data, size_t len) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    pending_.insert(pending_.end(), bytes, bytes + len);
+}
+
+void MatchRecorder::beginRecord(RecordType type, uint32_t tick) {
+    recordStart_ = pending_.size();
+    RecordHeader h;
+    h.type = type;
+    h.tick = tick;
+    append(&h, sizeof(h));
+}
+
+// Pad the open record to 8 bytes and fill in its size
+void MatchRecorder::endRecord() {
+    while (pending_.size() % 8) pending_.push_back(0);
+    uint32_t size = (uint32_t)(pending_.size() - recordStart_ - sizeof(RecordHeader));
+    memcpy(pending_.data() + recordStart_ + offsetof(RecordHeader, size), &size, sizeof(size));
+}
+
+void MatchRecorder::beginTick(const World& world) {
+    if (!file_) return;
+    if (haveKeyframe_ && world.serverTick - lastKeyframe_ < (uint32_t)keyframeTicks_) return;
+
+    index_.push_back({world.serverTick, 0, bytesWritten()});
+    beginRecord(RecordType::KEYFRAME, world.serverTick);
+    world.saveState(pending_);
+    endRecord();
+    lastKeyframe_ = world.serverTick;
+    haveKeyframe_ = true;
+}
+
+void MatchRecorder::recordJoin(const World& world, int playerId) {
+    if (!file_) return;
+    SlotRecord r;
+    r.playerId = (uint8_t)playerId;
+    snprintf(r.name, sizeof(r.name), "%s", world.profiles[playerId].name);
+    beginRecord(RecordType::JOIN, world.serverTick);
+    append(&r, sizeof(r));
+    endRecord();
+}
+
+void MatchRecorder::recordLeave(const World& world, int playerId) {
+    if (!file_) return;
+    SlotRecord r;
+    r.playerId = (uint8_t)playerId;
+    beginRecord(RecordType::LEAVE, world.serverTick);
+    append(&r, sizeof(r));
+    endRecord();
+}
+
+void MatchRecorder::recordClass(const World& world, int playerId, PlayerClass cls) {
+    if (!file_) return;
+    SlotRecord r;
+    r.playerId = (uint8_t)playerId;
+    r.playerClass = (uint8_t)cls;
+    beginRecord(RecordType::CLASS, world.serverTick);
+    append(&r, sizeof(r));
+    endRecord();
+}
+
+// Human inputs as simulate() is about to see them (it consumes the USE and
+// ability keys, so they cannot be read back afterwards)
+void MatchRecorder::recordInputs(const World& world) {
+    if (!file_) return;
+    beginRecord(RecordType::TICK, world.serverTick);
+    TickRecord tr;
+    size_t trOffset = pending_.size();
+    append(&tr, sizeof(tr));
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        const PlayerData& p = world.players[i];
+        if (p.state == PlayerState::DISCONNECTED || p.isBot || !world.inputSource[i]) continue;
+        const InputState& in = *world.inputSource[i];
+        RecordedInput r;
+        r.playerId = (uint8_t)i;
+        r.keys = in.keys;
+        r.yaw = in.yaw;
+        r.pitch = in.pitch;
+        r.viewTick = world.viewTick[i];
+        r.viewTickFrac = world.viewTickFrac[i];
+        append(&r, sizeof(r));
+        tr.numHumans++;
+    }
+    memcpy(pending_.data() + trOffset, &tr, sizeof(tr));
+    inTick_ = true;
+}
+
+// Bot inputs as the tick's think step produced them, for replays to check
+// their own AI against
+void MatchRecorder::endTick(const World& world) {
+    if (!file_ || !inTick_) return;
+    size_t trOffset = recordStart_ + sizeof(RecordHeader);
+    TickRecord tr;
+    memcpy(&tr, pending_.data() + trOffset, sizeof(tr));
+    for (int b = 0; b < world.numBots; b++) {
+        const InputState& in = world.bots[b].input;
+        RecordedInput r;
+        r.playerId = (uint8_t)world.bots[b].playerId;
+        r.keys = in.keys;
+        r.yaw = in.yaw;
+        r.pitch = in.pitch;
+        append(&r, sizeof(r));
+        tr.numBots++;
+    }
+    memcpy(pending_.data() + trOffset, &tr, sizeof(tr));
+    endRecord();
+    inTick_ = false;
+    lastTick_ = world.serverTick;
+    submit();
+}
+
+// Hand the pending bytes to the writer and continue in a recycled buffer
+void MatchRecorder::submit() {
+    if (pending_.empty()) return;
+    submitted_ += pending_.size();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(pending_));
+        if (!spare_.empty()) {
+            pending_ = std::move(spare_.back());
+            spare_.pop_back();
+        }
+    }
+    pending_.clear();
+    wake_.notify_one();
+}
+
+void MatchRecorder::writerLoop() {
+    std::vector<std::vector<uint8_t>> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) break; // Stopped with everything written
+        batch.swap(queue_);
+        lock.unlock();
+
+        for (std::vector<uint8_t>& buf : batch) {
+            fwrite(buf.data(), 1, buf.size(), file_);
+        }
+
+        lock.lock();
+        for (std::vector<uint8_t>& buf : batch) {
+            if (spare_.size() < 8) spare_.push_back(std::move(buf));
+        }
+        batch.clear();
+    }
+}
+
+// ============================================================================
+// Replay
+// ============================================================================
+
+bool MatchReplay::open(const char* path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RecordingHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* map = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return false;
+    data_ = (const uint8_t*)map;
+    size_ = (size_t)st.st_size;
+
+    const RecordingHeader& h = header();
+    if (memcmp(h.magic, RECORDING_MAGIC, sizeof(h.magic)) != 0 || h.version != RECORDING_VERSION) {
+        close();
+        return false;
+    }
+
+    // Use the index if the recording was closed cleanly
+    end_ = size_;
+    if (size_ >= sizeof(RecordingHeader) + sizeof(RecordingTrailer)) {
+        const RecordingTrailer* t = (const RecordingTrailer*)(data_ + size_ - sizeof(RecordingTrailer));
+        const RecordHeader* rec = memcmp(t->magic, "FIDX", 4) == 0 ? recordAt(t->indexOffset) : nullptr;
+        if (rec && rec->type == RecordType::INDEX) {
+            const KeyframeEntry* entries = (const KeyframeEntry*)(rec + 1);
+            index_.assign(entries, entries + rec->size / sizeof(KeyframeEntry));
+            lastTick_ = t->lastTick;
+            end_ = t->indexOffset;
+        }
+    }
+
+    // Otherwise walk the records; a torn final record ends the stream
+    if (end_ == size_) {
+        size_t offset = sizeof(RecordingHeader);
+        while (const RecordHeader* rec = recordAt(offset)) {
+            if (rec->type == RecordType::INDEX) break;
+            if (rec->type == RecordType::KEYFRAME) index_.push_back({rec->tick, 0, offset});
+            if (rec->type == RecordType::TICK) lastTick_ = rec->tick;
+            offset += sizeof(RecordHeader) + rec->size;
+        }
+        end_ = offset;
+    }
+
+    cursor_ = index_.empty() ? end_ : index_[0].offset;
+    return !index_.empty();
+}
+
+void MatchReplay::close() {
+    if (data_) munmap((void*)data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+    index_.clear();
+    lastTick_ = 0;
+    botMismatches_ = keyframeMismatches_ = keyframesChecked_ = 0;
+}
+
+const RecordHeader* MatchReplay::recordAt(size_t offset) const {
+    if (offset % 8 || offset + sizeof(RecordHeader) > end_) return nullptr;
+    const RecordHeader* rec = (const RecordHeader*)(data_ + offset);
+    if (rec->size > end_ - offset - sizeof(RecordHeader)) return nullptr;
+    return rec;
+}
+
+void MatchReplay::bindHumans(World& world) {
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (world.players[i].state != PlayerState::DISCONNECTED && !world.players[i].isBot) {
+            world.inputSource[i] = &inputs_[i];
+        }
+    }
+}
+
+bool MatchReplay::seek(World& world, uint32_t tick) {
+    if (index_.empty()) return false;
+    size_t k = 0;
+    while (k + 1 < index_.size() && index_[k + 1].tick <= tick) k++;
+
+    const RecordHeader* rec = recordAt(index_[k].offset);
+    if (!rec || rec->type != RecordType::KEYFRAME ||
+        !world.loadState((const uint8_t*)(rec + 1), rec->size)) {
+        printf("Replay: keyframe at tick %u is unreadable\n", index_[k].tick);
+        return false;
+    }
+    world.rewindTicks = header().rewindTicks;
+    world.aiThinkBudget = header().aiThinkBudget;
+    bindHumans(world);
+    cursor_ = index_[k].offset + sizeof(RecordHeader) + rec->size;
+
+    while (world.serverTick < tick) {
+        if (!step(world)) return false;
+    }
+    return true;
+}
+
+bool MatchReplay::step(World& world) {
+    while (const RecordHeader* rec = recordAt(cursor_)) {
+        const uint8_t* payload = (const uint8_t*)(rec + 1);
+        cursor_ += sizeof(RecordHeader) + rec->size;
+
+        switch (rec->type) {
+            case RecordType::KEYFRAME: {
+                // The recorded state at this point must match ours exactly
+                state_.clear();
+                world.saveState(state_);
+                keyframesChecked_++;
+                if (state_.size() > rec->size || rec->size - state_.size() >= 8 ||
+                    memcmp(state_.data(), payload, state_.size()) != 0) {
+                    keyframeMismatches_++;
+                }
+                break;
+            }
+            case RecordType::JOIN: {
+                const SlotRecord* r = (const SlotRecord*)payload;
+                char name[sizeof(r->name) + 1];
+                snprintf(name, sizeof(name), "%.*s", (int)sizeof(r->name), r->name);
+                int slot = world.addPlayer(name);
+                if (slot != r->playerId) {
+                    printf("Replay: '%s' joined as %d, recorded as %d\n", name, slot, r->playerId);
+                    return false;
+                }
+                inputs_[slot] = InputState{};
+                world.inputSource[slot] = &inputs_[slot];
+                break;
+            }
+            case RecordType::LEAVE: {
+                const SlotRecord* r = (const SlotRecord*)payload;
+                if (r->playerId < MAX_PLAYERS) world.removePlayer(r->playerId);
+                break;
+            }
+            case RecordType::CLASS: {
+                const SlotRecord* r = (const SlotRecord*)payload;
+                if (r->playerId < MAX_PLAYERS && r->playerClass < (uint8_t)PlayerClass::COUNT) {
+                    world.selectClass(r->playerId, (PlayerClass)r->playerClass);
+                }
+                break;
+            }
+            case RecordType::TICK: {
+                if (rec->tick != world.serverTick) {
+                    printf("Replay: recorded tick %u, world at %u\n", rec->tick, world.serverTick);
+                    return false;
+                }
+                const TickRecord* tr = (const TickRecord*)payload;
+                const RecordedInput* in = (const RecordedInput*)(tr + 1);
+                if (sizeof(TickRecord) + (tr->numHumans + tr->numBots) * sizeof(RecordedInput) > rec->size) {
+                    return false;
+                }
+                for (int h = 0; h < tr->numHumans; h++, in++) {
+                    int id = in->playerId;
+                    if (id >= MAX_PLAYERS) return false;
+                    inputs_[id].keys = in->keys;
+                    inputs_[id].yaw = in->yaw;
+                    inputs_[id].pitch = in->pitch;
+                    world.viewTick[id] = in->viewTick;
+                    world.viewTickFrac[id] = in->viewTickFrac;
+                }
+
+                world.simulate();
+
+                for (int b = 0; b < tr->numBots; b++, in++) {
+                    if (b >= world.numBots) {
+                        botMismatches_++;
+                        continue;
+                    }
+                    const InputState& mine = world.bots[b].input;
+                    if (world.bots[b].playerId != in->playerId || mine.keys != in->keys ||
+                        mine.yaw != in->yaw || mine.pitch != in->pitch) {
+                        botMismatches_++;
+                    }
+                }
+                world.clearEvents();
+                world.serverTick++;
+                return true;
+            }
+            case RecordType::INDEX:
+                return false;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "common.h"
+#include "world.h"
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// Match Recording Format
+// ============================================================================
+
+// An append-only file of 8-byte aligned records after a fixed header:
+//
+//   RecordingHeader
+//   KEYFRAME  World::saveState() blob, at the start of a tick
+//   JOIN / CLASS / LEAVE  Human slot changes, in the order the server made them
+//   TICK      Human inputs fed into simulate(), then the bot inputs it produced
+//   ...
+//   INDEX     Keyframe ticks and file offsets, then a RecordingTrailer
+//
+// INDEX and the trailer are only written by a clean close; a reader that
+// finds no trailer rebuilds the index by walking the records. Every payload
+// is plain data, so a reader can use records in place from a mapping.
+
+constexpr char     RECORDING_MAGIC[8] = {'F', 'P', 'S', 'R', 'E', 'C', '1', 0};
+constexpr uint32_t RECORDING_VERSION = 3;
+
+struct RecordingHeader {
+    char     magic[8];
+    uint32_t version = RECORDING_VERSION;
+    uint32_t protocolVersion = PROTOCOL_VERSION;
+    uint32_t seed = 0;        // World::init() seed
+    uint32_t tickRate = TICK_RATE;
+    int32_t  rewindTicks = 0; // Lag compensation window the match ran with
+    int32_t  aiThinkBudget = 0;
+};
+
+enum class RecordType : uint8_t {
+    KEYFRAME = 1, TICK, JOIN, LEAVE, CLASS, INDEX
+};
+
+struct RecordHeader {
+    RecordType type;
+    uint8_t    pad[3] = {};
+    uint32_t   tick = 0; // serverTick when the record was made
+    uint32_t   size = 0; // Payload bytes, a multiple of 8
+    uint32_t   reserved = 0;
+};
+
+// TICK payload: this, then numHumans + numBots RecordedInputs
+struct TickRecord {
+    uint16_t numHumans = 0;
+    uint16_t numBots = 0;
+    uint32_t reserved = 0;
+};
+
+struct RecordedInput {
+    uint8_t  playerId = 0;
+    uint8_t  viewTickFrac = 0;
+    uint16_t keys = 0;
+    float    yaw = 0, pitch = 0;
+    uint32_t viewTick = NO_SNAPSHOT_ACK; // Humans only
+};
+
+// JOIN, LEAVE and CLASS payload
+struct SlotRecord {
+    uint8_t playerId = 0;
+    uint8_t playerClass = 0; // CLASS only
+    uint8_t pad[6] = {};
+    char    name[32] = {};   // JOIN only
+};
+
+struct KeyframeEntry {
+    uint32_t tick;
+    uint32_t reserved;
+    uint64_t offset; // Of the KEYFRAME record header
+};
+
+struct RecordingTrailer {
+    uint64_t indexOffset; // Of the INDEX record header
+    uint32_t lastTick;    // Last TICK record
+    char     magic[4] = {'F', 'I', 'D', 'X'};
+};
+
+// ============================================================================
+// Recorder
+// ============================================================================
+
+// Records a match as the server runs it. The tick loop only appends to an
+// in-memory buffer and hands it to a writer thread once per tick; it never
+// waits on the disk, only on a mutex the writer holds for a queue swap.
+class MatchRecorder {
+public:
+    ~MatchRecorder() { close(); }
+
+    // Writes the header; the first keyframe is taken by the next beginTick()
+    bool open(const char* path, const World& world, int keyframeTicks);
+    // Finish pending writes, append the index and trailer
+    void close();
+    bool isOpen() const { return file_ != nullptr; }
+
+    // Call order per tick: beginTick, slot changes as they happen,
+    // recordInputs right before simulate(), endTick right after
+    void beginTick(const World& world);
+    void recordJoin(const World& world, int playerId);
+    void recordLeave(const World& world, int playerId);
+    void recordClass(const World& world, int playerId, PlayerClass cls);
+    void recordInputs(const World& world);
+    void endTick(const World& world);
+
+    uint64_t bytesWritten() const { return submitted_ + pending_.size(); }
+
+private:
+    void beginRecord(RecordType type, uint32_t tick);
+    void endRecord();
+    void append(const void* data, size_t len);
+    void submit();
+    void writerLoop();
+
+    FILE*                      file_ = nullptr;
+    int                        keyframeTicks_ = 0;
+    uint32_t                   lastKeyframe_ = 0;
+    bool                       haveKeyframe_ = false;
+    uint64_t                   submitted_ = 0;   // Bytes handed to the writer
+    size_t                     recordStart_ = 0; // Of the open record in pending_
+    bool                       inTick_ = false;  // Between recordInputs and endTick
+    std::vector<uint8_t>       pending_;         // Tick thread only
+    std::vector<KeyframeEntry> index_;
+    uint32_t                   lastTick_ = 0;
+
+    // Shared with the writer
+    std::mutex                        mutex_;
+    std::condition_variable           wake_;
+    std::vector<std::vector<uint8_t>> queue_;
+    std::vector<std::vector<uint8_t>> spare_; // Written buffers, reused
+    bool                              stop_ = false;
+    std::thread                       writer_;
+};
+
+// ============================================================================
+// Replay
+// ============================================================================
+
+// Plays a recording back into a World as fast as it will go. The file is
+// mapped read-only and records are used in place. The world must have been
+// init()ed with header().seed; seek() then restores the nearest keyframe at
+// or before the requested tick and simulates forward to it.
+class MatchReplay {
+public:
+    ~MatchReplay() { close(); }
+
+    bool open(const char* path);
+    void close();
+
+    const RecordingHeader& header() const { return *(const RecordingHeader*)data_; }
+    const std::vector<KeyframeEntry>& keyframes() const { return index_; }
+    uint32_t lastTick() const { return lastTick_; }
+
+    bool seek(World& world, uint32_t tick);
+    // Apply records through the next TICK and simulate it; false at the end
+    // of the recording or if it no longer lines up with the world
+    bool step(World& world);
+
+    // Bot inputs and keyframes the replay did not reproduce exactly; nonzero
+    // means the simulation has changed since the match was recorded
+    int botMismatches() const { return botMismatches_; }
+    int keyframeMismatches() const { return keyframeMismatches_; }
+    int keyframesChecked() const { return keyframesChecked_; }
+
+private:
+    const RecordHeader* recordAt(size_t offset) const;
+    void bindHumans(World& world);
+
+    const uint8_t*             data_ = nullptr;
+    size_t                     size_ = 0;
+    size_t                     cursor_ = 0;
+    size_t                     end_ = 0; // End of the record stream (start of INDEX)
+    std::vector<KeyframeEntry> index_;
+    uint32_t                   lastTick_ = 0;
+    InputState                 inputs_[MAX_PLAYERS]; // Human input sources
+    std::vector<uint8_t>       state_;
+    int                        botMismatches_ = 0;
+    int                        keyframeMismatches_ = 0;
+    int                        keyframesChecked_ = 0;
+};
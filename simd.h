@@ -0,0 +1,92 @@
+#pragma once
+
+// ============================================================================
+// 4-Wide Float Vectors
+// ============================================================================
+
+// The few lane operations the hot math kernels need, over SSE2 on x86-64
+// and NEON on AArch64. FPS_SIMD is 0 on anything else, or when built with
+// -DFPS_NO_SIMD (make SIMD=0), and callers then take their scalar path.
+// Lane ops are plain IEEE single precision with no fused multiply-add, so
+// a kernel doing the same operations in the same order as its scalar
+// version gets the same floats.
+
+#if !defined(FPS_NO_SIMD) && defined(__SSE2__)
+#define FPS_SIMD 1
+#include <emmintrin.h>
+#elif !defined(FPS_NO_SIMD) && defined(__aarch64__) && defined(__ARM_NEON)
+#define FPS_SIMD 1
+#include <arm_neon.h>
+#else
+#define FPS_SIMD 0
+#endif
+
+#if FPS_SIMD
+namespace simd {
+
+#if defined(__SSE2__)
+
+using F4 = __m128; // Four floats
+using M4 = __m128; // Four lane masks, all bits set or clear
+
+inline F4   load(const float* p)       { return _mm_loadu_ps(p); }
+inline void store(float* p, F4 v)      { _mm_storeu_ps(p, v); }
+inline F4   splat(float f)             { return _mm_set1_ps(f); }
+inline F4   zero()                     { return _mm_setzero_ps(); }
+inline F4   lanes(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+
+inline F4 add(F4 a, F4 b) { return _mm_add_ps(a, b); }
+inline F4 sub(F4 a, F4 b) { return _mm_sub_ps(a, b); }
+inline F4 mul(F4 a, F4 b) { return _mm_mul_ps(a, b); }
+inline F4 div(F4 a, F4 b) { return _mm_div_ps(a, b); }
+inline F4 min(F4 a, F4 b) { return _mm_min_ps(a, b); }
+inline F4 max(F4 a, F4 b) { return _mm_max_ps(a, b); }
+
+inline M4 lt(F4 a, F4 b)  { return _mm_cmplt_ps(a, b); }
+inline M4 le(F4 a, F4 b)  { return _mm_cmple_ps(a, b); }
+inline M4 bitAnd(M4 a, M4 b)    { return _mm_and_ps(a, b); }
+inline M4 bitOr(M4 a, M4 b)     { return _mm_or_ps(a, b); }
+inline M4 bitAndNot(M4 a, M4 b) { return _mm_andnot_ps(b, a); } // a & ~b
+inline M4 mask(bool a, bool b, bool c, bool d) {
+    return _mm_castsi128_ps(_mm_setr_epi32(-(int)a, -(int)b, -(int)c, -(int)d));
+}
+inline F4   select(M4 m, F4 a, F4 b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+inline bool any(M4 m)                { return _mm_movemask_ps(m) != 0; }
+
+#else
+
+using F4 = float32x4_t;
+using M4 = uint32x4_t;
+
+inline F4   load(const float* p)       { return vld1q_f32(p); }
+inline void store(float* p, F4 v)      { vst1q_f32(p, v); }
+inline F4   splat(float f)             { return vdupq_n_f32(f); }
+inline F4   zero()                     { return vdupq_n_f32(0.0f); }
+inline F4   lanes(float a, float b, float c, float d) {
+    const float v[4] = {a, b, c, d};
+    return vld1q_f32(v);
+}
+
+inline F4 add(F4 a, F4 b) { return vaddq_f32(a, b); }
+inline F4 sub(F4 a, F4 b) { return vsubq_f32(a, b); }
+inline F4 mul(F4 a, F4 b) { return vmulq_f32(a, b); }
+inline F4 div(F4 a, F4 b) { return vdivq_f32(a, b); }
+inline F4 min(F4 a, F4 b) { return vminq_f32(a, b); }
+inline F4 max(F4 a, F4 b) { return vmaxq_f32(a, b); }
+
+inline M4 lt(F4 a, F4 b)  { return vcltq_f32(a, b); }
+inline M4 le(F4 a, F4 b)  { return vcleq_f32(a, b); }
+inline M4 bitAnd(M4 a, M4 b)    { return vandq_u32(a, b); }
+inline M4 bitOr(M4 a, M4 b)     { return vorrq_u32(a, b); }
+inline M4 bitAndNot(M4 a, M4 b) { return vbicq_u32(a, b); }
+inline M4 mask(bool a, bool b, bool c, bool d) {
+    const uint32_t v[4] = {-(uint32_t)a, -(uint32_t)b, -(uint32_t)c, -(uint32_t)d};
+    return vld1q_u32(v);
+}
+inline F4   select(M4 m, F4 a, F4 b) { return vbslq_f32(m, a, b); }
+inline bool any(M4 m)                { return vmaxvq_u32(m) != 0; }
+
+#endif
+
+} // namespace simd
+#endif
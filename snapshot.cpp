@@ -0,0 +1,448 @@
+#include "snapshot.h"
+#include "bitstream.h"
+
+namespace {
+
+// ============================================================================
+// Wire Quantization
+// ============================================================================
+// Positions cover the playable world (+-WORLD_BOUND) plus the flight ceiling;
+// anything outside is clamped. Angles wrap around the full circle.
+
+constexpr int   POS_XZ_BITS    = 18;  // ~1.5 mm over +-WORLD_BOUND
+constexpr float POS_Y_MIN      = -8.0f;
+constexpr float POS_Y_MAX      = MAX_ALTITUDE + 28.0f; // Riders and carried flags sit above aircraft
+constexpr int   POS_Y_BITS     = 16;  // ~2 mm
+constexpr int   YAW_BITS       = 14;  // ~0.02 deg
+constexpr int   PITCH_BITS     = 14;
+constexpr int   ROTOR_BITS     = 10;  // Visual only
+constexpr float TORNADO_RADIUS_MAX = 32.0f;
+constexpr int   TORNADO_RADIUS_BITS = 10;
+
+constexpr int STATE_BITS         = bitsFor((uint32_t)PlayerState::SPECTATING);
+constexpr int WEAPON_BITS        = bitsFor((uint32_t)WeaponType::COUNT - 1);
+constexpr int CLASS_BITS         = bitsFor((uint32_t)PlayerClass::COUNT - 1);
+constexpr int VEHICLE_TYPE_BITS  = bitsFor((uint32_t)VehicleType::COUNT - 1);
+constexpr int TEAM_BITS          = bitsFor(NUM_TEAMS - 1);
+constexpr int PLAYER_REF_BITS    = bitsFor(MAX_PLAYERS);   // -1..MAX_PLAYERS-1, stored +1
+constexpr int VEHICLE_REF_BITS   = bitsFor(MAX_VEHICLES);  // -1..MAX_VEHICLES-1, stored +1
+constexpr int VEHICLE_HEALTH_BITS = 11;                    // Tank max health is 1200
+constexpr int BYTE_BITS          = 8;
+
+// ============================================================================
+// Field Streams
+// ============================================================================
+// Each entity kind has a single serialize(stream, state, mask) used for
+// writing, reading and for snapping values to what the wire can represent.
+
+class WriteStream {
+public:
+    explicit WriteStream(BitWriter& w) : w_(w) {}
+    template <typename I>
+    void integer(I& v, int minValue, int bits) {
+        int64_t q = std::clamp<int64_t>((int64_t)v - minValue, 0, maxForBits(bits));
+        w_.write((uint32_t)q, bits);
+    }
+    void real(float& v, float mn, float mx, int bits) { w_.write(quantizeFloat(v, mn, mx, bits), bits); }
+    void angle(float& v, int bits) { w_.write(quantizeAngle(v, bits), bits); }
+private:
+    BitWriter& w_;
+};
+
+class ReadStream {
+public:
+    explicit ReadStream(BitReader& r) : r_(r) {}
+    template <typename I>
+    void integer(I& v, int minValue, int bits) { v = (I)((int64_t)r_.read(bits) + minValue); }
+    void real(float& v, float mn, float mx, int bits) { v = dequantizeFloat(r_.read(bits), mn, mx, bits); }
+    void angle(float& v, int bits) { v = dequantizeAngle(r_.read(bits), bits); }
+private:
+    BitReader& r_;
+};
+
+class QuantizeStream {
+public:
+    template <typename I>
+    void integer(I& v, int minValue, int bits) {
+        v = (I)(std::clamp<int64_t>((int64_t)v - minValue, 0, maxForBits(bits)) + minValue);
+    }
+    void real(float& v, float mn, float mx, int bits) {
+        v = dequantizeFloat(quantizeFloat(v, mn, mx, bits), mn, mx, bits);
+    }
+    void angle(float& v, int bits) { v = dequantizeAngle(quantizeAngle(v, bits), bits); }
+};
+
+template <typename S>
+void serializePos(S& s, float& x, float& y, float& z) {
+    s.real(x, -WORLD_BOUND, WORLD_BOUND, POS_XZ_BITS);
+    s.real(y, POS_Y_MIN, POS_Y_MAX, POS_Y_BITS);
+    s.real(z, -WORLD_BOUND, WORLD_BOUND, POS_XZ_BITS);
+}
+
+template <typename S>
+void serializePitch(S& s, float& pitch) {
+    s.real(pitch, -PI * 0.5f, PI * 0.5f, PITCH_BITS);
+}
+
+// ============================================================================
+// Field Groups
+// ============================================================================
+// Each entity kind splits its fields into groups; a delta entry carries a bit
+// per group that changed since the baseline. A mask of 0 removes the entity.
+// Fields implied by the slot (player/vehicle/flag ids) are never sent.
+
+enum : uint8_t {
+    PF_POS     = 1 << 0,
+    PF_ANGLES  = 1 << 1,
+    PF_STATE   = 1 << 2,
+    PF_HEALTH  = 1 << 3,
+    PF_WEAPON  = 1 << 4,
+    PF_VEHICLE = 1 << 5,
+    PF_INFO    = 1 << 6, // team, class, isBot
+    PF_STATUS  = 1 << 7, // spotted, relevant
+    PF_ALL     = 0xFF,
+};
+
+enum : uint8_t {
+    WF_INFO   = 1 << 0,
+    WF_POS    = 1 << 1,
+    WF_ACTIVE = 1 << 2,
+    WF_ALL    = 0x07,
+};
+
+enum : uint8_t {
+    VF_TYPE   = 1 << 0,
+    VF_POS    = 1 << 1,
+    VF_ANGLES = 1 << 2,
+    VF_HEALTH = 1 << 3,
+    VF_DRIVER = 1 << 4,
+    VF_ACTIVE = 1 << 5,
+    VF_ROTOR  = 1 << 6,
+    VF_ALL    = 0x7F,
+};
+
+enum : uint8_t {
+    FF_POS     = 1 << 0,
+    FF_CARRIER = 1 << 1,
+    FF_ALL     = 0x03,
+};
+
+enum : uint8_t {
+    TF_POS      = 1 << 0,
+    TF_RADIUS   = 1 << 1,
+    TF_ROTATION = 1 << 2,
+    TF_ALL      = 0x07,
+};
+
+// Per-kind wire layout: mask width and the field groups
+template <typename T> struct FieldTraits;
+
+template <> struct FieldTraits<NetPlayerState> {
+    static constexpr uint8_t ALL = PF_ALL;
+    static constexpr int MASK_BITS = 8;
+
+    static uint8_t diff(const NetPlayerState& a, const NetPlayerState& b) {
+        uint8_t m = 0;
+        if (a.x != b.x || a.y != b.y || a.z != b.z)         m |= PF_POS;
+        if (a.yaw != b.yaw || a.pitch != b.pitch)           m |= PF_ANGLES;
+        if (a.state != b.state)                             m |= PF_STATE;
+        if (a.health != b.health)                           m |= PF_HEALTH;
+        if (a.weapon != b.weapon || a.ammo != b.ammo)       m |= PF_WEAPON;
+        if (a.vehicleId != b.vehicleId)                     m |= PF_VEHICLE;
+        if (a.teamId != b.teamId || a.playerClass != b.playerClass ||
+            a.isBot != b.isBot)                             m |= PF_INFO;
+        if (a.spotted != b.spotted || a.relevant != b.relevant) m |= PF_STATUS;
+        return m;
+    }
+
+    template <typename S>
+    static void serialize(S& s, NetPlayerState& p, uint8_t m) {
+        if (m & PF_POS)     serializePos(s, p.x, p.y, p.z);
+        if (m & PF_ANGLES)  { s.angle(p.yaw, YAW_BITS); serializePitch(s, p.pitch); }
+        if (m & PF_STATE)   s.integer(p.state, 0, STATE_BITS);
+        if (m & PF_HEALTH)  s.integer(p.health, 0, BYTE_BITS);
+        if (m & PF_WEAPON)  { s.integer(p.weapon, 0, WEAPON_BITS); s.integer(p.ammo, 0, BYTE_BITS); }
+        if (m & PF_VEHICLE) s.integer(p.vehicleId, -1, VEHICLE_REF_BITS);
+        if (m & PF_INFO) {
+            s.integer(p.teamId, 0, TEAM_BITS);
+            s.integer(p.playerClass, 0, CLASS_BITS);
+            s.integer(p.isBot, 0, 1);
+        }
+        if (m & PF_STATUS)  { s.integer(p.spotted, 0, 1); s.integer(p.relevant, 0, 1); }
+    }
+
+    static void setSlot(NetPlayerState& p, int slot) { p.playerId = (uint8_t)slot; }
+};
+
+template <> struct FieldTraits<NetWeaponState> {
+    static constexpr uint8_t ALL = WF_ALL;
+    static constexpr int MASK_BITS = 3;
+
+    static uint8_t diff(const NetWeaponState& a, const NetWeaponState& b) {
+        uint8_t m = 0;
+        if (a.id != b.id || a.type != b.type)       m |= WF_INFO;
+        if (a.x != b.x || a.y != b.y || a.z != b.z) m |= WF_POS;
+        if (a.active != b.active)                   m |= WF_ACTIVE;
+        return m;
+    }
+
+    template <typename S>
+    static void serialize(S& s, NetWeaponState& w, uint8_t m) {
+        if (m & WF_INFO)   { s.integer(w.id, 0, 16); s.integer(w.type, 0, WEAPON_BITS); }
+        if (m & WF_POS)    serializePos(s, w.x, w.y, w.z);
+        if (m & WF_ACTIVE) s.integer(w.active, 0, 1);
+    }
+
+    static void setSlot(NetWeaponState&, int) {} // id is sent in WF_INFO
+};
+
+template <> struct FieldTraits<NetVehicleState> {
+    static constexpr uint8_t ALL = VF_ALL;
+    static constexpr int MASK_BITS = 7;
+
+    static uint8_t diff(const NetVehicleState& a, const NetVehicleState& b) {
+        uint8_t m = 0;
+        if (a.type != b.type)                       m |= VF_TYPE;
+        if (a.x != b.x || a.y != b.y || a.z != b.z) m |= VF_POS;
+        if (a.yaw != b.yaw || a.pitch != b.pitch || a.turretYaw != b.turretYaw) m |= VF_ANGLES;
+        if (a.health != b.health)                   m |= VF_HEALTH;
+        if (a.driverId != b.driverId)               m |= VF_DRIVER;
+        if (a.active != b.active)                   m |= VF_ACTIVE;
+        if (a.rotorAngle != b.rotorAngle)           m |= VF_ROTOR;
+        return m;
+    }
+
+    template <typename S>
+    static void serialize(S& s, NetVehicleState& v, uint8_t m) {
+        if (m & VF_TYPE)   s.integer(v.type, 0, VEHICLE_TYPE_BITS);
+        if (m & VF_POS)    serializePos(s, v.x, v.y, v.z);
+        if (m & VF_ANGLES) {
+            s.angle(v.yaw, YAW_BITS);
+            serializePitch(s, v.pitch);
+            s.angle(v.turretYaw, YAW_BITS);
+        }
+        if (m & VF_HEALTH) s.integer(v.health, 0, VEHICLE_HEALTH_BITS);
+        if (m & VF_DRIVER) s.integer(v.driverId, -1, PLAYER_REF_BITS);
+        if (m & VF_ACTIVE) s.integer(v.active, 0, 1);
+        if (m & VF_ROTOR)  s.angle(v.rotorAngle, ROTOR_BITS);
+    }
+
+    static void setSlot(NetVehicleState& v, int slot) { v.id = (uint8_t)slot; }
+};
+
+template <> struct FieldTraits<NetFlagState> {
+    static constexpr uint8_t ALL = FF_ALL;
+    static constexpr int MASK_BITS = 2;
+
+    static uint8_t diff(const NetFlagState& a, const NetFlagState& b) {
+        uint8_t m = 0;
+        if (a.x != b.x || a.y != b.y || a.z != b.z)             m |= FF_POS;
+        if (a.carrierId != b.carrierId || a.atBase != b.atBase) m |= FF_CARRIER;
+        return m;
+    }
+
+    template <typename S>
+    static void serialize(S& s, NetFlagState& f, uint8_t m) {
+        if (m & FF_POS)     serializePos(s, f.x, f.y, f.z);
+        if (m & FF_CARRIER) { s.integer(f.carrierId, -1, PLAYER_REF_BITS); s.integer(f.atBase, 0, 1); }
+    }
+
+    static void setSlot(NetFlagState& f, int slot) { f.teamId = (uint8_t)slot; }
+};
+
+template <> struct FieldTraits<NetTornadoState> {
+    static constexpr uint8_t ALL = TF_ALL;
+    static constexpr int MASK_BITS = 3;
+
+    static uint8_t diff(const NetTornadoState& a, const NetTornadoState& b) {
+        uint8_t m = 0;
+        if (a.x != b.x || a.y != b.y || a.z != b.z) m |= TF_POS;
+        if (a.radius != b.radius)                   m |= TF_RADIUS;
+        if (a.rotation != b.rotation)               m |= TF_ROTATION;
+        return m;
+    }
+
+    template <typename S>
+    static void serialize(S& s, NetTornadoState& t, uint8_t m) {
+        if (m & TF_POS)      serializePos(s, t.x, t.y, t.z);
+        if (m & TF_RADIUS)   s.real(t.radius, 0.0f, TORNADO_RADIUS_MAX, TORNADO_RADIUS_BITS);
+        if (m & TF_ROTATION) s.angle(t.rotation, ROTOR_BITS);
+    }
+
+    static void setSlot(NetTornadoState& t, int) { t.active = 1; }
+};
+
+// ============================================================================
+// Sections
+// ============================================================================
+// A section is a list of entries, each prefixed by a 1 bit and terminated by
+// a 0 bit: slot (bitsFor(count - 1) bits), field mask, changed field groups.
+
+// Write every slot that appeared, disappeared or changed relative to the
+// baseline (base == nullptr: every present slot, all fields).
+// present == nullptr means all slots always exist (flags).
+template <typename T>
+void writeSection(BitWriter& w, int count,
+                  const uint8_t* curPresent, const T* cur,
+                  const uint8_t* basePresent, const T* base) {
+    using Traits = FieldTraits<T>;
+    const int slotBits = bitsFor(count - 1);
+    WriteStream s(w);
+
+    for (int i = 0; i < count; i++) {
+        bool isNow = !curPresent || curPresent[i];
+        bool wasThere = base && (!basePresent || basePresent[i]);
+        uint8_t mask;
+        if (!isNow) {
+            if (!wasThere) continue;
+            mask = 0; // Removed
+        } else if (!wasThere) {
+            mask = Traits::ALL;
+        } else {
+            mask = Traits::diff(cur[i], base[i]);
+            if (mask == 0) continue; // Unchanged
+        }
+        w.writeBool(true);
+        w.write(i, slotBits);
+        w.write(mask, Traits::MASK_BITS);
+        T tmp = cur[i];
+        Traits::serialize(s, tmp, mask);
+    }
+    w.writeBool(false);
+}
+
+// Start from the baseline (or empty) and apply the entries of one section
+template <typename T>
+void readSection(BitReader& r, int count,
+                 uint8_t* outPresent, T* out,
+                 const uint8_t* basePresent, const T* base) {
+    using Traits = FieldTraits<T>;
+    const int slotBits = bitsFor(count - 1);
+    ReadStream s(r);
+
+    for (int i = 0; i < count; i++) {
+        if (base) {
+            out[i] = base[i];
+            if (outPresent) outPresent[i] = basePresent ? basePresent[i] : 1;
+        } else {
+            out[i] = T{};
+            Traits::setSlot(out[i], i);
+            if (outPresent) outPresent[i] = 0;
+        }
+    }
+
+    while (r.readBool() && !r.error()) {
+        int slot = (int)r.read(slotBits);
+        uint8_t mask = (uint8_t)r.read(Traits::MASK_BITS);
+        if (slot >= count) r.fail();
+        if (r.error()) return;
+        if (mask == 0) {
+            if (outPresent) outPresent[slot] = 0;
+            out[slot] = T{};
+            Traits::setSlot(out[slot], slot);
+            continue;
+        }
+        if (outPresent && !outPresent[slot]) {
+            out[slot] = T{};
+            Traits::setSlot(out[slot], slot);
+            outPresent[slot] = 1;
+        }
+        Traits::serialize(s, out[slot], mask);
+    }
+}
+
+template <typename T>
+void quantizeSection(int count, const uint8_t* present, T* states) {
+    QuantizeStream s;
+    for (int i = 0; i < count; i++) {
+        if (!present || present[i]) FieldTraits<T>::serialize(s, states[i], FieldTraits<T>::ALL);
+    }
+}
+
+} // namespace
+
+// ============================================================================
+// Encode / Decode
+// ============================================================================
+
+void quantizeSnapshot(WorldSnapshot& snap) {
+    quantizeSection(MAX_PLAYERS, snap.playerPresent, snap.players);
+    quantizeSection(SNAPSHOT_MAX_WEAPONS, snap.weaponPresent, snap.weapons);
+    quantizeSection(MAX_VEHICLES, snap.vehiclePresent, snap.vehicles);
+    quantizeSection<NetFlagState>(2, nullptr, snap.flags);
+    quantizeSection(MAX_TORNADOS, snap.tornadoPresent, snap.tornados);
+}
+
+SnapshotPacket makeSnapshotHeader(const WorldSnapshot& cur, const WorldSnapshot* base,
+                                  uint32_t ackInputSeq) {
+    SnapshotPacket hdr;
+    hdr.serverTick = cur.tick;
+    hdr.baseTick = base ? base->tick : NO_SNAPSHOT_ACK;
+    hdr.ackInputSeq = ackInputSeq;
+    hdr.teamScores[0] = cur.teamScores[0];
+    hdr.teamScores[1] = cur.teamScores[1];
+    return hdr;
+}
+
+int encodeSnapshot(const WorldSnapshot& cur, const WorldSnapshot* base,
+                   uint32_t ackInputSeq, uint8_t* out, int maxLen) {
+    if (maxLen < (int)sizeof(SnapshotPacket)) return -1;
+    SnapshotPacket hdr = makeSnapshotHeader(cur, base, ackInputSeq);
+    memcpy(out, &hdr, sizeof(hdr));
+    int body = encodeSnapshotBody(cur, base, out + sizeof(hdr), maxLen - (int)sizeof(hdr));
+    return body < 0 ? -1 : (int)sizeof(hdr) + body;
+}
+
+int encodeSnapshotBody(const WorldSnapshot& cur, const WorldSnapshot* base,
+                       uint8_t* out, int maxLen) {
+    BitWriter w(out, maxLen);
+    writeSection(w, MAX_PLAYERS, cur.playerPresent, cur.players,
+                 base ? base->playerPresent : nullptr, base ? base->players : nullptr);
+    writeSection(w, SNAPSHOT_MAX_WEAPONS, cur.weaponPresent, cur.weapons,
+                 base ? base->weaponPresent : nullptr, base ? base->weapons : nullptr);
+    writeSection(w, MAX_VEHICLES, cur.vehiclePresent, cur.vehicles,
+                 base ? base->vehiclePresent : nullptr, base ? base->vehicles : nullptr);
+    writeSection<NetFlagState>(w, 2, nullptr, cur.flags,
+                               nullptr, base ? base->flags : nullptr);
+    writeSection(w, MAX_TORNADOS, cur.tornadoPresent, cur.tornados,
+                 base ? base->tornadoPresent : nullptr, base ? base->tornados : nullptr);
+    w.flush();
+
+    return w.overflow() ? -1 : w.bytes();
+}
+
+bool peekSnapshotHeader(const uint8_t* buf, int len, SnapshotPacket& hdr) {
+    if (len < (int)sizeof(SnapshotPacket)) return false;
+    memcpy(&hdr, buf, sizeof(hdr));
+    return hdr.type == (uint8_t)ServerPacket::SNAPSHOT && len >= (int)sizeof(hdr) + hdr.eventBytes;
+}
+
+bool decodeSnapshot(const uint8_t* buf, int len, const WorldSnapshot* base, WorldSnapshot& out) {
+    SnapshotPacket hdr;
+    if (!peekSnapshotHeader(buf, len, hdr)) return false;
+    if (hdr.baseTick == NO_SNAPSHOT_ACK) {
+        base = nullptr;
+    } else if (!base || base == &out || base->tick != hdr.baseTick) {
+        return false; // Baseline no longer held
+    }
+
+    out.tick = hdr.serverTick;
+    out.teamScores[0] = hdr.teamScores[0];
+    out.teamScores[1] = hdr.teamScores[1];
+
+    int bodyStart = (int)sizeof(hdr) + hdr.eventBytes;
+    BitReader r(buf + bodyStart, len - bodyStart);
+    readSection(r, MAX_PLAYERS, out.playerPresent, out.players,
+                base ? base->playerPresent : nullptr, base ? base->players : nullptr);
+    readSection(r, SNAPSHOT_MAX_WEAPONS, out.weaponPresent, out.weapons,
+                base ? base->weaponPresent : nullptr, base ? base->weapons : nullptr);
+    readSection(r, MAX_VEHICLES, out.vehiclePresent, out.vehicles,
+                base ? base->vehiclePresent : nullptr, base ? base->vehicles : nullptr);
+    readSection<NetFlagState>(r, 2, nullptr, out.flags,
+                              nullptr, base ? base->flags : nullptr);
+    readSection(r, MAX_TORNADOS, out.tornadoPresent, out.tornados,
+                base ? base->tornadoPresent : nullptr, base ? base->tornados : nullptr);
+
+    out.valid = !r.error();
+    return out.valid;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "common.h"
+#include "network.h"
+
+// ============================================================================
+// World Snapshots
+// ============================================================================
+
+constexpr int SNAPSHOT_MAX_WEAPONS = 64;
+constexpr int SNAPSHOT_RING_SIZE   = 32;   // Baselines older than this many ticks fall back to full
+
+// Everything a client sees in one server tick, one slot per entity. Slots
+// with present == 0 do not exist (disconnected player, unused pickup/vehicle
+// slot, inactive tornado).
+struct WorldSnapshot {
+    uint32_t        tick = 0;
+    bool            valid = false;
+    uint8_t         teamScores[2] = {0, 0};
+
+    uint8_t         playerPresent[MAX_PLAYERS] = {};
+    NetPlayerState  players[MAX_PLAYERS];
+    uint8_t         weaponPresent[SNAPSHOT_MAX_WEAPONS] = {};
+    NetWeaponState  weapons[SNAPSHOT_MAX_WEAPONS];
+    uint8_t         vehiclePresent[MAX_VEHICLES] = {};
+    NetVehicleState vehicles[MAX_VEHICLES];
+    NetFlagState    flags[2];
+    uint8_t         tornadoPresent[MAX_TORNADOS] = {};
+    NetTornadoState tornados[MAX_TORNADOS];
+};
+
+// Fixed-size history of snapshots indexed by tick
+struct SnapshotRing {
+    WorldSnapshot slots[SNAPSHOT_RING_SIZE];
+
+    WorldSnapshot& slotFor(uint32_t tick) { return slots[tick % SNAPSHOT_RING_SIZE]; }
+    // Snapshot for exactly this tick, or nullptr if it was never stored or overwritten
+    const WorldSnapshot* find(uint32_t tick) const {
+        const WorldSnapshot& s = slots[tick % SNAPSHOT_RING_SIZE];
+        return (s.valid && s.tick == tick) ? &s : nullptr;
+    }
+};
+
+// Snap every field to the precision the wire format carries. The server
+// applies this when recording a snapshot, so deltas compare exactly the
+// values the client will hold.
+void quantizeSnapshot(WorldSnapshot& snap);
+
+// A snapshot datagram is a SnapshotPacket header, the client's unacked
+// reliable events, then the encoded body. The body depends only on
+// (cur, base), so the server encodes it once per distinct baseline and pairs
+// it with a small per-client header.
+SnapshotPacket makeSnapshotHeader(const WorldSnapshot& cur, const WorldSnapshot* base,
+                                  uint32_t ackInputSeq);
+
+// Encode the body of cur. With a baseline, only entities and field groups
+// that differ from it are written; base == nullptr writes a full snapshot.
+// Returns bytes written, or -1 if maxLen is too small.
+int encodeSnapshotBody(const WorldSnapshot& cur, const WorldSnapshot* base,
+                       uint8_t* out, int maxLen);
+
+// Header + body in one buffer. Returns bytes written, or -1.
+int encodeSnapshot(const WorldSnapshot& cur, const WorldSnapshot* base,
+                   uint32_t ackInputSeq, uint8_t* out, int maxLen);
+
+// Read the header of an encoded snapshot (tick, baseline, ack)
+bool peekSnapshotHeader(const uint8_t* buf, int len, SnapshotPacket& hdr);
+
+// Reliable events a snapshot carries: fn(seq, record, len) for each, in
+// order. Returns false if the event block is malformed.
+template<typename Fn>
+bool forEachSnapshotEvent(const uint8_t* buf, const SnapshotPacket& hdr, Fn&& fn) {
+    const uint8_t* p = buf + sizeof(SnapshotPacket);
+    const uint8_t* end = p + hdr.eventBytes;
+    for (uint32_t seq = hdr.firstEventSeq; p < end; seq++) {
+        int len = reliableEventSize(*p);
+        if (len == 0 || len > end - p) return false;
+        fn(seq, p, len);
+        p += len;
+    }
+    return true;
+}
+
+// Decode the body of a snapshot datagram, skipping any events. base must be
+// the snapshot for hdr.baseTick when the packet is a delta (ignored for full
+// snapshots).
+// Returns false on a truncated/malformed packet or a missing baseline.
+bool decodeSnapshot(const uint8_t* buf, int len, const WorldSnapshot* base, WorldSnapshot& out);
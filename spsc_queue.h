@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// ============================================================================
+// Single-Producer Single-Consumer Queue
+// ============================================================================
+
+// Fixed ring of N slots (N a power of two) between exactly one producer
+// thread and one consumer thread, with no locks. Items are filled and read
+// in place: the producer writes into beginPush() and publishes it with
+// push(); the consumer reads front() and releases it with pop(). Each index
+// is written by one side only, so the two never wait on each other.
+template<typename T, uint32_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+    // Producer: the next free slot, or nullptr when the queue is full
+    T* beginPush() {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == N) return nullptr;
+        return &items_[tail % N];
+    }
+    void push() { tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Consumer: the oldest item, or nullptr when the queue is empty
+    T* front() {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return nullptr;
+        return &items_[head % N];
+    }
+    void pop() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Only while neither side is running
+    void clear() { head_.store(tail_.load()); }
+
+private:
+    T                                  items_[N];
+    alignas(64) std::atomic<uint32_t>  head_{0}; // Next slot to read, consumer-owned
+    alignas(64) std::atomic<uint32_t>  tail_{0}; // Next slot to write, producer-owned
+};
@@ -0,0 +1,85 @@
+#include "tick_scheduler.h"
+#include <algorithm>
+#include <errno.h>
+#include <time.h>
+
+TickScheduler::TickScheduler(double periodSeconds, bool keepStats)
+    : periodNs_((int64_t)(periodSeconds * 1e9)), keepStats_(keepStats) {}
+
+int64_t TickScheduler::now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void TickScheduler::start() {
+    startNs_ = now();
+    nextTick_ = 0;
+}
+
+int TickScheduler::wait() {
+    int64_t deadline = startNs_ + nextTick_ * periodNs_;
+    int64_t t = now();
+    int64_t sleepStart = t;
+
+    // Sleep most of the way; the kernel may wake us late, so spin the end
+    if (deadline - t > SPIN_NS) {
+        int64_t wakeAt = deadline - SPIN_NS;
+        timespec ts = {(time_t)(wakeAt / 1000000000), (long)(wakeAt % 1000000000)};
+        // Restart after a signal; on any other error fall through to the spin
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+    }
+    while ((t = now()) < deadline) {}
+    sleepNs_ += t - sleepStart;
+    wakes_++;
+
+    // Every tick whose deadline has passed is due
+    int64_t due = (t - startNs_) / periodNs_ + 1 - nextTick_;
+    if (due > MAX_CATCHUP) {
+        // Too far behind to catch up without stalling: drop the backlog
+        skipped_ += (int)(due - MAX_CATCHUP);
+        nextTick_ += due - MAX_CATCHUP;
+        due = MAX_CATCHUP;
+    }
+    nextTick_ += due;
+    return (int)due;
+}
+
+void TickScheduler::beginTick() {
+    tickBeginNs_ = now();
+}
+
+void TickScheduler::endTick() {
+    int64_t work = now() - tickBeginNs_;
+    if (keepStats_) workNs_.push_back(work);
+    if (work > periodNs_) overruns_++;
+}
+
+TickScheduler::Stats TickScheduler::takeStats() {
+    Stats s;
+    s.ticks = (int)workNs_.size();
+    s.overruns = overruns_;
+    s.skipped = skipped_;
+    if (wakes_ > 0) s.sleepAvg = sleepNs_ / 1e6 / wakes_;
+    if (!workNs_.empty()) {
+        int64_t total = 0;
+        for (int64_t w : workNs_) total += w;
+        s.workAvg = total / 1e6 / workNs_.size();
+
+        auto pct = [&](double p) {
+            size_t k = std::min(workNs_.size() - 1, (size_t)(p * workNs_.size()));
+            std::nth_element(workNs_.begin(), workNs_.begin() + k, workNs_.end());
+            return workNs_[k] / 1e6;
+        };
+        s.workP50 = pct(0.50);
+        s.workP99 = pct(0.99);
+        s.workMax = *std::max_element(workNs_.begin(), workNs_.end()) / 1e6;
+    }
+
+    workNs_.clear();
+    sleepNs_ = 0;
+    wakes_ = 0;
+    overruns_ = 0;
+    skipped_ = 0;
+    return s;
+}
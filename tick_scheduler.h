@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// ============================================================================
+// Tick Scheduler
+// ============================================================================
+
+// Paces the server loop against absolute deadlines: tick N is due at
+// start + N * period, so sleep overshoot and slow ticks never accumulate
+// into drift. Waits sleep with clock_nanosleep until shortly before the
+// deadline and spin the rest. After an overrun the missed ticks are run back
+// to back, a few per wake; anything further behind is skipped.
+class TickScheduler {
+public:
+    static constexpr int     MAX_CATCHUP = 4;       // Ticks simulated per wake at most
+    static constexpr int64_t SPIN_NS     = 200000;  // Final stretch before a deadline is spun
+
+    // Over the ticks since the last takeStats(); times in milliseconds
+    struct Stats {
+        int    ticks = 0;
+        int    overruns = 0;    // Ticks whose work took longer than the period
+        int    skipped = 0;     // Ticks dropped because the loop fell too far behind
+        double workAvg = 0, workP50 = 0, workP99 = 0, workMax = 0;
+        double sleepAvg = 0;    // Per wake
+    };
+
+    // Without keepStats no work times are kept and takeStats() reports only
+    // the counters
+    TickScheduler(double periodSeconds, bool keepStats);
+
+    void start();
+    // Block until the next tick is due, then return how many ticks to run
+    // now (1..MAX_CATCHUP)
+    int  wait();
+    // Bracket the work of one tick
+    void beginTick();
+    void endTick();
+
+    int   ticksMeasured() const { return (int)workNs_.size(); }
+    Stats takeStats();
+
+private:
+    static int64_t now();
+
+    int64_t periodNs_;
+    int64_t startNs_ = 0;
+    int64_t nextTick_ = 0;      // Index of the next tick to run, relative to startNs_
+    int64_t tickBeginNs_ = 0;
+    bool    keepStats_;
+
+    std::vector<int64_t> workNs_; // This stats window
+    int64_t sleepNs_ = 0;
+    int     wakes_ = 0;
+    int     overruns_ = 0;
+    int     skipped_ = 0;
+};
@@ -0,0 +1,1968 @@
+#include "world.h"
+#include "profiler.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+
+// Bots draw from their own xorshift stream instead of the world's, so
+// decisions are the same however the AI workers are scheduled
+static uint32_t botRand(BotData& bot);
+static float botRandf(BotData& bot) { return (float)(botRand(bot) >> 8) * (1.0f / 16777216.0f); }
+static float botRandf(BotData& bot, float mn, float mx) { return mn + botRandf(bot) * (mx - mn); }
+
+// ============================================================================
+// Utility
+// ============================================================================
+
+uint32_t World::nextRand() {
+    uint32_t x = rng_;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return rng_ = x;
+}
+
+float World::randf() {
+    return (float)(nextRand() >> 8) * (1.0f / 16777216.0f);
+}
+
+void World::logEvent(const char* fmt, ...) const {
+    if (!verbose) return;
+    fputs(logTag, stdout);
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+void World::queueEvent(const void* data, size_t len) {
+    events.push_back({(int)eventData.size(), (int)len});
+    const uint8_t* bytes = (const uint8_t*)data;
+    eventData.insert(eventData.end(), bytes, bytes + len);
+}
+
+void World::clearEvents() {
+    events.clear();
+    eventData.clear();
+}
+
+// ============================================================================
+// A* Pathfinding on Waypoint Graph
+// ============================================================================
+
+// Search state reused across calls. Entries whose generation differs from
+// the current search are treated as untouched, so nothing is cleared or
+// allocated per search once the arrays have grown to the graph size.
+struct PathNode {
+    float    g = 0;
+    int      parent = -1;
+    uint32_t openGen = 0;   // g/parent valid for this generation
+    uint32_t closedGen = 0; // Settled in this generation
+};
+// Per thread, since bots path from the AI workers.
+static thread_local std::vector<PathNode>               g_pathNodes;
+static thread_local std::vector<std::pair<float, int>> g_pathHeap; // (f, node), min-heap
+static thread_local std::vector<int>                   g_pathSettled; // Nodes in the order they closed
+static thread_local uint32_t                           g_pathGen = 0;
+
+// A* from startWP to goalWP on a binary heap with lazy deletion.
+// goalWP < 0 runs a plain Dijkstra over the whole graph instead.
+// Returns false if the goal was not reached.
+static bool searchWaypoints(const GameMap& map, int startWP, int goalWP) {
+    const auto& wps = map.waypoints();
+    if (g_pathNodes.size() < wps.size()) g_pathNodes.resize(wps.size());
+    if (++g_pathGen == 0) { // Wrapped: forget every stamp
+        for (PathNode& n : g_pathNodes) n.openGen = n.closedGen = 0;
+        g_pathGen = 1;
+    }
+    const uint32_t gen = g_pathGen;
+    auto heuristic = [&](int n) {
+        return goalWP < 0 ? 0.0f : (wps[goalWP].position - wps[n].position).length();
+    };
+    auto cmp = [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; };
+
+    g_pathHeap.clear();
+    g_pathSettled.clear();
+    g_pathNodes[startWP] = {0.0f, -1, gen, 0};
+    g_pathHeap.push_back({heuristic(startWP), startWP});
+
+    while (!g_pathHeap.empty()) {
+        std::pop_heap(g_pathHeap.begin(), g_pathHeap.end(), cmp);
+        int current = g_pathHeap.back().second;
+        g_pathHeap.pop_back();
+        PathNode& cur = g_pathNodes[current];
+        if (cur.closedGen == gen) continue; // Stale heap entry
+        cur.closedGen = gen;
+        g_pathSettled.push_back(current);
+        if (current == goalWP) return true;
+
+        for (int neighbor : map.waypointNeighbors(current)) {
+            PathNode& nb = g_pathNodes[neighbor];
+            if (nb.closedGen == gen) continue;
+            float tentG = cur.g + (wps[neighbor].position - wps[current].position).length();
+            if (nb.openGen != gen || tentG < nb.g) {
+                nb.g = tentG;
+                nb.parent = current;
+                nb.openGen = gen;
+                g_pathHeap.push_back({tentG + heuristic(neighbor), neighbor});
+                std::push_heap(g_pathHeap.begin(), g_pathHeap.end(), cmp);
+            }
+        }
+    }
+    return goalWP < 0;
+}
+
+// Precompute nextHop_ with one Dijkstra per source. The waypoint graph
+// never changes after buildArcticMap, so bot repaths become table walks.
+void World::buildNextHopTable() {
+    const int n = (int)map->waypoints().size();
+    nextHop_.assign((size_t)n * n, -1);
+    nextHopSize_ = n;
+    for (int s = 0; s < n; s++) {
+        searchWaypoints(*map, s, -1);
+        // First hop toward each node is its parent's first hop; parents
+        // always close before their children
+        int16_t* row = &nextHop_[(size_t)s * n];
+        for (int t : g_pathSettled) {
+            if (t == s) continue;
+            int parent = g_pathNodes[t].parent;
+            row[t] = (int16_t)(parent == s ? t : row[parent]);
+        }
+    }
+}
+
+static float pathLength(const GameMap& map, const std::vector<int>& path) {
+    const auto& wps = map.waypoints();
+    float len = 0;
+    for (size_t i = 1; i < path.size(); i++)
+        len += (wps[path[i]].position - wps[path[i - 1]].position).length();
+    return len;
+}
+
+void World::findPath(int startWP, int goalWP, std::vector<int>& path, bool useTable) const {
+    const auto& wps = map->waypoints();
+    int numWP = (int)wps.size();
+    path.clear();
+    if (startWP < 0 || goalWP < 0 || startWP >= numWP || goalWP >= numWP)
+        return;
+    if (startWP == goalWP) {
+        path.push_back(startWP);
+        return;
+    }
+
+    if (useTable && nextHopSize_ == numWP) {
+        const int16_t* hops = &nextHop_[goalWP];
+        if (hops[(size_t)startWP * numWP] < 0) return;
+        for (int n = startWP; n != goalWP; n = hops[(size_t)n * numWP]) path.push_back(n);
+        path.push_back(goalWP);
+        return;
+    }
+
+    if (!searchWaypoints(*map, startWP, goalWP)) return;
+    for (int n = goalWP; n != -1; n = g_pathNodes[n].parent) path.push_back(n);
+    std::reverse(path.begin(), path.end());
+}
+
+// findPath into a bot's inline path, through a per-thread scratch vector
+void World::findBotPath(int startWP, int goalWP, BotPath& path) const {
+    static thread_local std::vector<int> scratch;
+    findPath(startWP, goalWP, scratch);
+    path.assign(scratch);
+}
+
+int World::verifyNextHopTable() const {
+    int n = (int)map->waypoints().size(), mismatches = 0;
+    std::vector<int> viaTable, viaSearch;
+    for (int s = 0; s < n; s++) {
+        for (int g = 0; g < n; g++) {
+            findPath(s, g, viaTable, true);
+            findPath(s, g, viaSearch, false);
+            if (viaTable.empty() != viaSearch.empty() ||
+                fabsf(pathLength(*map, viaTable) - pathLength(*map, viaSearch)) > 1e-3f)
+                mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+// Find the nearest waypoint the bot can reach (closest by distance)
+static int findNearestWaypointToPos(const GameMap& map, const Vec3& pos) {
+    return map.findNearestWaypoint(pos);
+}
+
+// ============================================================================
+// Players
+// ============================================================================
+
+int World::findFreeSlot() const {
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (players[i].state == PlayerState::DISCONNECTED) return i;
+    }
+    return -1;
+}
+
+void World::rebuildActive() {
+    numActive = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (players[i].state != PlayerState::DISCONNECTED) activeIds[numActive++] = i;
+    }
+}
+
+void World::spawnPlayer(int id) {
+    // Use team-specific spawns
+    int team = players[id].teamId;
+    const auto& spawns = map->teamSpawns(team);
+    const auto& fallback = map->spawns();
+    const auto& chosen = spawns.empty() ? fallback : spawns;
+    int si = nextRand() % chosen.size();
+    players[id].position = chosen[si].position;
+    players[id].yaw = chosen[si].yaw;
+    players[id].pitch = 0;
+    players[id].velocity = {0, 0, 0};
+    players[id].health = MAX_HEALTH;
+    players[id].state = PlayerState::ALIVE;
+    players[id].fireCooldown = 0;
+    players[id].respawnTimer = 0;
+    players[id].vehicleId = -1;
+    players[id].isDriver = false;
+    players[id].abilityCooldown = 0;
+    players[id].spotted = false;
+    players[id].spottedTimer = 0;
+    playerGrid.update(id, players[id].position);
+
+    // Apply class loadout
+    const auto& cdef = getClassDef(players[id].playerClass);
+    players[id].currentWeapon = cdef.primaryWeapon;
+    players[id].ammo = getWeaponDef(cdef.primaryWeapon).magSize;
+    players[id].health = MAX_HEALTH + cdef.extraHealth;
+}
+
+void World::tickPlayers(float dt) {
+    PROFILE_SCOPE("players");
+    for (int a = 0; a < numActive; a++) {
+        int i = activeIds[a];
+        if (players[i].state == PlayerState::DEAD) {
+            players[i].respawnTimer -= dt;
+            if (players[i].respawnTimer <= 0) {
+                spawnPlayer(i);
+            }
+            continue;
+        }
+        if (players[i].state != PlayerState::ALIVE) continue;
+
+        InputState* input = inputSource[i];
+
+        if (input) {
+            // Vehicle enter/exit
+            if (input->keys & InputState::KEY_USE) {
+                if (players[i].vehicleId >= 0) {
+                    exitVehicle(i);
+                } else {
+                    enterVehicle(i);
+                }
+                input->keys &= ~InputState::KEY_USE;
+            }
+
+            // Ability cooldown
+            if (players[i].abilityCooldown > 0)
+                players[i].abilityCooldown -= dt;
+
+            // Process class ability (Q key)
+            if (input->keys & InputState::KEY_ABILITY) {
+                processAbility(i, *input);
+                input->keys &= ~InputState::KEY_ABILITY;
+            }
+
+            // Only tick player movement if NOT in vehicle
+            if (players[i].vehicleId < 0) {
+                tickPlayer(players[i], *input, *map, dt);
+                playerGrid.update(i, players[i].position);
+
+                // Process shooting (on foot)
+                if (input->keys & InputState::KEY_SHOOT) {
+                    processShot(i);
+                }
+            }
+            // In vehicle: shooting is handled by tickVehicles
+        }
+
+        // Spotted timer
+        if (players[i].spotted) {
+            players[i].spottedTimer -= dt;
+            if (players[i].spottedTimer <= 0) {
+                players[i].spotted = false;
+            }
+        }
+    }
+}
+
+int World::addPlayer(const char* name) {
+    int slot = findFreeSlot();
+    if (slot < 0) return -1;
+
+    players[slot] = PlayerData{};
+    snprintf(profiles[slot].name, sizeof(profiles[slot].name), "%s", name);
+    players[slot].currentWeapon = WeaponType::PISTOL;
+    players[slot].ammo = getWeaponDef(WeaponType::PISTOL).magSize;
+    // Assign team (round-robin)
+    players[slot].teamId = nextTeam;
+    nextTeam = (nextTeam + 1) % 2;
+    spawnPlayer(slot);
+    viewTick[slot] = NO_SNAPSHOT_ACK;
+    rebuildActive();
+    return slot;
+}
+
+void World::removePlayer(int id) {
+    players[id].state = PlayerState::DISCONNECTED;
+    inputSource[id] = nullptr;
+    rebuildActive();
+}
+
+// Class selection (can change anytime, applies on next spawn)
+void World::selectClass(int id, PlayerClass cls) {
+    if (cls == players[id].playerClass) return;
+    players[id].playerClass = cls;
+    const auto& cdef = getClassDef(cls);
+    // If alive, apply new loadout immediately
+    if (players[id].state == PlayerState::ALIVE) {
+        players[id].currentWeapon = cdef.primaryWeapon;
+        players[id].ammo = getWeaponDef(cdef.primaryWeapon).magSize;
+        players[id].health = MAX_HEALTH + cdef.extraHealth;
+    }
+    logEvent("Player %d switched to %s class\n", id, cdef.name);
+}
+
+// ============================================================================
+// Lag Compensation
+// ============================================================================
+
+void World::recordHitboxes() {
+    HitboxFrame& f = hitboxes[serverTick % HITBOX_HISTORY];
+    f.tick = serverTick;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        f.x[i] = players[i].position.x;
+        f.y[i] = players[i].position.y;
+        f.z[i] = players[i].position.z;
+        f.alive[i] = players[i].state == PlayerState::ALIVE;
+    }
+}
+
+const HitboxFrame* World::findHitboxes(uint32_t tick) const {
+    const HitboxFrame& f = hitboxes[tick % HITBOX_HISTORY];
+    return f.tick == tick ? &f : nullptr;
+}
+
+// Move the other players back to where the shooter saw them when firing:
+// the client's interpolated view tick, no further back than the rewind
+// window, into `out` with alive[] meaning hittable. Returns false when
+// current positions should be used instead.
+bool World::rewindHitboxes(int shooterId, HitboxFrame& out) const {
+    if (rewindTicks <= 0 || serverTick == 0) return false;
+    if (players[shooterId].isBot || viewTick[shooterId] == NO_SNAPSHOT_ACK) return false;
+
+    // Frames exist up to the end of last tick; the newest one is the present
+    double newest = serverTick - 1;
+    double view = viewTick[shooterId] + viewTickFrac[shooterId] / 256.0;
+    view = std::max(view, newest - rewindTicks);
+    if (view >= newest) return false;
+
+    uint32_t tick = (uint32_t)view;
+    float t = (float)(view - tick);
+    const HitboxFrame* a = findHitboxes(tick);
+    const HitboxFrame* b = findHitboxes(tick + 1);
+    if (!a) return false;
+    if (!b) { b = a; t = 0; }
+
+    out.tick = tick;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        out.x[i] = a->x[i] + (b->x[i] - a->x[i]) * t;
+        out.y[i] = a->y[i] + (b->y[i] - a->y[i]) * t;
+        out.z[i] = a->z[i] + (b->z[i] - a->z[i]) * t;
+    }
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        // Anyone who has since died or left can no longer be hit
+        out.alive[i] = a->alive[i] && b->alive[i] && players[i].state == PlayerState::ALIVE;
+    }
+    return true;
+}
+
+// ============================================================================
+// Shooting
+// ============================================================================
+
+void World::processShot(int shooterId) {
+    PlayerData& shooter = players[shooterId];
+    if (shooter.state != PlayerState::ALIVE) return;
+    if (shooter.fireCooldown > 0) return;
+    if (shooter.ammo <= 0) return;
+
+    const auto& def = getWeaponDef(shooter.currentWeapon);
+    shooter.fireCooldown = def.fireRate;
+    shooter.ammo--;
+
+    // Auto-reload: when out of ammo, refill (simulates reload)
+    if (shooter.ammo <= 0) {
+        shooter.ammo = def.magSize;
+        shooter.fireCooldown = def.fireRate * 3; // Longer delay for reload
+    }
+
+    Vec3 eyePos = shooter.position;
+    eyePos.y += PLAYER_EYE_HEIGHT;
+
+    // Rays test a hitbox frame: rewound, or for a multi-pellet shot the
+    // live players gathered once so every pellet runs the batched kernel
+    static thread_local HitboxFrame targets;
+    bool rewind = rewindHitboxes(shooterId, targets);
+    bool batched = rewind || def.pelletsPerShot > 1;
+    if (batched && !rewind) {
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            targets.x[i] = players[i].position.x;
+            targets.y[i] = players[i].position.y;
+            targets.z[i] = players[i].position.z;
+            targets.alive[i] = players[i].state == PlayerState::ALIVE;
+        }
+    }
+
+    for (int pellet = 0; pellet < def.pelletsPerShot; pellet++) {
+        // Direction with spread
+        float spreadYaw = shooter.yaw + randf(-def.spread, def.spread);
+        float spreadPitch = shooter.pitch + randf(-def.spread, def.spread);
+
+        Vec3 dir = {
+            sinf(spreadYaw) * cosf(spreadPitch),
+            sinf(spreadPitch),
+            cosf(spreadYaw) * cosf(spreadPitch)
+        };
+        dir = dir.normalize();
+
+        // Check player hit
+        float playerDist = def.range;
+        int hitPlayer = batched
+            ? GameMap::raycastPlayers(eyePos, dir, def.range, targets.x, targets.y, targets.z,
+                                      targets.alive, MAX_PLAYERS, shooterId, playerDist)
+            : GameMap::raycastPlayers(eyePos, dir, def.range,
+                                      players, playerGrid, shooterId, playerDist);
+
+        // Check wall hit
+        Vec3 wallHit;
+        float wallDist;
+        bool hitWall = map->raycast(eyePos, dir, def.range, wallHit, wallDist);
+
+        if (hitPlayer >= 0 && (!hitWall || playerDist < wallDist) &&
+            players[hitPlayer].teamId != players[shooterId].teamId) {
+            players[hitPlayer].health -= def.damage;
+            logEvent("  HIT! %s -> %s for %d dmg (hp now %d)\n",
+                   profiles[shooterId].name, profiles[hitPlayer].name,
+                   def.damage, players[hitPlayer].health);
+
+            // Queue hit notification for all clients
+            PlayerHitPacket hitPkt;
+            hitPkt.attackerId = shooterId;
+            hitPkt.victimId = hitPlayer;
+            hitPkt.damage = def.damage;
+            queueEvent(&hitPkt, sizeof(hitPkt));
+
+            if (players[hitPlayer].health <= 0) {
+                players[hitPlayer].health = 0;
+                players[hitPlayer].state = PlayerState::DEAD;
+                players[hitPlayer].respawnTimer = RESPAWN_TIME;
+                targets.alive[hitPlayer] = 0; // Later pellets pass through
+
+                // Drop flag if carrying
+                for (int t = 0; t < 2; t++) {
+                    if (flags[t].carrierId == hitPlayer) {
+                        flags[t].carrierId = -1;
+                        flags[t].atBase = false;
+                        flags[t].position = players[hitPlayer].position;
+                        flags[t].returnTimer = 30.0f;
+                    }
+                }
+
+                PlayerDiedPacket diePkt;
+                diePkt.victimId = hitPlayer;
+                diePkt.killerId = shooterId;
+                diePkt.victimIsBot = players[hitPlayer].isBot;
+                diePkt.killerIsBot = players[shooterId].isBot;
+                queueEvent(&diePkt, sizeof(diePkt));
+                killFeed.push_back({shooterId, hitPlayer, 5.0f});
+
+                logEvent("%s killed %s\n",
+                       profiles[shooterId].name[0] ? profiles[shooterId].name : "Bot",
+                       profiles[hitPlayer].name[0] ? profiles[hitPlayer].name : "Bot");
+            }
+        }
+    }
+}
+
+// ============================================================================
+// Class Abilities
+// ============================================================================
+
+void World::processAbility(int playerId, const InputState& input) {
+    PlayerData& p = players[playerId];
+    if (p.state != PlayerState::ALIVE) return;
+    if (!(input.keys & InputState::KEY_ABILITY)) return;
+    if (p.abilityCooldown > 0) return;
+
+    const auto& cdef = getClassDef(p.playerClass);
+    p.abilityCooldown = cdef.abilityCooldown;
+
+    switch (cdef.ability) {
+        case AbilityType::FRAG_GRENADE: {
+            // Throw grenade: instant damage in area
+            Vec3 eyePos = p.position;
+            eyePos.y += PLAYER_EYE_HEIGHT;
+            Vec3 dir = {sinf(p.yaw) * cosf(p.pitch), sinf(p.pitch), cosf(p.yaw) * cosf(p.pitch)};
+            dir = dir.normalize();
+            Vec3 grenadePos = eyePos + dir * 15.0f; // Grenade lands 15m ahead
+            grenadePos.y = 0.5f;
+
+            // Damage all enemies in 6m radius
+            for (int a = 0; a < numActive; a++) {
+                int i = activeIds[a];
+                if (i == playerId) continue;
+                if (players[i].state != PlayerState::ALIVE) continue;
+                if (players[i].teamId == p.teamId) continue;
+                float d = (players[i].position - grenadePos).length();
+                if (d < 6.0f) {
+                    int dmg = (int)(60.0f * (1.0f - d / 6.0f));
+                    vehicleDamage(i, playerId, dmg);
+                }
+            }
+            logEvent("Player %d threw frag grenade!\n", playerId);
+            break;
+        }
+        case AbilityType::ROCKET_LAUNCHER: {
+            // Fire a rocket: hitscan with big damage, mainly for vehicles
+            Vec3 eyePos = p.position;
+            eyePos.y += PLAYER_EYE_HEIGHT;
+            Vec3 dir = {sinf(p.yaw) * cosf(p.pitch), sinf(p.pitch), cosf(p.yaw) * cosf(p.pitch)};
+            dir = dir.normalize();
+
+            // Check vehicle hit
+            float bestDist = 400.0f;
+            int hitVeh = -1;
+            for (int v = 0; v < numVehicles; v++) {
+                if (!vehicles[v].active) continue;
+                const auto& vdef = getVehicleDef(vehicles[v].type);
+                AABB vBox = {
+                    vehicles[v].position - Vec3{vdef.length*0.5f, 0, vdef.width*0.5f},
+                    vehicles[v].position + Vec3{vdef.length*0.5f, vdef.height, vdef.width*0.5f}
+                };
+                float t;
+                if (vBox.raycast(eyePos, dir, t) && t < bestDist) {
+                    bestDist = t;
+                    hitVeh = v;
+                }
+            }
+            // Check player hit too
+            float pDist = 400.0f;
+            int hitP = GameMap::raycastPlayers(eyePos, dir, 400.0f, players, MAX_PLAYERS, playerId, pDist);
+
+            if (hitVeh >= 0 && bestDist < pDist) {
+                vehicles[hitVeh].health -= 150; // Big anti-vehicle damage
+                logEvent("Player %d rocket hit vehicle %d!\n", playerId, hitVeh);
+            } else if (hitP >= 0 && players[hitP].teamId != p.teamId) {
+                vehicleDamage(hitP, playerId, 80);
+            }
+            break;
+        }
+        case AbilityType::AMMO_DROP: {
+            // Refill ammo for all nearby teammates
+            for (int a = 0; a < numActive; a++) {
+                int i = activeIds[a];
+                if (players[i].state != PlayerState::ALIVE) continue;
+                if (players[i].teamId != p.teamId) continue;
+                float d = (players[i].position - p.position).length();
+                if (d < 10.0f) {
+                    players[i].ammo = getWeaponDef(players[i].currentWeapon).magSize;
+                }
+            }
+            logEvent("Player %d dropped ammo!\n", playerId);
+            break;
+        }
+        case AbilityType::SPOT_ENEMIES: {
+            // Spot all visible enemies within range
+            Vec3 eyePos = p.position;
+            eyePos.y += PLAYER_EYE_HEIGHT;
+            int spotted = 0;
+            for (int a = 0; a < numActive; a++) {
+                int i = activeIds[a];
+                if (players[i].state != PlayerState::ALIVE) continue;
+                if (players[i].teamId == p.teamId) continue;
+                float d = (players[i].position - p.position).length();
+                if (d < 80.0f && canSeePlayer(playerId, i)) {
+                    players[i].spotted = true;
+                    players[i].spottedTimer = 8.0f;
+                    spotted++;
+                }
+            }
+            logEvent("Player %d spotted %d enemies!\n", playerId, spotted);
+            break;
+        }
+        default: break;
+    }
+}
+
+// ============================================================================
+// Weapon Pickups
+// ============================================================================
+
+void World::processPickups(float dt) {
+    PROFILE_SCOPE("pickups");
+    for (auto& wp : pickups) {
+        if (!wp.active) {
+            wp.respawnTimer -= dt;
+            if (wp.respawnTimer <= 0) {
+                wp.active = true;
+                logEvent("Weapon %s respawned\n", getWeaponDef(wp.type).name);
+            }
+            continue;
+        }
+
+        thread_local std::vector<int> nearby;
+        playerGrid.query(wp.position, 1.5f, nearby);
+        for (int i : nearby) {
+            if (players[i].state != PlayerState::ALIVE) continue;
+            float dist = (players[i].position - wp.position).length();
+            if (dist < 1.5f) {
+                players[i].currentWeapon = wp.type;
+                players[i].ammo = getWeaponDef(wp.type).magSize;
+                wp.active = false;
+                wp.respawnTimer = WEAPON_RESPAWN;
+                logEvent("Player %d picked up %s\n", i, getWeaponDef(wp.type).name);
+                break;
+            }
+        }
+    }
+}
+
+// ============================================================================
+// CTF (Capture the Flag)
+// ============================================================================
+
+void World::initFlags() {
+    for (int t = 0; t < 2; t++) {
+        flags[t].basePos = map->flagBasePos(t);
+        flags[t].position = flags[t].basePos;
+        flags[t].carrierId = -1;
+        flags[t].atBase = true;
+        flags[t].returnTimer = 0;
+    }
+}
+
+void World::tickCTF(float dt) {
+    PROFILE_SCOPE("ctf");
+    for (int t = 0; t < 2; t++) {
+        auto& flag = flags[t];
+
+        // If flag is being carried, update position to carrier
+        if (flag.carrierId >= 0) {
+            if (players[flag.carrierId].state != PlayerState::ALIVE) {
+                // Carrier died, drop flag
+                flag.position = players[flag.carrierId].position;
+                flag.carrierId = -1;
+                flag.atBase = false;
+                flag.returnTimer = 30.0f;
+            } else {
+                flag.position = players[flag.carrierId].position;
+                flag.position.y += 2.2f; // Float above carrier's head
+
+                // Check if carrier returned to own base with enemy flag
+                int carrierTeam = players[flag.carrierId].teamId;
+                if (carrierTeam != t) {
+                    // Carrying enemy flag, check if own flag is at base
+                    auto& ownFlag = flags[carrierTeam];
+                    float distToBase = (players[flag.carrierId].position - ownFlag.basePos).length();
+                    if (distToBase < FLAG_CAPTURE_DIST && ownFlag.atBase) {
+                        // SCORE!
+                        teamScores[carrierTeam]++;
+                        logEvent("TEAM %d SCORED! Score: %d-%d\n",
+                               carrierTeam, teamScores[0], teamScores[1]);
+                        // Return flag to base
+                        flag.position = flag.basePos;
+                        flag.carrierId = -1;
+                        flag.atBase = true;
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Flag on ground (not at base): auto-return timer
+        if (!flag.atBase) {
+            flag.returnTimer -= dt;
+            if (flag.returnTimer <= 0) {
+                flag.position = flag.basePos;
+                flag.atBase = true;
+                logEvent("Flag %d returned to base\n", t);
+            }
+        }
+
+        // Check if any player can pick up this flag (enemy team)
+        thread_local std::vector<int> nearby;
+        playerGrid.query(flag.position, FLAG_CAPTURE_DIST, nearby);
+        for (int p : nearby) {
+            if (players[p].state != PlayerState::ALIVE) continue;
+            float d = (players[p].position - flag.position).length();
+            if (d < FLAG_CAPTURE_DIST) {
+                if (players[p].teamId != t) {
+                    // Enemy picks up flag
+                    flag.carrierId = p;
+                    flag.atBase = false;
+                    logEvent("Player %d picked up team %d's flag!\n", p, t);
+                    break;
+                } else if (!flag.atBase) {
+                    // Friendly player returns flag to base
+                    flag.position = flag.basePos;
+                    flag.atBase = true;
+                    logEvent("Player %d returned team %d's flag!\n", p, t);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// ============================================================================
+// Tornados
+// ============================================================================
+
+void World::tickTornados(float dt) {
+    PROFILE_SCOPE("tornados");
+    tornadoSpawnTimer -= dt;
+
+    // Spawn new tornado periodically
+    if (tornadoSpawnTimer <= 0) {
+        tornadoSpawnTimer = randf(45.0f, 90.0f); // Next tornado in 45-90s
+        // Find inactive tornado slot
+        for (int i = 0; i < MAX_TORNADOS; i++) {
+            if (!tornados[i].active) {
+                auto& t = tornados[i];
+                t.active = true;
+                t.position = {randf(-120, 120), 0, randf(-120, 120)};
+                t.velocity = {randf(-3, 3), 0, randf(-3, 3)};
+                t.radius = randf(12, 20);
+                t.innerRadius = 3.0f;
+                t.strength = randf(25, 40);
+                t.damage = randf(3, 8);
+                t.lifetime = 0;
+                t.maxLifetime = randf(30, 60);
+                t.rotation = 0;
+                logEvent("Tornado spawned at %.0f, %.0f\n", t.position.x, t.position.z);
+                break;
+            }
+        }
+    }
+
+    for (int i = 0; i < MAX_TORNADOS; i++) {
+        auto& t = tornados[i];
+        if (!t.active) continue;
+
+        t.lifetime += dt;
+        t.rotation += dt * 4.0f; // Visual rotation
+
+        // Move tornado
+        t.position = t.position + t.velocity * dt;
+        // Wander
+        t.velocity.x += randf(-1, 1) * dt;
+        t.velocity.z += randf(-1, 1) * dt;
+        float hSpeed = sqrtf(t.velocity.x * t.velocity.x + t.velocity.z * t.velocity.z);
+        if (hSpeed > 5.0f) {
+            t.velocity.x = t.velocity.x / hSpeed * 5.0f;
+            t.velocity.z = t.velocity.z / hSpeed * 5.0f;
+        }
+        // Keep in bounds
+        t.position.x = std::clamp(t.position.x, -180.0f, 180.0f);
+        t.position.z = std::clamp(t.position.z, -180.0f, 180.0f);
+
+        // Affect players
+        thread_local std::vector<int> nearby;
+        playerGrid.query(t.position, t.radius, nearby);
+        for (int p : nearby) {
+            if (players[p].state != PlayerState::ALIVE) continue;
+            Vec3 diff = t.position - players[p].position;
+            diff.y = 0;
+            float dist = diff.length();
+
+            if (dist < t.radius && dist > 0.1f) {
+                // Pull toward center
+                Vec3 pullDir = diff * (1.0f / dist);
+                float pullStrength = t.strength * (1.0f - dist / t.radius);
+
+                if (players[p].vehicleId < 0) {
+                    // On foot: pull and damage
+                    players[p].velocity = players[p].velocity + pullDir * pullStrength * dt;
+                    // Add upward force near center
+                    if (dist < t.radius * 0.5f) {
+                        players[p].velocity.y += pullStrength * 0.5f * dt;
+                    }
+                    // Damage in inner radius
+                    if (dist < t.innerRadius) {
+                        players[p].health -= (int)(t.damage * dt);
+                        if (players[p].health <= 0) {
+                            players[p].health = 0;
+                            players[p].state = PlayerState::DEAD;
+                            players[p].respawnTimer = RESPAWN_TIME;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Affect vehicles
+        for (int v2 = 0; v2 < numVehicles; v2++) {
+            auto& veh = vehicles[v2];
+            if (!veh.active) continue;
+            Vec3 diff = t.position - veh.position;
+            diff.y = 0;
+            float dist = diff.length();
+            if (dist < t.radius && dist > 0.1f) {
+                Vec3 pullDir = diff * (1.0f / dist);
+                float pullStrength = t.strength * 0.3f * (1.0f - dist / t.radius);
+                veh.velocity = veh.velocity + pullDir * pullStrength * dt;
+                // Damage vehicles in inner radius
+                if (dist < t.innerRadius) {
+                    veh.health -= (int)(t.damage * 2 * dt);
+                }
+            }
+        }
+
+        // Expire
+        if (t.lifetime > t.maxLifetime) {
+            t.active = false;
+            logEvent("Tornado expired\n");
+        }
+    }
+}
+
+// ============================================================================
+// Vehicles
+// ============================================================================
+
+void World::spawnVehicles() {
+    const auto& spawns = map->vehicleSpawns();
+    numVehicles = std::min((int)spawns.size(), MAX_VEHICLES);
+    for (int i = 0; i < numVehicles; i++) {
+        vehicles[i].type = spawns[i].type;
+        vehicles[i].position = spawns[i].position;
+        vehicles[i].yaw = spawns[i].yaw;
+        vehicles[i].spawnPos = spawns[i].position;
+        vehicles[i].spawnYaw = spawns[i].yaw;
+        vehicles[i].health = getVehicleDef(spawns[i].type).maxHealth;
+        vehicles[i].active = true;
+        vehicles[i].driverId = -1;
+        vehicles[i].turretYaw = 0;
+        vehicles[i].velocity = {0,0,0};
+        vehicles[i].fireCooldown = 0;
+        vehicles[i].respawnTimer = 0;
+    }
+}
+
+void World::enterVehicle(int playerId) {
+    PlayerData& p = players[playerId];
+    if (p.vehicleId >= 0) return; // Already in vehicle
+
+    float bestDist = VEHICLE_ENTER_RANGE;
+    int bestVeh = -1;
+    for (int i = 0; i < numVehicles; i++) {
+        if (!vehicles[i].active || vehicles[i].driverId >= 0) continue;
+        float d = (p.position - vehicles[i].position).length();
+        if (d < bestDist) {
+            bestDist = d;
+            bestVeh = i;
+        }
+    }
+    if (bestVeh >= 0) {
+        p.vehicleId = bestVeh;
+        p.isDriver = true;
+        vehicles[bestVeh].driverId = playerId;
+    }
+}
+
+void World::exitVehicle(int playerId) {
+    PlayerData& p = players[playerId];
+    if (p.vehicleId < 0) return;
+    int vid = p.vehicleId;
+    VehicleType vtype = vehicles[vid].type;
+    vehicles[vid].driverId = -1;
+
+    if (vtype == VehicleType::HELICOPTER || vtype == VehicleType::PLANE) {
+        // Eject: place player below vehicle, give downward velocity (will fall)
+        p.position = vehicles[vid].position;
+        p.position.y = std::max(0.1f, vehicles[vid].position.y - 2.0f);
+        p.velocity = {0, -2.0f, 0}; // Gentle fall
+    } else {
+        // Place player next to ground vehicle
+        p.position = vehicles[vid].position + Vec3{
+            sinf(vehicles[vid].yaw + PI * 0.5f) * 3.0f, 0,
+            cosf(vehicles[vid].yaw + PI * 0.5f) * 3.0f
+        };
+        p.position.y = 0.1f;
+        p.velocity = {0, 0, 0};
+    }
+    p.vehicleId = -1;
+    p.isDriver = false;
+    playerGrid.update(playerId, p.position);
+}
+
+void World::vehicleKill(int victimId, int killerId) {
+    players[victimId].health = 0;
+    players[victimId].state = PlayerState::DEAD;
+    players[victimId].respawnTimer = RESPAWN_TIME;
+    if (players[victimId].vehicleId >= 0) exitVehicle(victimId);
+
+    // Drop flag if carrying
+    for (int t = 0; t < 2; t++) {
+        if (flags[t].carrierId == victimId) {
+            flags[t].carrierId = -1;
+            flags[t].atBase = false;
+            flags[t].returnTimer = 30.0f;
+        }
+    }
+
+    PlayerDiedPacket diePkt;
+    diePkt.victimId = victimId;
+    diePkt.killerId = killerId;
+    diePkt.victimIsBot = players[victimId].isBot;
+    diePkt.killerIsBot = players[killerId].isBot;
+    queueEvent(&diePkt, sizeof(diePkt));
+    killFeed.push_back({killerId, victimId, 5.0f});
+}
+
+void World::vehicleDamage(int victimId, int attackerId, int damage) {
+    players[victimId].health -= damage;
+    // Queue hit notification
+    PlayerHitPacket hitPkt;
+    hitPkt.attackerId = attackerId;
+    hitPkt.victimId = victimId;
+    hitPkt.damage = damage;
+    queueEvent(&hitPkt, sizeof(hitPkt));
+    if (players[victimId].health <= 0) {
+        vehicleKill(victimId, attackerId);
+    }
+}
+
+void World::tickVehicles(float dt) {
+    PROFILE_SCOPE("vehicles");
+    for (int i = 0; i < numVehicles; i++) {
+        auto& v = vehicles[i];
+        if (!v.active) {
+            v.respawnTimer -= dt;
+            if (v.respawnTimer <= 0) {
+                v.position = v.spawnPos;
+                v.yaw = v.spawnYaw;
+                v.pitch = 0;
+                v.health = getVehicleDef(v.type).maxHealth;
+                v.active = true;
+                v.driverId = -1;
+                v.velocity = {0,0,0};
+                v.turretYaw = 0;
+                v.rotorAngle = 0;
+                v.altitude = 0;
+            }
+            continue;
+        }
+
+        if (v.fireCooldown > 0) v.fireCooldown -= dt;
+
+        // Rotor animation for helicopter
+        if (v.type == VehicleType::HELICOPTER) {
+            if (v.driverId >= 0) v.rotorAngle += dt * 25.0f;
+            else v.rotorAngle += dt * 2.0f; // Slow idle spin
+        }
+        // Propeller for plane
+        if (v.type == VehicleType::PLANE && v.driverId >= 0) {
+            v.rotorAngle += dt * 40.0f;
+        }
+
+        if (v.driverId >= 0 && v.driverId < MAX_PLAYERS) {
+            // Get driver's input
+            InputState* input = inputSource[v.driverId];
+
+            if (input) {
+                const auto& def = getVehicleDef(v.type);
+
+                if (v.type == VehicleType::JEEP || v.type == VehicleType::TANK) {
+                    // === GROUND VEHICLE PHYSICS ===
+                    if (input->keys & InputState::KEY_A) v.yaw += def.turnRate * dt;
+                    if (input->keys & InputState::KEY_D) v.yaw -= def.turnRate * dt;
+
+                    float accel = 0;
+                    if (input->keys & InputState::KEY_W) accel = def.speed;
+                    if (input->keys & InputState::KEY_S) accel = -def.speed * 0.5f;
+
+                    Vec3 forward = {sinf(v.yaw), 0, cosf(v.yaw)};
+                    v.velocity = forward * accel;
+
+                    if (v.type == VehicleType::TANK) {
+                        v.turretYaw = input->yaw - v.yaw;
+                    }
+
+                    Vec3 newPos = v.position + v.velocity * dt;
+                    newPos.y = 0.1f;
+                    newPos.x = std::clamp(newPos.x, -190.0f, 190.0f);
+                    newPos.z = std::clamp(newPos.z, -190.0f, 190.0f);
+                    v.position = newPos;
+
+                } else if (v.type == VehicleType::HELICOPTER) {
+                    // === HELICOPTER PHYSICS ===
+                    // A/D = yaw turn
+                    if (input->keys & InputState::KEY_A) v.yaw += def.turnRate * dt;
+                    if (input->keys & InputState::KEY_D) v.yaw -= def.turnRate * dt;
+
+                    // W/S = forward/back
+                    float accel = 0;
+                    if (input->keys & InputState::KEY_W) accel = def.speed;
+                    if (input->keys & InputState::KEY_S) accel = -def.speed * 0.4f;
+
+                    Vec3 forward = {sinf(v.yaw), 0, cosf(v.yaw)};
+                    Vec3 hVel = forward * accel;
+
+                    // Space/Ctrl = ascend/descend (use JUMP/KEY_DOWN)
+                    float vertSpeed = 0;
+                    if (input->keys & InputState::KEY_UP) vertSpeed = 10.0f;
+                    if (input->keys & InputState::KEY_DOWN) vertSpeed = -10.0f;
+
+                    v.velocity = {hVel.x, vertSpeed, hVel.z};
+
+                    Vec3 newPos = v.position + v.velocity * dt;
+                    newPos.y = std::clamp(newPos.y, 0.5f, 80.0f);
+                    newPos.x = std::clamp(newPos.x, -190.0f, 190.0f);
+                    newPos.z = std::clamp(newPos.z, -190.0f, 190.0f);
+                    v.position = newPos;
+
+                    // Tilt based on movement
+                    v.pitch = accel / def.speed * -0.2f;
+
+                } else if (v.type == VehicleType::PLANE) {
+                    // === PLANE PHYSICS ===
+                    // Always moves forward at high speed
+                    float speed = def.speed;
+                    if (input->keys & InputState::KEY_W) speed = def.speed * 1.3f;
+                    if (input->keys & InputState::KEY_S) speed = def.speed * 0.7f;
+
+                    // A/D = yaw/roll
+                    if (input->keys & InputState::KEY_A) v.yaw += def.turnRate * dt;
+                    if (input->keys & InputState::KEY_D) v.yaw -= def.turnRate * dt;
+
+                    // JUMP/DOWN = pitch up/down
+                    if (input->keys & InputState::KEY_UP) v.pitch += 1.5f * dt;
+                    if (input->keys & InputState::KEY_DOWN) v.pitch -= 1.5f * dt;
+                    v.pitch = std::clamp(v.pitch, -0.6f, 0.6f);
+
+                    Vec3 forward = {
+                        sinf(v.yaw) * cosf(v.pitch),
+                        sinf(v.pitch),
+                        cosf(v.yaw) * cosf(v.pitch)
+                    };
+                    v.velocity = forward * speed;
+
+                    Vec3 newPos = v.position + v.velocity * dt;
+                    newPos.y = std::clamp(newPos.y, 5.0f, MAX_ALTITUDE); // Planes can't go below 5m
+                    newPos.x = std::clamp(newPos.x, -190.0f, 190.0f);
+                    newPos.z = std::clamp(newPos.z, -190.0f, 190.0f);
+
+                    // If at boundary, turn around
+                    if (fabsf(newPos.x) > 185.0f || fabsf(newPos.z) > 185.0f) {
+                        v.yaw += PI * dt; // Force turn
+                    }
+                    v.position = newPos;
+                }
+
+                // Update driver position to follow vehicle
+                players[v.driverId].position = v.position;
+                players[v.driverId].position.y = v.position.y + 1.0f;
+                playerGrid.update(v.driverId, players[v.driverId].position);
+                players[v.driverId].yaw = input->yaw;
+                players[v.driverId].pitch = input->pitch;
+
+                // === VEHICLE SHOOTING ===
+                if ((input->keys & InputState::KEY_SHOOT) && def.cannonDamage > 0 && v.fireCooldown <= 0) {
+                    v.fireCooldown = def.cannonRate;
+
+                    float aimYaw, aimPitch;
+                    Vec3 origin;
+
+                    if (v.type == VehicleType::TANK) {
+                        aimYaw = v.yaw + v.turretYaw;
+                        aimPitch = input->pitch;
+                        origin = v.position + Vec3{0, 2.5f, 0};
+                    } else {
+                        // Helicopters/planes aim where driver looks
+                        aimYaw = input->yaw;
+                        aimPitch = input->pitch;
+                        origin = v.position + Vec3{0, 0.5f, 0};
+                    }
+
+                    Vec3 cannonDir = {
+                        sinf(aimYaw) * cosf(aimPitch),
+                        sinf(aimPitch),
+                        cosf(aimYaw) * cosf(aimPitch)
+                    };
+                    cannonDir = cannonDir.normalize();
+                    origin = origin + cannonDir * 3.0f;
+
+                    float pDist = 500.0f;
+                    int hitP = GameMap::raycastPlayers(origin, cannonDir, 500.0f,
+                                                      players, playerGrid, v.driverId, pDist);
+                    Vec3 wallHit;
+                    float wallDist;
+                    bool hitWall = map->raycast(origin, cannonDir, 500.0f, wallHit, wallDist);
+
+                    if (hitP >= 0 && (!hitWall || pDist < wallDist)) {
+                        vehicleDamage(hitP, v.driverId, def.cannonDamage);
+                        logEvent("Vehicle cannon hit! %s -> %s for %d dmg\n",
+                               profiles[v.driverId].name, profiles[hitP].name, def.cannonDamage);
+                    }
+                }
+
+                // Run over players (ground vehicles only)
+                if (v.type == VehicleType::JEEP || v.type == VehicleType::TANK) {
+                    float speed = v.velocity.length();
+                    if (speed > 5.0f) {
+                        thread_local std::vector<int> nearby;
+                        playerGrid.query(v.position, 2.5f, nearby);
+                        for (int p : nearby) {
+                            if (p == v.driverId) continue;
+                            if (players[p].state != PlayerState::ALIVE) continue;
+                            if (players[p].vehicleId >= 0) continue;
+                            // Don't run over teammates
+                            if (players[p].teamId == players[v.driverId].teamId) continue;
+                            float d = (players[p].position - v.position).length();
+                            if (d < 2.5f) {
+                                int dmg = (int)(speed * 3.0f);
+                                players[p].velocity = v.velocity * 0.5f + Vec3{0, 5, 0};
+                                vehicleDamage(p, v.driverId, dmg);
+                            }
+                        }
+                    }
+                }
+            }
+        } else {
+            // No driver
+            if (v.type == VehicleType::HELICOPTER) {
+                // Slowly descend
+                v.velocity = {0, -3.0f, 0};
+                v.position = v.position + v.velocity * dt;
+                if (v.position.y <= 0.5f) {
+                    v.position.y = 0.5f;
+                    v.velocity = {0,0,0};
+                }
+            } else if (v.type == VehicleType::PLANE) {
+                // Plane with no driver crashes
+                v.velocity.y -= 15.0f * dt;
+                v.position = v.position + v.velocity * dt;
+                if (v.position.y <= 0.1f) {
+                    v.health = 0; // Crash
+                }
+            } else {
+                v.velocity = v.velocity * 0.95f;
+                if (v.velocity.lengthSq() < 0.01f) v.velocity = {0,0,0};
+            }
+        }
+
+        // Vehicle destruction
+        if (v.health <= 0) {
+            v.active = false;
+            v.respawnTimer = 30.0f;
+            if (v.driverId >= 0) {
+                players[v.driverId].health = 0;
+                players[v.driverId].state = PlayerState::DEAD;
+                players[v.driverId].respawnTimer = RESPAWN_TIME;
+                exitVehicle(v.driverId);
+            }
+        }
+    }
+}
+
+// ============================================================================
+// AI Bot Logic
+// ============================================================================
+
+bool World::canSeePlayer(int botId, int targetId) const {
+    Vec3 from = players[botId].position;
+    from.y += PLAYER_EYE_HEIGHT;
+    Vec3 to = players[targetId].position;
+    to.y += PLAYER_HEIGHT * 0.5f;
+
+    Vec3 dir = to - from;
+    float dist = dir.length();
+    if (dist < 0.1f) return true;
+    dir = dir * (1.0f / dist);
+    if (!map->potentiallyVisible(from, to)) return false; // Static walls in the way
+
+    Vec3 hitPt;
+    float hitDist;
+    if (map->raycast(from, dir, dist, hitPt, hitDist)) {
+        return hitDist > dist - 0.5f; // Wall is behind target
+    }
+    return true; // No wall in the way
+}
+
+int World::findNearestVisibleEnemy(int botId, float maxRange) const {
+    struct Candidate { float dist; int id; };
+    thread_local std::vector<int> nearby;
+    thread_local std::vector<Candidate> candidates;
+
+    playerGrid.query(players[botId].position, maxRange, nearby);
+    candidates.clear();
+    for (int i : nearby) {
+        if (i == botId) continue;
+        if (players[i].state != PlayerState::ALIVE) continue;
+        // Don't target teammates
+        if (players[i].teamId == players[botId].teamId) continue;
+        float d = (players[i].position - players[botId].position).length();
+        if (d < maxRange) candidates.push_back({d, i});
+    }
+
+    // Nearest first (lower id on ties), so only the line-of-sight checks up
+    // to the first visible enemy are paid for
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.dist < b.dist || (a.dist == b.dist && a.id < b.id);
+    });
+    for (const auto& c : candidates) {
+        if (canSeePlayer(botId, c.id)) return c.id;
+    }
+    return -1;
+}
+
+// Helper: move bot along a path, with jump detection
+void World::botFollowPath(BotData& bot, PlayerData& p, float dt) const {
+    const auto& waypoints = map->waypoints();
+
+    // Advance through path
+    if (bot.pathIndex < (int)bot.path.size()) {
+        int wpIdx = bot.path[bot.pathIndex];
+        Vec3 wp = waypoints[wpIdx].position;
+        Vec3 toWP = wp - p.position;
+        float distXZ = sqrtf(toWP.x * toWP.x + toWP.z * toWP.z);
+        float distY = wp.y - p.position.y;
+
+        if (distXZ < 2.0f && fabsf(distY) < 2.0f) {
+            bot.pathIndex++;
+            if (bot.pathIndex >= (int)bot.path.size()) {
+                bot.path.clear();
+                bot.pathIndex = 0;
+            }
+            return;
+        }
+
+        // Face waypoint
+        float targetYaw = atan2f(toWP.x, toWP.z);
+        p.yaw = targetYaw;
+        bot.input.yaw = p.yaw;
+        bot.input.pitch = 0;
+        bot.input.keys |= InputState::KEY_W;
+
+        // Jump if waypoint is above us (stairs, crates, towers)
+        if (distY > 0.5f && bot.jumpCooldown <= 0) {
+            bot.input.keys |= InputState::KEY_JUMP;
+            bot.jumpCooldown = 0.4f;
+        }
+
+        // Jump over obstacles detected ahead
+        float obstacleH = 0;
+        if (map->hasObstacleAhead(p.position, p.yaw, 1.5f, obstacleH)) {
+            if (obstacleH < 2.0f && bot.jumpCooldown <= 0) {
+                bot.input.keys |= InputState::KEY_JUMP;
+                bot.jumpCooldown = 0.4f;
+            }
+        }
+    }
+}
+
+// Compute A* path from bot's current position to a target position
+void World::botPathfindTo(BotData& bot, const Vec3& target) const {
+    int startWP = findNearestWaypointToPos(*map, players[bot.playerId].position);
+    int goalWP = findNearestWaypointToPos(*map, target);
+    findBotPath(startWP, goalWP, bot.path);
+    bot.pathIndex = 0;
+    bot.pathAge = 0;
+}
+
+static uint32_t botRand(BotData& bot) {
+    uint32_t x = bot.rngState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return bot.rngState = x;
+}
+
+// Serial part of the bot update: respawning writes shared world state
+void World::prepareBotAI(BotData& bot, float dt) {
+    int id = bot.playerId;
+    PlayerData& p = players[id];
+    if (p.state == PlayerState::DEAD) {
+        p.respawnTimer -= dt;
+        if (p.respawnTimer <= 0) {
+            spawnPlayer(id);
+            bot.aiState = AIState::PATROL;
+            bot.path.clear();
+            bot.pathIndex = 0;
+        }
+    }
+}
+
+// Pick which bots think this tick. Each bot's tier comes from its distance
+// to the nearest human; a bot is due once that many ticks have passed since
+// its last think. With a budget, the most overdue due bots go first (nearer
+// tiers, then lower index, on ties) and the rest stay due.
+void World::scheduleBotAI() {
+    Vec3 humans[MAX_PLAYERS];
+    int numHumans = 0;
+    for (int a = 0; a < numActive; a++) {
+        const PlayerData& h = players[activeIds[a]];
+        if (!h.isBot) humans[numHumans++] = h.position;
+    }
+
+    int due[MAX_PLAYERS];
+    int numDue = 0;
+    for (int i = 0; i < numBots; i++) {
+        BotData& bot = bots[i];
+        bot.thinkNow = false;
+        bot.ticksSinceThink++;
+        if (players[bot.playerId].state != PlayerState::ALIVE) continue;
+
+        float nearestSq = 1e30f;
+        for (int h = 0; h < numHumans; h++)
+            nearestSq = std::min(nearestSq, (humans[h] - players[bot.playerId].position).lengthSq());
+        int tier = nearestSq < BOT_LOD_NEAR_DIST * BOT_LOD_NEAR_DIST ? 0
+                 : nearestSq < BOT_LOD_MID_DIST * BOT_LOD_MID_DIST ? 1 : 2;
+        if (bot.aiState == AIState::CHASE || bot.aiState == AIState::ATTACK ||
+            bot.aiState == AIState::RETREAT) {
+            tier = std::max(0, tier - 1);
+        }
+        const int intervals[3] = {1, BOT_THINK_MID, BOT_THINK_FAR};
+        bot.thinkInterval = intervals[tier];
+        if (bot.ticksSinceThink >= bot.thinkInterval) due[numDue++] = i;
+    }
+
+    if (aiThinkBudget > 0 && numDue > aiThinkBudget) {
+        std::sort(due, due + numDue, [this](int a, int b) {
+            int lateA = bots[a].ticksSinceThink - bots[a].thinkInterval;
+            int lateB = bots[b].ticksSinceThink - bots[b].thinkInterval;
+            if (lateA != lateB) return lateA > lateB;
+            if (bots[a].thinkInterval != bots[b].thinkInterval)
+                return bots[a].thinkInterval < bots[b].thinkInterval;
+            return a < b;
+        });
+        numDue = aiThinkBudget;
+    }
+    for (int k = 0; k < numDue; k++) {
+        bots[due[k]].thinkNow = true;
+        bots[due[k]].ticksSinceThink = 0;
+    }
+}
+
+// A tick between thinks: carry on with what the last think decided. A bot
+// with a path keeps following it; otherwise it holds its movement keys,
+// aim and trigger, so a bot thinking every few ticks fires as often as one
+// thinking every tick. A jump stays held until the next think (it only
+// fires on the ground).
+void World::steerBot(BotData& bot, PlayerData& p, float dt) const {
+    uint16_t jump = bot.input.keys & InputState::KEY_JUMP;
+    if (!bot.path.empty() && bot.aiState != AIState::ATTACK) {
+        bot.input = InputState{};
+        botFollowPath(bot, p, dt); // Faces along the path: no shooting
+        bot.input.keys |= jump;
+    } else {
+        bot.input.keys &= InputState::KEY_W | InputState::KEY_A | InputState::KEY_S | InputState::KEY_D |
+                          InputState::KEY_SHOOT | jump;
+    }
+}
+
+// Perception and decision making. Runs on the AI workers against the world
+// as it stands after prepareBotAI: reads shared state, writes only `bot`.
+// The bot steers a private copy of its player; applyBotAI publishes the aim.
+// Timers and stuck detection run every tick, the rest only on think ticks.
+void World::updateBotAI(BotData& bot, float dt) const {
+    int id = bot.playerId;
+    PlayerData p = players[id];
+    if (p.state != PlayerState::ALIVE) return;
+
+    const auto& waypoints = map->waypoints();
+    bot.stateTimer -= dt;
+    if (bot.aiState == AIState::ATTACK && bot.reactionTimer > 0) bot.reactionTimer -= dt;
+    bot.pathAge += dt;
+    if (bot.jumpCooldown > 0) bot.jumpCooldown -= dt;
+    if (bot.combatJumpTimer > 0) bot.combatJumpTimer -= dt;
+    if (bot.strafeTimer > 0) bot.strafeTimer -= dt;
+
+    // Stuck detection
+    float moved = (p.position - bot.lastPos).length();
+    if (moved < 0.05f * dt) {
+        bot.stuckTimer += dt;
+    } else {
+        bot.stuckTimer = 0;
+    }
+    bot.lastPos = p.position;
+
+    // Unstick: try jumping first, then repath
+    bool unstickJump = bot.stuckTimer > 0.5f && bot.jumpCooldown <= 0;
+    if (unstickJump) bot.jumpCooldown = 0.4f;
+
+    if (!bot.thinkNow) {
+        PROFILE_SCOPE("bot_steer");
+        steerBot(bot, p, dt);
+        if (unstickJump) bot.input.keys |= InputState::KEY_JUMP;
+        bot.aimYaw = p.yaw;
+        bot.aimPitch = p.pitch;
+        return;
+    }
+    PROFILE_SCOPE("bot_think");
+
+    if (bot.stuckTimer > 1.5f) {
+        // Repath to a random waypoint
+        int randWP = botRand(bot) % waypoints.size();
+        findBotPath(map->findNearestWaypoint(p.position), randWP, bot.path);
+        bot.pathIndex = 0;
+        bot.stuckTimer = 0;
+    }
+
+    // Build input
+    bot.input = InputState{};
+    if (unstickJump) bot.input.keys |= InputState::KEY_JUMP;
+
+    switch (bot.aiState) {
+        case AIState::PATROL: {
+            if (waypoints.empty()) break;
+
+            // Generate path if we don't have one
+            if (bot.path.empty() || bot.pathAge > 8.0f) {
+                // Pick a random distant waypoint
+                int curWP = map->findNearestWaypoint(p.position);
+                int targetWP = botRand(bot) % waypoints.size();
+                // Prefer waypoints that are far away for interesting patrol routes
+                for (int attempt = 0; attempt < 3; attempt++) {
+                    int candidate = botRand(bot) % waypoints.size();
+                    if ((waypoints[candidate].position - p.position).lengthSq() >
+                        (waypoints[targetWP].position - p.position).lengthSq()) {
+                        targetWP = candidate;
+                    }
+                }
+                findBotPath(curWP, targetWP, bot.path);
+                bot.pathIndex = 0;
+                bot.pathAge = 0;
+            }
+
+            // Follow path
+            botFollowPath(bot, p, dt);
+
+            // Check for enemies
+            int enemy = findNearestVisibleEnemy(id, 40.0f);
+            if (enemy >= 0) {
+                bot.targetPlayerId = enemy;
+                bot.aiState = AIState::CHASE;
+                bot.reactionTimer = bot.reactionDelay;
+                bot.stateTimer = 10.0f;
+                bot.path.clear();
+            }
+
+            // Check for weapon pickups if only have pistol
+            if (p.currentWeapon == WeaponType::PISTOL) {
+                float bestPickupDist = 30.0f;
+                Vec3 bestPickupPos;
+                bool foundPickup = false;
+                for (const auto& wp2 : pickups) {
+                    if (!wp2.active) continue;
+                    float d = (p.position - wp2.position).length();
+                    if (d < bestPickupDist) {
+                        bestPickupDist = d;
+                        bestPickupPos = wp2.position;
+                        foundPickup = true;
+                    }
+                }
+                if (foundPickup) {
+                    botPathfindTo(bot, bestPickupPos);
+                    bot.targetPos = bestPickupPos;
+                    bot.aiState = AIState::PICKUP_WEAPON;
+                    bot.stateTimer = 12.0f;
+                }
+            }
+            break;
+        }
+
+        case AIState::CHASE: {
+            int tid = bot.targetPlayerId;
+            if (tid < 0 || tid >= MAX_PLAYERS || players[tid].state != PlayerState::ALIVE) {
+                bot.aiState = AIState::PATROL;
+                bot.path.clear();
+                break;
+            }
+
+            Vec3 toEnemy = players[tid].position - p.position;
+            float dist = toEnemy.length();
+
+            // Repath to enemy periodically
+            if (bot.path.empty() || bot.pathAge > 2.0f) {
+                botPathfindTo(bot, players[tid].position);
+            }
+
+            // Face enemy
+            float targetYaw = atan2f(toEnemy.x, toEnemy.z);
+            p.yaw = targetYaw;
+
+            // Aim at enemy with jitter
+            float hDist = sqrtf(toEnemy.x * toEnemy.x + toEnemy.z * toEnemy.z);
+            float targetPitch = atan2f(toEnemy.y + PLAYER_HEIGHT * 0.5f - PLAYER_EYE_HEIGHT, hDist);
+            p.pitch = targetPitch + botRandf(bot, -bot.aimJitter, bot.aimJitter);
+
+            bot.input.yaw = p.yaw + botRandf(bot, -bot.aimJitter, bot.aimJitter);
+            bot.input.pitch = p.pitch;
+
+            if (dist < getWeaponDef(p.currentWeapon).range * 0.8f && canSeePlayer(id, tid)) {
+                bot.aiState = AIState::ATTACK;
+                bot.stateTimer = 5.0f;
+                bot.strafeTimer = 0;
+                bot.strafeDir = botRandf(bot) < 0.5f ? 1.0f : -1.0f;
+            } else {
+                // Follow path toward enemy
+                botFollowPath(bot, p, dt);
+                // Override yaw to face movement direction while chasing
+                if (!bot.path.empty() && bot.pathIndex < (int)bot.path.size()) {
+                    Vec3 wpPos = waypoints[bot.path[bot.pathIndex]].position;
+                    Vec3 toWP = wpPos - p.position;
+                    p.yaw = atan2f(toWP.x, toWP.z);
+                    bot.input.yaw = p.yaw;
+                }
+            }
+
+            // Jump while chasing to be unpredictable
+            if (bot.combatJumpTimer <= 0 && botRandf(bot) < 0.01f) {
+                bot.input.keys |= InputState::KEY_JUMP;
+                bot.combatJumpTimer = botRandf(bot, 1.0f, 3.0f);
+            }
+
+            if (bot.stateTimer <= 0 || (!canSeePlayer(id, tid) && dist > 20.0f)) {
+                bot.aiState = AIState::PATROL;
+                bot.path.clear();
+            }
+            break;
+        }
+
+        case AIState::ATTACK: {
+            int tid = bot.targetPlayerId;
+            if (tid < 0 || tid >= MAX_PLAYERS || players[tid].state != PlayerState::ALIVE) {
+                bot.aiState = AIState::PATROL;
+                bot.path.clear();
+                break;
+            }
+
+            Vec3 toEnemy = players[tid].position - p.position;
+            float dist = toEnemy.length();
+
+            // Face and aim at enemy
+            float targetYaw = atan2f(toEnemy.x, toEnemy.z);
+            p.yaw = targetYaw + botRandf(bot, -bot.aimJitter, bot.aimJitter);
+            float hDist = sqrtf(toEnemy.x * toEnemy.x + toEnemy.z * toEnemy.z);
+            float targetPitch = atan2f(toEnemy.y + PLAYER_HEIGHT * 0.5f - PLAYER_EYE_HEIGHT, hDist);
+            p.pitch = targetPitch + botRandf(bot, -bot.aimJitter, bot.aimJitter);
+
+            bot.input.yaw = p.yaw;
+            bot.input.pitch = p.pitch;
+
+            // Advanced strafing: change direction every 1-3 seconds
+            if (bot.strafeTimer <= 0) {
+                bot.strafeDir = -bot.strafeDir;
+                bot.strafeTimer = botRandf(bot, 0.8f, 2.5f);
+                // Sometimes add forward/backward movement
+                if (botRandf(bot) < 0.3f) {
+                    bot.input.keys |= (dist > 10.0f) ? InputState::KEY_W : InputState::KEY_S;
+                }
+            }
+            if (bot.strafeDir > 0) {
+                bot.input.keys |= InputState::KEY_D;
+            } else {
+                bot.input.keys |= InputState::KEY_A;
+            }
+
+            // Combat jumping - jump to dodge
+            if (bot.combatJumpTimer <= 0 && botRandf(bot) < 0.03f) {
+                bot.input.keys |= InputState::KEY_JUMP;
+                bot.combatJumpTimer = botRandf(bot, 0.8f, 2.0f);
+            }
+
+            // Obstacle jump while strafing
+            float obstH = 0;
+            if (map->hasObstacleAhead(p.position, p.yaw + (bot.strafeDir > 0 ? PI * 0.5f : -PI * 0.5f), 1.0f, obstH)) {
+                if (obstH < 2.0f && bot.jumpCooldown <= 0) {
+                    bot.input.keys |= InputState::KEY_JUMP;
+                    bot.jumpCooldown = 0.4f;
+                }
+            }
+
+            // Shoot (after reaction delay, with miss chance)
+            if (bot.reactionTimer <= 0 && canSeePlayer(id, tid)) {
+                if (botRandf(bot) < 0.6f) { // 60% chance to actually pull trigger each tick
+                    bot.input.keys |= InputState::KEY_SHOOT;
+                }
+            }
+
+            // Retreat if low health
+            if (p.health < 30) {
+                bot.aiState = AIState::RETREAT;
+                bot.stateTimer = 5.0f;
+                bot.path.clear();
+                // Path away from enemy
+                Vec3 fleeTarget = p.position + (p.position - players[tid].position).normalize() * 20.0f;
+                botPathfindTo(bot, fleeTarget);
+                break;
+            }
+
+            // If enemy out of range or dead
+            if (dist > getWeaponDef(p.currentWeapon).range || bot.stateTimer <= 0) {
+                bot.aiState = AIState::CHASE;
+                bot.stateTimer = 10.0f;
+                bot.path.clear();
+            }
+
+            if (!canSeePlayer(id, tid)) {
+                bot.aiState = AIState::CHASE;
+                bot.stateTimer = 5.0f;
+                // Path to enemy's last known position
+                botPathfindTo(bot, players[tid].position);
+            }
+            break;
+        }
+
+        case AIState::RETREAT: {
+            int tid = bot.targetPlayerId;
+
+            // Follow retreat path
+            if (!bot.path.empty()) {
+                botFollowPath(bot, p, dt);
+            } else if (tid >= 0 && tid < MAX_PLAYERS && players[tid].state == PlayerState::ALIVE) {
+                // Generate retreat path away from enemy
+                Vec3 away = p.position - players[tid].position;
+                away.y = 0;
+                if (away.lengthSq() > 0.1f) {
+                    Vec3 fleeTarget = p.position + away.normalize() * 25.0f;
+                    botPathfindTo(bot, fleeTarget);
+                }
+            }
+
+            // Jump while retreating for evasion
+            if (bot.combatJumpTimer <= 0 && botRandf(bot) < 0.04f) {
+                bot.input.keys |= InputState::KEY_JUMP;
+                bot.combatJumpTimer = botRandf(bot, 0.5f, 1.5f);
+            }
+
+            // Shoot back while retreating if enemy visible
+            if (tid >= 0 && tid < MAX_PLAYERS && players[tid].state == PlayerState::ALIVE) {
+                Vec3 toEnemy = players[tid].position - p.position;
+                if (canSeePlayer(id, tid)) {
+                    // Aim and shoot while running (very inaccurate)
+                    float aimYaw = atan2f(toEnemy.x, toEnemy.z);
+                    bot.input.yaw = aimYaw + botRandf(bot, -bot.aimJitter * 3, bot.aimJitter * 3);
+                    float hDist = sqrtf(toEnemy.x * toEnemy.x + toEnemy.z * toEnemy.z);
+                    bot.input.pitch = atan2f(toEnemy.y + PLAYER_HEIGHT * 0.5f - PLAYER_EYE_HEIGHT, hDist);
+                    if (botRandf(bot) < 0.25f) { // Rarely shoot while retreating
+                        bot.input.keys |= InputState::KEY_SHOOT;
+                    }
+                }
+            }
+
+            if (bot.stateTimer <= 0 || p.health > 60) {
+                bot.aiState = AIState::PATROL;
+                bot.path.clear();
+            }
+            break;
+        }
+
+        case AIState::PICKUP_WEAPON: {
+            // Follow path to weapon pickup
+            if (!bot.path.empty()) {
+                botFollowPath(bot, p, dt);
+            } else {
+                // Direct movement as fallback
+                Vec3 toTarget = bot.targetPos - p.position;
+                toTarget.y = 0;
+                if (toTarget.lengthSq() > 0.1f) {
+                    float targetYaw = atan2f(toTarget.x, toTarget.z);
+                    p.yaw = targetYaw;
+                    bot.input.yaw = p.yaw;
+                    bot.input.pitch = 0;
+                    bot.input.keys |= InputState::KEY_W;
+                }
+            }
+
+            Vec3 toTarget = bot.targetPos - p.position;
+            float dist = toTarget.length();
+
+            if (dist < 1.5f || bot.stateTimer <= 0 || p.currentWeapon != WeaponType::PISTOL) {
+                bot.aiState = AIState::PATROL;
+                bot.path.clear();
+                break;
+            }
+
+            // If see enemy while going for weapon, fight instead
+            int enemy = findNearestVisibleEnemy(id, 20.0f);
+            if (enemy >= 0) {
+                bot.targetPlayerId = enemy;
+                bot.aiState = AIState::ATTACK;
+                bot.reactionTimer = bot.reactionDelay;
+                bot.stateTimer = 5.0f;
+                bot.path.clear();
+            }
+            break;
+        }
+    }
+
+    bot.aimYaw = p.yaw;
+    bot.aimPitch = p.pitch;
+}
+
+void World::applyBotAI(BotData& bot) {
+    PlayerData& p = players[bot.playerId];
+    if (p.state != PlayerState::ALIVE) return;
+    p.yaw = bot.aimYaw;
+    p.pitch = bot.aimPitch;
+}
+
+void World::spawnBots(int count) {
+    for (int i = 0; i < count; i++) {
+        int slot = findFreeSlot();
+        if (slot < 0) break;
+
+        players[slot] = PlayerData{};
+        players[slot].isBot = true;
+        // Assign team (alternating)
+        players[slot].teamId = nextTeam;
+        nextTeam = (nextTeam + 1) % 2;
+        // Random class
+        players[slot].playerClass = (PlayerClass)(nextRand() % (int)PlayerClass::COUNT);
+        const auto& cdef = getClassDef(players[slot].playerClass);
+        snprintf(profiles[slot].name, sizeof(profiles[slot].name), "Bot_%d", i + 1);
+        players[slot].currentWeapon = cdef.primaryWeapon;
+        players[slot].ammo = getWeaponDef(cdef.primaryWeapon).magSize;
+        spawnPlayer(slot);
+
+        bots[i].playerId = slot;
+        inputSource[slot] = &bots[i].input;
+        bots[i].aiState = AIState::PATROL;
+        bots[i].currentWaypoint = nextRand() % map->waypoints().size();
+        bots[i].targetPos = map->waypoints()[bots[i].currentWaypoint].position;
+        bots[i].reactionDelay = randf(0.6f, 1.5f);
+        bots[i].aimJitter = randf(0.06f, 0.14f);
+        bots[i].lastPos = players[slot].position;
+        bots[i].rngState = (nextRand() << 1) | 1;
+        bots[i].ticksSinceThink = i % BOT_THINK_FAR; // Stagger first thinks
+
+        logEvent("Spawned bot '%s' at slot %d\n", profiles[slot].name, slot);
+    }
+    numBots = count;
+    rebuildActive();
+}
+
+// ============================================================================
+// State Save & Restore
+// ============================================================================
+
+// One field list drives both directions, so save and load cannot drift
+// apart. Only trivially copyable values are transferred as raw bytes.
+struct StateWriter {
+    std::vector<uint8_t>& out;
+
+    template <class T> void io(const T& v) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const uint8_t* bytes = (const uint8_t*)&v;
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+    template <class T> void io(const std::vector<T>& v) {
+        io((uint32_t)v.size());
+        for (const T& e : v) io(e);
+    }
+};
+
+struct StateReader {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool           ok = true;
+
+    template <class T> void io(T& v) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if ((size_t)(end - p) < sizeof(T)) { ok = false; return; }
+        memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+    }
+    template <class T> void io(std::vector<T>& v) {
+        uint32_t n = 0;
+        io(n);
+        if (!ok || n > (size_t)(end - p)) { ok = false; return; } // Every element is at least a byte
+        v.resize(n);
+        for (T& e : v) io(e);
+    }
+};
+
+template <class Archive> void World::transferState(Archive& ar) {
+    ar.io(serverTick);
+    ar.io(rng_);
+    ar.io(players);
+    ar.io(profiles);
+    ar.io(numBots);
+    for (int i = 0; i < numBots && i < MAX_PLAYERS; i++) {
+        BotData& b = bots[i];
+        ar.io(b.playerId);
+        ar.io(b.aiState);
+        ar.io(b.targetPos);
+        ar.io(b.targetPlayerId);
+        ar.io(b.stateTimer);
+        ar.io(b.reactionDelay);
+        ar.io(b.reactionTimer);
+        ar.io(b.currentWaypoint);
+        ar.io(b.lastPos);
+        ar.io(b.stuckTimer);
+        ar.io(b.aimJitter);
+        ar.io(b.input);
+        ar.io(b.path);
+        ar.io(b.pathIndex);
+        ar.io(b.pathAge);
+        ar.io(b.jumpCooldown);
+        ar.io(b.combatJumpTimer);
+        ar.io(b.strafeDir);
+        ar.io(b.strafeTimer);
+        ar.io(b.rngState);
+        ar.io(b.aimYaw);
+        ar.io(b.aimPitch);
+        ar.io(b.thinkInterval);
+        ar.io(b.ticksSinceThink);
+    }
+    ar.io(vehicles);
+    ar.io(numVehicles);
+    ar.io(teamScores);
+    ar.io(flags);
+    ar.io(nextTeam);
+    ar.io(tornados);
+    ar.io(tornadoSpawnTimer);
+    ar.io(killFeed);
+    ar.io(pickups);
+    ar.io(hitboxes);
+    ar.io(viewTick);
+    ar.io(viewTickFrac);
+}
+
+void World::saveState(std::vector<uint8_t>& out) const {
+    StateWriter ar{out};
+    const_cast<World*>(this)->transferState(ar); // The writer only reads
+}
+
+// Every count, index and enum a loaded state holds is in range, so the
+// simulation can use them unchecked
+static bool validState(const World& w) {
+    auto inRange = [](int v, int lo, int end) { return v >= lo && v < end; };
+    const int numWaypoints = (int)w.map->waypoints().size();
+    if (!inRange(w.numBots, 0, MAX_PLAYERS + 1) || !inRange(w.numVehicles, 0, MAX_VEHICLES + 1) ||
+        !inRange(w.nextTeam, 0, NUM_TEAMS) || w.pickups.size() != w.map->weaponPickups().size()) {
+        return false;
+    }
+    for (const PlayerData& p : w.players) {
+        if (!inRange((int)p.state, 0, (int)PlayerState::SPECTATING + 1) || !inRange(p.teamId, 0, NUM_TEAMS) ||
+            !inRange(p.vehicleId, -1, w.numVehicles) || !inRange((int)p.currentWeapon, 0, (int)WeaponType::COUNT) ||
+            !inRange((int)p.playerClass, 0, (int)PlayerClass::COUNT)) {
+            return false;
+        }
+    }
+    for (int i = 0; i < w.numBots; i++) {
+        const BotData& b = w.bots[i];
+        if (!inRange(b.playerId, 0, MAX_PLAYERS) || !inRange(b.targetPlayerId, -1, MAX_PLAYERS) ||
+            !inRange((int)b.aiState, 0, (int)AIState::PICKUP_WEAPON + 1) ||
+            !inRange(b.currentWaypoint, 0, numWaypoints) || b.pathIndex < 0 ||
+            !inRange(b.path.count, 0, BotPath::CAPACITY + 1)) {
+            return false;
+        }
+        for (int n = 0; n < b.path.count; n++)
+            if (!inRange(b.path.nodes[n], 0, numWaypoints)) return false;
+    }
+    for (int i = 0; i < w.numVehicles; i++) {
+        const VehicleData& v = w.vehicles[i];
+        if (!inRange((int)v.type, 0, (int)VehicleType::COUNT) || !inRange(v.driverId, -1, MAX_PLAYERS)) return false;
+    }
+    for (const FlagData& f : w.flags)
+        if (!inRange(f.carrierId, -1, MAX_PLAYERS)) return false;
+    for (const WeaponPickup& wp : w.pickups)
+        if (!inRange((int)wp.type, 0, (int)WeaponType::COUNT)) return false;
+    return true;
+}
+
+bool World::loadState(const uint8_t* data, size_t len) {
+    // Decode into a copy, so a state that fails the checks changes nothing
+    auto loaded = std::make_unique<World>(*this);
+    StateReader ar{data, data + len};
+    loaded->transferState(ar);
+    if (!ar.ok || !validState(*loaded)) return false;
+    *this = std::move(*loaded);
+
+    rebuildActive();
+    for (int i = 0; i < MAX_PLAYERS; i++) inputSource[i] = nullptr;
+    for (int i = 0; i < numBots; i++) inputSource[bots[i].playerId] = &bots[i].input;
+    clearEvents();
+    return true;
+}
+
+// ============================================================================
+// Setup & Tick
+// ============================================================================
+
+void World::init(uint32_t worldSeed) {
+    seed = worldSeed;
+    rng_ = seed ? seed : 1;
+    if (!map || map->visibility().empty()) {
+        auto own = map ? std::make_shared<GameMap>(*map) : std::make_shared<GameMap>();
+        if (!map) own->buildArcticMap();
+        own->bakeVisibility();
+        map = own;
+    }
+    pickups = map->weaponPickups();
+    buildNextHopTable();
+    playerGrid.init(200.0f);
+
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        players[i].state = PlayerState::DISCONNECTED;
+        viewTick[i] = NO_SNAPSHOT_ACK;
+    }
+    rebuildActive();
+    spawnVehicles();
+    initFlags();
+}
+
+void World::simulate() {
+    // --- Player broadphase (kept current by update() on every move) ---
+    playerGrid.build(players, MAX_PLAYERS);
+
+    // --- Update AI bots: respawn serially, think in parallel, apply in order ---
+    {
+        PROFILE_SCOPE("bots");
+        for (int i = 0; i < numBots; i++) {
+            prepareBotAI(bots[i], TICK_DURATION);
+        }
+        scheduleBotAI();
+        if (aiPool) {
+            aiPool->run(numBots, [this](int i) { updateBotAI(bots[i], TICK_DURATION); });
+        } else {
+            for (int i = 0; i < numBots; i++) updateBotAI(bots[i], TICK_DURATION);
+        }
+        for (int i = 0; i < numBots; i++) {
+            applyBotAI(bots[i]);
+        }
+    }
+
+    tickPlayers(TICK_DURATION);
+    tickVehicles(TICK_DURATION);
+    processPickups(TICK_DURATION);
+    tickCTF(TICK_DURATION);
+    tickTornados(TICK_DURATION);
+
+    // --- Update kill feed timers ---
+    for (auto it = killFeed.begin(); it != killFeed.end();) {
+        it->timer -= TICK_DURATION;
+        if (it->timer <= 0) it = killFeed.erase(it);
+        else ++it;
+    }
+
+    recordHitboxes();
+}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include "common.h"
+#include "game.h"
+#include "network.h"
+#include "job_pool.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// ============================================================================
+// Bots
+// ============================================================================
+
+enum class AIState : uint8_t {
+    PATROL, CHASE, ATTACK, RETREAT, PICKUP_WEAPON
+};
+
+// Waypoint path stored inline, so bots never touch the heap. Longer paths
+// keep their first CAPACITY nodes; the bot repaths when it runs out.
+struct BotPath {
+    static constexpr int CAPACITY = 64;
+    int16_t nodes[CAPACITY];
+    int     count = 0;
+
+    int  size() const { return count; }
+    bool empty() const { return count == 0; }
+    void clear() { count = 0; }
+    int  operator[](int i) const { return nodes[i]; }
+    void assign(const std::vector<int>& path) {
+        count = std::min((int)path.size(), CAPACITY);
+        for (int i = 0; i < count; i++) nodes[i] = (int16_t)path[i];
+    }
+};
+
+// AI level of detail: how often a bot runs its full think (perception,
+// decisions, repathing), by distance to the nearest human. Bots in a
+// fight think one tier more often. Between thinks a bot only steers.
+constexpr float BOT_LOD_NEAR_DIST  = 40.0f;  // Think every tick
+constexpr float BOT_LOD_MID_DIST   = 100.0f; // Every BOT_THINK_MID ticks
+constexpr int   BOT_THINK_MID      = 4;
+constexpr int   BOT_THINK_FAR      = 16;     // Beyond BOT_LOD_MID_DIST
+
+struct BotData {
+    int         playerId = -1;
+    AIState     aiState = AIState::PATROL;
+    Vec3        targetPos;
+    int         targetPlayerId = -1;
+    float       stateTimer = 0;
+    float       reactionDelay = 0.5f;
+    float       reactionTimer = 0;
+    int         currentWaypoint = 0;
+    Vec3        lastPos;
+    float       stuckTimer = 0;
+    float       aimJitter = 0.03f;  // Radians of aim randomness
+    InputState  input;
+
+    // A* pathfinding
+    BotPath          path;          // Waypoint indices forming current path
+    int              pathIndex = 0; // Current position in path
+    float            pathAge = 0;   // Time since last pathfind
+    float            jumpCooldown = 0;
+    float            combatJumpTimer = 0;
+    float            strafeDir = 1.0f;
+    float            strafeTimer = 0;
+
+    // Written by the (parallel) think step, applied afterwards in bot order
+    uint32_t         rngState = 1;   // Private random stream, see botRand
+    float            aimYaw = 0;
+    float            aimPitch = 0;
+
+    // AI LOD, set by scheduleBotAI before the think step
+    int              thinkInterval = 1; // Ticks between thinks at this bot's tier
+    int              ticksSinceThink = 0;
+    bool             thinkNow = false;
+};
+
+struct KillEvent {
+    int killer, victim;
+    float timer;
+};
+
+// ============================================================================
+// Lag Compensation
+// ============================================================================
+
+// Where every player's hitbox was at the end of a tick, i.e. what the
+// snapshot for that tick showed. About 1.6 KB per tick for 128 players,
+// one array per coordinate so rewinding and ray tests run down
+// contiguous lanes.
+struct HitboxFrame {
+    uint32_t tick = NO_SNAPSHOT_ACK;
+    float    x[MAX_PLAYERS], y[MAX_PLAYERS], z[MAX_PLAYERS];
+    uint8_t  alive[MAX_PLAYERS];
+};
+constexpr int HITBOX_HISTORY = 64; // 1 s at the tick rate, the longest allowed rewind
+
+// Per-player data no tick reads, kept out of PlayerData
+struct PlayerProfile {
+    char name[32] = {};
+};
+
+// ============================================================================
+// World
+// ============================================================================
+
+// Everything the server simulates, with no sockets: map, players, bots,
+// vehicles, flags and tornados. World randomness comes from one stream
+// seeded by init() (bots draw from streams seeded from it), so a seed plus
+// the same inputs replays the same ticks. Hit/death packets raised by the
+// simulation are queued in `events` for the owner to send or drop.
+struct World {
+    // Static geometry and tables, shared by every World on the same map
+    std::shared_ptr<const GameMap> map;
+    PlayerData   players[MAX_PLAYERS];
+    PlayerProfile profiles[MAX_PLAYERS];
+    // Occupied (not DISCONNECTED) slots, ascending; per-tick passes walk
+    // these instead of every slot
+    int          activeIds[MAX_PLAYERS];
+    int          numActive = 0;
+    BotData      bots[MAX_PLAYERS];
+    int          numBots = 0;
+    VehicleData  vehicles[MAX_VEHICLES];
+    int          numVehicles = 0;
+    PlayerGrid   playerGrid; // Rebuilt every tick, kept current by update() on every move
+    InputState*  inputSource[MAX_PLAYERS] = {}; // Client or bot input driving each player
+    uint32_t     serverTick = 0;
+    uint32_t     seed = 0; // Passed to init()
+
+    // Teams & CTF
+    int          teamScores[2] = {0, 0};
+    FlagData     flags[2];
+    int          nextTeam = 0; // Round-robin team assignment
+
+    // Tornados
+    TornadoData  tornados[MAX_TORNADOS];
+    float        tornadoSpawnTimer = 30.0f; // First tornado after 30s
+
+    std::vector<WeaponPickup> pickups; // The map's pickups, with this match's state
+
+    std::vector<KillEvent> killFeed;
+
+    // Lag compensation: hitboxes per tick, and the tick each human player
+    // last reported drawing the others at
+    HitboxFrame  hitboxes[HITBOX_HISTORY];
+    uint32_t     viewTick[MAX_PLAYERS];
+    uint8_t      viewTickFrac[MAX_PLAYERS] = {};
+    int          rewindTicks = 13; // Window (~200 ms), 0 = off
+
+    // Hit/death packets raised since the last clearEvents(). They are the
+    // same for every client.
+    struct Event { int offset; int len; };
+    std::vector<uint8_t> eventData;
+    std::vector<Event>   events;
+
+    bool         verbose = true; // Print gameplay events (hits, kills, pickups...)
+    const char*  logTag = "";    // Prefix for those lines, e.g. the server shard
+    JobPool*     aiPool = nullptr; // Bot think steps; nullptr runs them inline
+    // Most full bot thinks per tick, 0 = no cap. Bots past it wait (most
+    // overdue first next tick), so more bots slow their reactions rather
+    // than the tick.
+    int          aiThinkBudget = 0;
+
+    // Build the map unless one was shared into `map` (a private copy gets
+    // the visibility sets if it has none), then the next-hop table,
+    // pickups, vehicles and flags; every slot starts disconnected
+    void init(uint32_t seed);
+    void spawnBots(int count);
+
+    // Take a free slot for a joining human; -1 if the server is full
+    int  addPlayer(const char* name);
+    void removePlayer(int id);
+    void selectClass(int id, PlayerClass cls);
+
+    // One fixed step of the simulation for serverTick; the caller sends
+    // whatever it needs and then advances serverTick
+    void simulate();
+
+    void queueEvent(const void* data, size_t len);
+    void clearEvents();
+
+    // Everything simulate() reads or writes, as one blob; the map geometry
+    // and waypoint tables are left to init(). loadState() expects a world
+    // init()ed the same way. It points bot slots back at their bots' input
+    // and clears human input sources for the caller to set. Returns false,
+    // leaving the world as it was, if the blob is truncated, was saved on a
+    // different map or holds an out-of-range count, index or enum.
+    void saveState(std::vector<uint8_t>& out) const;
+    bool loadState(const uint8_t* data, size_t len);
+
+    // Shortest waypoint path from startWP to goalWP (inclusive) into `path`,
+    // left empty if there is none. Uses the next-hop table when it matches
+    // the current map, otherwise runs A*.
+    void findPath(int startWP, int goalWP, std::vector<int>& path, bool useTable = true) const;
+    // Check the next-hop table against A* for every waypoint pair. Returns
+    // the number of pairs whose path lengths differ.
+    int  verifyNextHopTable() const;
+
+private:
+    float randf();
+    float randf(float mn, float mx) { return mn + randf() * (mx - mn); }
+    uint32_t nextRand();
+    void logEvent(const char* fmt, ...) const __attribute__((format(printf, 2, 3)));
+    template <class Archive> void transferState(Archive& ar);
+
+    int  findFreeSlot() const;
+    void rebuildActive();
+    void spawnPlayer(int id);
+    void buildNextHopTable();
+
+    void recordHitboxes();
+    const HitboxFrame* findHitboxes(uint32_t tick) const;
+    bool rewindHitboxes(int shooterId, HitboxFrame& out) const;
+
+    void processShot(int shooterId);
+    void processAbility(int playerId, const InputState& input);
+    void tickPlayers(float dt);
+    void processPickups(float dt);
+    void initFlags();
+    void tickCTF(float dt);
+    void tickTornados(float dt);
+
+    void spawnVehicles();
+    void enterVehicle(int playerId);
+    void exitVehicle(int playerId);
+    void vehicleKill(int victimId, int killerId);
+    void vehicleDamage(int victimId, int attackerId, int damage);
+    void tickVehicles(float dt);
+
+    bool canSeePlayer(int botId, int targetId) const;
+    int  findNearestVisibleEnemy(int botId, float maxRange) const;
+    void botFollowPath(BotData& bot, PlayerData& p, float dt) const;
+    void botPathfindTo(BotData& bot, const Vec3& target) const;
+    void findBotPath(int startWP, int goalWP, BotPath& path) const;
+    void prepareBotAI(BotData& bot, float dt);
+    void scheduleBotAI();
+    void steerBot(BotData& bot, PlayerData& p, float dt) const;
+    void updateBotAI(BotData& bot, float dt) const;
+    void applyBotAI(BotData& bot);
+
+    uint32_t             rng_ = 1;
+    // All-pairs first hop on the (static) waypoint graph: nextHop_[s * n + g]
+    // is the neighbor of s on a shortest path to g, -1 if unreachable
+    std::vector<int16_t> nextHop_;
+    int                  nextHopSize_ = 0;
+};